@@ -0,0 +1,208 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Pos2D.h"
+#include "ActorStore.h"
+
+static void ActorStore_Grow(ActorStore_T * store);
+static void ActorStore_AdvanceArrays(int count, float seconds, 
+                                     int   * __restrict state, 
+                                     float * __restrict move_timer, 
+                                     const float * __restrict move_timeout,
+                                     int   * __restrict grid_x, 
+                                     int   * __restrict grid_y,
+                                     const int * __restrict next_x, 
+                                     const int * __restrict next_y);
+
+
+void ActorStore_Init(ActorStore_T * store)
+{
+   store->count        = 0;
+   store->capacity     = 0;
+   store->kind         = NULL;
+   store->spawn_x      = NULL;
+   store->spawn_y      = NULL;
+   store->grid_x       = NULL;
+   store->grid_y       = NULL;
+   store->next_x       = NULL;
+   store->next_y       = NULL;
+   store->state        = NULL;
+   store->move_timer   = NULL;
+   store->move_timeout = NULL;
+   store->input        = NULL;
+}
+
+void ActorStore_Destroy(ActorStore_T * store)
+{
+   free(store->kind);
+   free(store->spawn_x);
+   free(store->spawn_y);
+   free(store->grid_x);
+   free(store->grid_y);
+   free(store->next_x);
+   free(store->next_y);
+   free(store->state);
+   free(store->move_timer);
+   free(store->move_timeout);
+   free(store->input);
+}
+
+int ActorStore_Add(ActorStore_T * store, int kind, int spawn_x, int spawn_y)
+{
+   int index;
+
+   if(store->count == store->capacity)
+   {
+      ActorStore_Grow(store);
+   }
+   index = store->count;
+   store->count ++;
+
+   store->kind[index]    = kind;
+   store->spawn_x[index] = spawn_x;
+   store->spawn_y[index] = spawn_y;
+   store->input[index]   = 0;
+   ActorStore_Respawn(store, index);
+   return index;
+}
+
+void ActorStore_Truncate(ActorStore_T * store, int count)
+{
+   if(count < store->count)
+   {
+      store->count = count;
+   }
+}
+
+void ActorStore_Respawn(ActorStore_T * store, int index)
+{
+   store->grid_x[index]       = store->spawn_x[index];
+   store->grid_y[index]       = store->spawn_y[index];
+   store->next_x[index]       = store->spawn_x[index];
+   store->next_y[index]       = store->spawn_y[index];
+   store->state[index]        = ACTOR_STATE_NOT_MOVING;
+   store->move_timer[index]   = 0;
+   store->move_timeout[index] = 0;
+}
+
+void ActorStore_Start(ActorStore_T * store, int index, int state, 
+                      int next_x, int next_y, float timeout)
+{
+   store->state[index]        = state;
+   store->next_x[index]       = next_x;
+   store->next_y[index]       = next_y;
+   store->move_timer[index]   = 0;
+   store->move_timeout[index] = timeout;
+}
+
+void ActorStore_Advance(ActorStore_T * store, float seconds)
+{
+   ActorStore_AdvanceArrays(store->count, seconds, store->state, 
+                            store->move_timer, store->move_timeout,
+                            store->grid_x, store->grid_y, 
+                            store->next_x, store->next_y);
+}
+
+void ActorStore_Settle(ActorStore_T * store)
+{
+   int i, count;
+   int * state;
+
+   count = store->count;
+   state = store->state;
+   for(i = 0; i < count; i++)
+   {
+      state[i] = (state[i] == ACTOR_STATE_ARRIVED) ? ACTOR_STATE_NOT_MOVING : state[i];
+   }
+}
+
+void ActorStore_Get(const ActorStore_T * store, int index, Actor_T * actor)
+{
+   actor->kind          = store->kind[index];
+   actor->grid_p.x      = store->grid_x[index];
+   actor->grid_p.y      = store->grid_y[index];
+   actor->next_grid_p.x = store->next_x[index];
+   actor->next_grid_p.y = store->next_y[index];
+   actor->state         = store->state[index];
+   actor->move_timer    = store->move_timer[index];
+   actor->move_timeout  = store->move_timeout[index];
+}
+
+// Every field is read and written whatever the state, selecting rather
+// than branching, so this stays one vectorizable loop. The arrays never
+// overlap, and saying so with __restrict (which GCC, Clang and MSVC all
+// take) is what lets the compiler turn the selects into vector blends.
+static void ActorStore_AdvanceArrays(int count, float seconds, 
+                                     int   * __restrict state, 
+                                     float * __restrict move_timer, 
+                                     const float * __restrict move_timeout,
+                                     int   * __restrict grid_x, 
+                                     int   * __restrict grid_y,
+                                     const int * __restrict next_x, 
+                                     const int * __restrict next_y)
+{
+   int i, moving, arrived, current, gx, gy, nx, ny;
+   float timer, timeout;
+
+   for(i = 0; i < count; i++)
+   {
+      current = state[i];
+      timer   = move_timer[i];
+      timeout = move_timeout[i];
+      gx      = grid_x[i];
+      gy      = grid_y[i];
+      nx      = next_x[i];
+      ny      = next_y[i];
+
+      // MOVING, FALLING and DIGGING are consecutive. One unsigned compare
+      // keeps the compiler from splitting the test into branches.
+      moving  = (unsigned)(current - ACTOR_STATE_MOVING) <= 
+                (unsigned)(ACTOR_STATE_DIGGING - ACTOR_STATE_MOVING);
+      timer   = timer + (seconds * (float)moving);
+      arrived = moving & (timer >= timeout);
+
+      move_timer[i] = timer;
+      state[i]      = arrived ? ACTOR_STATE_ARRIVED : current;
+      grid_x[i]     = arrived ? nx : gx;
+      grid_y[i]     = arrived ? ny : gy;
+   }
+}
+
+static void ActorStore_Grow(ActorStore_T * store)
+{
+   int capacity;
+   capacity = (store->capacity < 8) ? 8 : store->capacity * 2;
+   store->kind         = realloc(store->kind,         sizeof(int)   * capacity);
+   store->spawn_x      = realloc(store->spawn_x,      sizeof(int)   * capacity);
+   store->spawn_y      = realloc(store->spawn_y,      sizeof(int)   * capacity);
+   store->grid_x       = realloc(store->grid_x,       sizeof(int)   * capacity);
+   store->grid_y       = realloc(store->grid_y,       sizeof(int)   * capacity);
+   store->next_x       = realloc(store->next_x,       sizeof(int)   * capacity);
+   store->next_y       = realloc(store->next_y,       sizeof(int)   * capacity);
+   store->state        = realloc(store->state,        sizeof(int)   * capacity);
+   store->move_timer   = realloc(store->move_timer,   sizeof(float) * capacity);
+   store->move_timeout = realloc(store->move_timeout, sizeof(float) * capacity);
+   store->input        = realloc(store->input,        sizeof(int)   * capacity);
+   store->capacity     = capacity;
+}
+
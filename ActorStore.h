@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __ACTORSTORE_H__
+#define __ACTORSTORE_H__
+
+// Everything that moves from tile to tile, players and guards alike. Each
+// field has its own array, so the loops that run over every actor each
+// tick only stream through the fields they use and compile to straight,
+// branch free code.
+
+#define ACTOR_STATE_NOT_MOVING  0
+#define ACTOR_STATE_MOVING      1
+#define ACTOR_STATE_FALLING     2
+#define ACTOR_STATE_DIGGING     3
+#define ACTOR_STATE_DEATH       4
+#define ACTOR_STATE_WIN         5
+#define ACTOR_STATE_ARRIVED     6   // Finished a move this tick, see ActorStore_Settle
+
+#define ACTOR_KIND_PLAYER       0
+#define ACTOR_KIND_GUARD        1
+
+// Bit in input for a GameInput_PlayerKeys_T
+#define ACTOR_INPUT(key)        (1 << (key))
+
+typedef struct ActorStore_S ActorStore_T;
+typedef struct Actor_S      Actor_T;
+
+struct ActorStore_S
+{
+   int     count;
+   int     capacity;
+   int   * kind;          // ACTOR_KIND_*
+   int   * spawn_x;       // Where ActorStore_Respawn puts it
+   int   * spawn_y;
+   int   * grid_x;        // Tile it is on, or moving from
+   int   * grid_y;
+   int   * next_x;        // Tile it is moving to
+   int   * next_y;
+   int   * state;         // ACTOR_STATE_*
+   float * move_timer;
+   float * move_timeout;
+   int   * input;         // ACTOR_INPUT bits of the keys held
+};
+
+// One actor copied out of the store
+struct Actor_S
+{
+   int     kind;
+   Pos2D_T grid_p;
+   Pos2D_T next_grid_p;
+   int     state;
+   float   move_timer;
+   float   move_timeout;
+};
+
+void ActorStore_Init(ActorStore_T * store);
+void ActorStore_Destroy(ActorStore_T * store);
+
+// Returns the new actor's index. It starts at rest on its spawn tile.
+int  ActorStore_Add(ActorStore_T * store, int kind, int spawn_x, int spawn_y);
+
+// Drops every actor from count on
+void ActorStore_Truncate(ActorStore_T * store, int count);
+
+void ActorStore_Respawn(ActorStore_T * store, int index);
+
+// Sets index moving to next over timeout seconds
+void ActorStore_Start(ActorStore_T * store, int index, int state, 
+                      int next_x, int next_y, float timeout);
+
+// Moves every moving actor seconds further. Those that get where they were
+// going take the tile and are left ARRIVED, so they don't pick their next
+// move until the next tick.
+void ActorStore_Advance(ActorStore_T * store, float seconds);
+
+// Brings every ARRIVED actor to rest
+void ActorStore_Settle(ActorStore_T * store);
+
+void ActorStore_Get(const ActorStore_T * store, int index, Actor_T * actor);
+
+#endif // __ACTORSTORE_H__
+
@@ -243,6 +243,23 @@ void   ArrayList_Remove(ArrayList_T * list, size_t index)
    }
 }
 
+// Moves the last element into the removed slot instead of shifting the tail
+void   ArrayList_RemoveSwap(ArrayList_T * list, size_t index)
+{
+   uint8_t * hole, * last;
+   
+   if(index < list->count)
+   {
+      list->count --;
+      if(index < list->count)
+      {
+         hole = (uint8_t*)list->array + (index       * list->element_size);
+         last = (uint8_t*)list->array + (list->count * list->element_size);
+         memcpy(hole, last, list->element_size);
+      }
+   }
+}
+
 void   ArrayList_Clear(ArrayList_T * list)
 {
    list->count = 0;
@@ -49,6 +49,7 @@ void * ArrayList_GetIndex(const ArrayList_T * list, size_t index);
 void   ArrayList_Swap(ArrayList_T * list, size_t index1, size_t index2);
 
 void   ArrayList_Remove(ArrayList_T * list, size_t index);
+void   ArrayList_RemoveSwap(ArrayList_T * list, size_t index);
 void   ArrayList_Clear(ArrayList_T * list);
 
 
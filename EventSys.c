@@ -19,137 +19,676 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "SDLInclude.h"
 #include "ArrayList.h"
 #include "EventSys.h"
 
-typedef struct ESType_S ESType_T;
+#define ESTYPE_RING_START 16
+#define ESINBOX_SLAB_SIZE 64
+
+typedef struct ESReader_S ESReader_T;
+
+// Where an inbox is reading. A type keeps these packed together so the
+// inboxes can be looked over without chasing each one.
+struct ESReader_S
+{
+   size_t cursor;    // Next event to read
+   size_t held;      // Start of the events last returned by ESInbox_Get
+   ESInbox_T * inbox;
+#ifdef EVENTSYS_STATS
+   ESInboxStats_T stats;
+#endif // EVENTSYS_STATS
+};
+
+// Events are counted from when the type was created, the slot of event n
+// is n & (capacity - 1). Counts only ever get compared by subtracting, so
+// they are free to wrap.
 struct ESType_S
 {
-   ArrayList_T inbox_list;
+   ArrayList_T reader_list;
    size_t event_size;
-   int event_type;
+   unsigned char * ring;
+   size_t capacity;           // Events, zero or a power of two
+   size_t head;               // Next event to be written
+   size_t tail;               // Oldest event an inbox may still be reading
+   ArrayList_T retired_list;  // Rings outgrown while inboxes held runs in them
+   size_t retired_until;      // They can go once tail reaches this
+   size_t high_water;         // Most events an inbox has had waiting
+
+   // Types with a capacity have a ring that never grows. Senders on any
+   // thread claim events from reserve and mark them in written when they
+   // are filled in. head only moves over events that are marked.
+   int queued;
+   SDL_atomic_t reserve;      // Next event a sender claims
+   SDL_atomic_t shared_tail;  // tail, for the senders to see
+   SDL_atomic_t refused;      // Sends dropped because the ring was full
+   SDL_atomic_t * written;    // Per slot, the event number + 1 once filled in
+
+#ifdef EVENTSYS_STATS
+   // Sends of types with a capacity are worked out from reserve instead,
+   // as these are only ever touched by the owning thread
+   Uint64 sends;
+   Uint64 deliveries;
+   Uint64 bytes;
+   Uint64 grows;
+#endif // EVENTSYS_STATS
 };
 
-static ESType_T * EventSys_FindType(EventSys_T * event_sys, int event_type)
+static ESInbox_T * EventSys_TakeInbox(EventSys_T * event_sys);
+static void ESType_Reclaim(ESType_T * type);
+static void ESType_Grow(ESType_T * type);
+static void ESType_FreeRetired(ESType_T * type);
+static void ESType_Collect(ESType_T * type);
+#ifdef EVENTSYS_STATS
+static void EventSys_DumpStatsCSV(EventSys_T * event_sys, FILE * file);
+static void EventSys_DumpStatsJSON(EventSys_T * event_sys, FILE * file);
+#endif // EVENTSYS_STATS
+
+
+void EventSys_Init(EventSys_T * event_sys, const ESTypeInfo_T * type_info, int type_count)
 {
-   size_t i, count;
-   ESType_T * loop, * result;
-   result = NULL;
-   loop = ArrayList_Get(&event_sys->event_type_list, &count, NULL);
-   for(i = 0; i < count; i++)
+   int i;
+   ESType_T * type;
+
+   event_sys->type_info  = type_info;
+   event_sys->type_count = type_count;
+   event_sys->type_list  = malloc(sizeof(ESType_T) * type_count);
+   event_sys->slab_list  = NULL;
+   event_sys->slab_count = 0;
+   event_sys->inbox_free = NULL;
+#ifdef EVENTSYS_STATS
+   event_sys->stats_start = SDL_GetPerformanceCounter();
+#endif // EVENTSYS_STATS
+   for(i = 0; i < type_count; i++)
    {
-      if(loop[i].event_type == event_type)
+      type = &event_sys->type_list[i];
+      ArrayList_Init(&type->reader_list, sizeof(ESReader_T), 0);
+      ArrayList_Init(&type->retired_list, sizeof(unsigned char *), 0);
+      type->event_size    = type_info[i].event_size;
+      type->ring          = NULL;
+      type->capacity      = 0;
+      type->head          = 0;
+      type->tail          = 0;
+      type->retired_until = 0;
+      type->high_water    = 0;
+      type->queued        = 0;
+      type->written       = NULL;
+      SDL_AtomicSet(&type->reserve,     0);
+      SDL_AtomicSet(&type->shared_tail, 0);
+      SDL_AtomicSet(&type->refused,     0);
+#ifdef EVENTSYS_STATS
+      type->sends      = 0;
+      type->deliveries = 0;
+      type->bytes      = 0;
+      type->grows      = 0;
+#endif // EVENTSYS_STATS
+      if(type_info[i].capacity > 0)
       {
-         result = &loop[i];
-         break;
+         type->queued   = 1;
+         type->capacity = ESTYPE_RING_START;
+         while(type->capacity < (size_t)type_info[i].capacity)
+         {
+            type->capacity *= 2;
+         }
+         type->ring    = malloc(type->capacity * type->event_size);
+         type->written = calloc(type->capacity, sizeof(SDL_atomic_t));
       }
    }
-   return result;
 }
 
+void EventSys_Destroy(EventSys_T * event_sys)
+{
+   int i;
+   ESType_T * type;
+
+   for(i = 0; i < event_sys->type_count; i++)
+   {
+      type = &event_sys->type_list[i];
+      ESType_FreeRetired(type);
+      ArrayList_Destroy(&type->retired_list);
+      ArrayList_Destroy(&type->reader_list);
+      free(type->ring);
+      free(type->written);
+   }
+
+   for(i = 0; i < event_sys->slab_count; i++)
+   {
+      free(event_sys->slab_list[i]);
+   }
+   free(event_sys->slab_list);
+   event_sys->slab_list  = NULL;
+   event_sys->slab_count = 0;
+   event_sys->inbox_free = NULL;
+
+   free(event_sys->type_list);
+   event_sys->type_list  = NULL;
+   event_sys->type_count = 0;
+}
 
-void EventSys_Init(EventSys_T * event_sys)
+ESInbox_T * EventSys_CreateInbox(EventSys_T * event_sys, int event_type)
 {
-   ArrayList_Init(&event_sys->event_type_list, sizeof(ESType_T), 0);
+   ESInbox_T * inbox;
+   ESType_T * type;
+   ESReader_T * reader;
+
+   if(event_type < 0 || event_type >= event_sys->type_count)
+   {
+      inbox = NULL;
+   }
+   else
+   {
+      type = &event_sys->type_list[event_type];
+      if(type->queued == 1)
+      {
+         ESType_Collect(type);
+      }
+      inbox = EventSys_TakeInbox(event_sys);
+      inbox->type = type;
+      reader = ArrayList_Add(&type->reader_list, &inbox->index);
+      reader->cursor = type->head;
+      reader->held   = type->head;
+      reader->inbox  = inbox;
+#ifdef EVENTSYS_STATS
+      reader->stats.max_depth = 0;
+      reader->stats.gets      = 0;
+      reader->stats.events    = 0;
+#endif // EVENTSYS_STATS
+   }
+   return inbox;
 }
 
-void EventSys_Destroy(EventSys_T * event_sys)
+void EventSys_DestroyInbox(EventSys_T * event_sys, ESInbox_T * inbox)
 {
-   size_t type_count, i1, inbox_count, i2;
-   ESType_T * type_list;
-   ESInbox_T * inbox_list;
+   ESType_T * type;
+   ESReader_T * reader_list;
+   size_t reader_count;
 
-   type_list = ArrayList_Get(&event_sys->event_type_list, &type_count, NULL);
-   for(i1 = 0; i1 < type_count; i1++)
+   if(inbox != NULL && inbox->type != NULL)
    {
-      inbox_list = ArrayList_Get(&type_list[i1].inbox_list, &inbox_count, NULL);
+      // The last reader fills the gap, so its inbox has to follow it
+      type = inbox->type;
+      ArrayList_RemoveSwap(&type->reader_list, inbox->index);
+      reader_list = ArrayList_Get(&type->reader_list, &reader_count, NULL);
+      if(inbox->index < reader_count)
+      {
+         reader_list[inbox->index].inbox->index = inbox->index;
+      }
 
-      for(i2 = 0; i2 < inbox_count; i2++)
+      if(type->queued == 1)
       {
-         ArrayList_Destroy(&inbox_list[i2].event_list[0]);
-         ArrayList_Destroy(&inbox_list[i2].event_list[1]);
+         // What only this inbox was holding can go to the senders
+         ESType_Collect(type);
+         ESType_Reclaim(type);
+         SDL_AtomicSet(&type->shared_tail, (int)(unsigned int)type->tail);
       }
-      ArrayList_Destroy(&type_list[i1].inbox_list);
+
+      inbox->type      = NULL;
+      inbox->next_free = event_sys->inbox_free;
+      event_sys->inbox_free = inbox;
    }
+}
 
-   ArrayList_Destroy(&event_sys->event_type_list);
-   
+void EventSys_Send(EventSys_T * event_sys, int event_type, const void * event_data)
+{
+   void * slot;
+   int ticket;
+
+   if(event_type >= 0 && event_type < event_sys->type_count && 
+      event_sys->type_list[event_type].queued == 1)
+   {
+      slot = EventSys_Reserve(event_sys, event_type, &ticket);
+      if(slot != NULL)
+      {
+         memcpy(slot, event_data, event_sys->type_list[event_type].event_size);
+         EventSys_Commit(event_sys, event_type, ticket);
+      }
+   }
+   else
+   {
+      slot = EventSys_Push(event_sys, event_type);
+      if(slot != NULL)
+      {
+         memcpy(slot, event_data, event_sys->type_list[event_type].event_size);
+      }
+   }
 }
 
-void EventSys_RegisterEventType(EventSys_T * event_sys, int event_type, size_t event_size)
+void * EventSys_Push(EventSys_T * event_sys, int event_type)
 {
    ESType_T * type;
+   size_t inbox_count;
+   void * slot;
 
-   type = ArrayList_Add(&event_sys->event_type_list, NULL);
-   type->event_size = event_size;
-   type->event_type = event_type;
-   ArrayList_Init(&type->inbox_list, sizeof(ESInbox_T), 0);
+   slot = NULL;
+   if(event_type >= 0 && event_type < event_sys->type_count)
+   {
+      type = &event_sys->type_list[event_type];
+      ArrayList_Get(&type->reader_list, &inbox_count, NULL);
+#ifdef EVENTSYS_STATS
+      if(type->queued == 0)
+      {
+         type->sends      ++;
+         type->deliveries += inbox_count;
+         if(inbox_count > 0)
+         {
+            type->bytes += type->event_size;
+         }
+      }
+#endif // EVENTSYS_STATS
+      if(inbox_count > 0 && type->queued == 0)
+      {
+         if(type->head - type->tail == type->capacity)
+         {
+            ESType_Reclaim(type);
+            if(type->head - type->tail == type->capacity)
+            {
+               ESType_Grow(type);
+            }
+         }
+         slot = type->ring + (type->head & (type->capacity - 1)) * type->event_size;
+         type->head ++;
+      }
+   }
+   return slot;
 }
 
-ESInbox_T * EventSys_CreateInbox(EventSys_T * event_sys, int event_type)
+void * EventSys_Reserve(EventSys_T * event_sys, int event_type, int * ticket)
 {
    ESType_T * type;
-   ESInbox_T * inbox;
+   size_t inbox_count;
+   int position, full;
+   void * slot;
 
-   type = EventSys_FindType(event_sys, event_type);
-   if(type == NULL)
+   slot = NULL;
+   if(event_type >= 0 && event_type < event_sys->type_count)
    {
-      inbox = NULL;
+      type = &event_sys->type_list[event_type];
+      ArrayList_Get(&type->reader_list, &inbox_count, NULL);
+      if(inbox_count > 0 && type->queued == 1)
+      {
+         // Claim the next event unless that would run into the oldest one
+         // an inbox may still be reading. Another sender may claim it first.
+         do
+         {
+            position = SDL_AtomicGet(&type->reserve);
+            full = (unsigned int)position - (unsigned int)SDL_AtomicGet(&type->shared_tail) >= 
+                   (unsigned int)type->capacity;
+         } while(full == 0 && 
+                 SDL_AtomicCAS(&type->reserve, position, (int)((unsigned int)position + 1)) == SDL_FALSE);
+
+         if(full == 1)
+         {
+            SDL_AtomicIncRef(&type->refused);
+         }
+         else
+         {
+            (*ticket) = position;
+            slot = type->ring + ((unsigned int)position & (type->capacity - 1)) * type->event_size;
+         }
+      }
+   }
+   return slot;
+}
+
+void EventSys_Commit(EventSys_T * event_sys, int event_type, int ticket)
+{
+   ESType_T * type;
+
+   type = &event_sys->type_list[event_type];
+   // The event has to land before the mark that says it is there
+   SDL_MemoryBarrierRelease();
+   SDL_AtomicSet(&type->written[(unsigned int)ticket & (type->capacity - 1)], 
+                 (int)((unsigned int)ticket + 1));
+}
+
+void EventSys_GetQueueStats(EventSys_T * event_sys, int event_type, ESQueueStats_T * stats)
+{
+   ESType_T * type;
+
+   stats->capacity   = 0;
+   stats->sent       = 0;
+   stats->refused    = 0;
+   stats->high_water = 0;
+   if(event_type >= 0 && event_type < event_sys->type_count && 
+      event_sys->type_list[event_type].queued == 1)
+   {
+      type = &event_sys->type_list[event_type];
+      stats->capacity   = (int)type->capacity;
+      stats->sent       = (unsigned int)SDL_AtomicGet(&type->reserve);
+      stats->refused    = (unsigned int)SDL_AtomicGet(&type->refused);
+      stats->high_water = type->high_water;
+   }
+}
+
+void * ESInbox_Get(ESInbox_T * inbox, size_t * count, size_t * event_size)
+{
+   ESType_T * type;
+   ESReader_T * reader;
+   size_t available, index, run;
+   void * mem;
+
+   type = inbox->type;
+   reader = ArrayList_GetIndex(&type->reader_list, inbox->index);
+   if(type->queued == 1)
+   {
+      ESType_Collect(type);
+   }
+   reader->held = reader->cursor;
+   available = type->head - reader->cursor;
+   if(available > type->high_water)
+   {
+      type->high_water = available;
+   }
+#ifdef EVENTSYS_STATS
+   if(available > reader->stats.max_depth)
+   {
+      reader->stats.max_depth = available;
+   }
+#endif // EVENTSYS_STATS
+   if(available == 0)
+   {
+      mem = NULL;
+      run = 0;
+      if(type->queued == 1)
+      {
+         // This inbox is done with everything, let the senders know if
+         // that frees up room
+         ESType_Reclaim(type);
+         SDL_AtomicSet(&type->shared_tail, (int)(unsigned int)type->tail);
+      }
    }
    else
    {
-      inbox = ArrayList_Add(&type->inbox_list, NULL);
-      inbox->event_size = type->event_size;
-      inbox->list_index = 0;
-      ArrayList_Init(&inbox->event_list[0], inbox->event_size, 0);
-      ArrayList_Init(&inbox->event_list[1], inbox->event_size, 0);
+      // Stop at the end of the ring, the rest comes from the next call
+      index = reader->cursor & (type->capacity - 1);
+      run   = type->capacity - index;
+      if(run > available)
+      {
+         run = available;
+      }
+      mem = type->ring + index * type->event_size;
+      reader->cursor += run;
+#ifdef EVENTSYS_STATS
+      reader->stats.gets   ++;
+      reader->stats.events += run;
+#endif // EVENTSYS_STATS
+   }
+
+   if(count != NULL)
+   {
+      (*count) = run;
    }
-   return inbox;
+   if(event_size != NULL)
+   {
+      (*event_size) = type->event_size;
+   }
+   return mem;
 }
 
-void EventSys_Send(EventSys_T * event_sys, int event_type, void * event_data)
+#ifdef EVENTSYS_STATS
+
+void EventSys_GetTypeStats(EventSys_T * event_sys, int event_type, ESTypeStats_T * stats)
 {
-   size_t i, count;
    ESType_T * type;
-   ESInbox_T * inbox_list;
+   ESReader_T * reader_list;
+   size_t inbox_count, i;
+   double seconds;
 
-   type = EventSys_FindType(event_sys, event_type);
-   if(type != NULL)
+   memset(stats, 0, sizeof(ESTypeStats_T));
+   if(event_type >= 0 && event_type < event_sys->type_count)
    {
-      inbox_list = ArrayList_Get(&type->inbox_list, &count, NULL);
-      for(i = 0; i < count; i++)
+      type = &event_sys->type_list[event_type];
+      reader_list = ArrayList_Get(&type->reader_list, &inbox_count, NULL);
+      stats->name        = event_sys->type_info[event_type].name;
+      stats->inbox_count = (int)inbox_count;
+      if(type->queued == 1)
+      {
+         stats->sends      = (unsigned int)SDL_AtomicGet(&type->reserve);
+         stats->deliveries = stats->sends * inbox_count;
+         stats->bytes      = stats->sends * type->event_size;
+      }
+      else
+      {
+         stats->sends      = type->sends;
+         stats->deliveries = type->deliveries;
+         stats->bytes      = type->bytes;
+         stats->grows      = type->grows;
+      }
+      for(i = 0; i < inbox_count; i++)
       {
-         ESInbox_Add(&inbox_list[i], event_data);
+         if(reader_list[i].stats.max_depth > stats->max_depth)
+         {
+            stats->max_depth = reader_list[i].stats.max_depth;
+         }
+      }
+      seconds = (double)(SDL_GetPerformanceCounter() - event_sys->stats_start) / 
+                SDL_GetPerformanceFrequency();
+      if(seconds > 0)
+      {
+         stats->sends_per_second = stats->sends / seconds;
       }
    }
 }
 
-void * ESInbox_Get(ESInbox_T * inbox, size_t * count, size_t * event_size)
+void ESInbox_GetStats(ESInbox_T * inbox, ESInboxStats_T * stats)
 {
-   void * mem;
+   ESReader_T * reader;
+
+   reader = ArrayList_GetIndex(&inbox->type->reader_list, inbox->index);
+   (*stats) = reader->stats;
+}
 
-   mem = ArrayList_Get(&inbox->event_list[inbox->list_index], count, event_size);
+void EventSys_DumpStats(EventSys_T * event_sys, const char * filename)
+{
+   FILE * file;
+   size_t length;
 
-   if(inbox->list_index == 0)
+   file = fopen(filename, "w");
+   if(file == NULL)
    {
-      inbox->list_index = 1;
+      printf("Error: Could not write event stats \"%s\"\n", filename);
    }
    else
    {
-      inbox->list_index = 0;
+      length = strlen(filename);
+      if(length >= 5 && strcmp(&filename[length - 5], ".json") == 0)
+      {
+         EventSys_DumpStatsJSON(event_sys, file);
+      }
+      else
+      {
+         EventSys_DumpStatsCSV(event_sys, file);
+      }
+      fclose(file);
+      printf("Wrote event stats to %s\n", filename);
    }
+}
 
-   ArrayList_Clear(&inbox->event_list[inbox->list_index]);
-   return mem;
+// One line per inbox, types without any get one line with inbox -1
+static void EventSys_DumpStatsCSV(EventSys_T * event_sys, FILE * file)
+{
+   ESTypeStats_T stats;
+   ESReader_T * reader_list;
+   size_t inbox_count, i;
+   int type, inbox;
+
+   fprintf(file, "type,sends,sends_per_second,deliveries,bytes,grows,"
+                 "inbox,inbox_max_depth,inbox_gets,inbox_events\n");
+   for(type = 0; type < event_sys->type_count; type++)
+   {
+      EventSys_GetTypeStats(event_sys, type, &stats);
+      reader_list = ArrayList_Get(&event_sys->type_list[type].reader_list, &inbox_count, NULL);
+      for(inbox = -1; inbox < (int)inbox_count; inbox++)
+      {
+         if(inbox >= 0 || inbox_count == 0)
+         {
+            fprintf(file, "%s,%.0f,%.2f,%.0f,%.0f,%.0f,", 
+                    stats.name, (double)stats.sends, stats.sends_per_second, 
+                    (double)stats.deliveries, (double)stats.bytes, (double)stats.grows);
+            if(inbox < 0)
+            {
+               fprintf(file, "-1,0,0,0\n");
+            }
+            else
+            {
+               i = (size_t)inbox;
+               fprintf(file, "%d,%lu,%.0f,%.0f\n", inbox, 
+                       (unsigned long)reader_list[i].stats.max_depth, 
+                       (double)reader_list[i].stats.gets, 
+                       (double)reader_list[i].stats.events);
+            }
+         }
+      }
+   }
 }
-void ESInbox_Add(ESInbox_T * inbox, void * event_data)
+
+static void EventSys_DumpStatsJSON(EventSys_T * event_sys, FILE * file)
 {
-   void * mem;
+   ESTypeStats_T stats;
+   ESReader_T * reader_list;
+   size_t inbox_count, i;
+   int type;
+
+   fprintf(file, "{\n  \"types\": [\n");
+   for(type = 0; type < event_sys->type_count; type++)
+   {
+      EventSys_GetTypeStats(event_sys, type, &stats);
+      fprintf(file, "    {\"name\": \"%s\", \"sends\": %.0f, \"sends_per_second\": %.2f, "
+                    "\"deliveries\": %.0f, \"bytes\": %.0f, \"grows\": %.0f, "
+                    "\"max_depth\": %lu, \"inboxes\": [", 
+              stats.name, (double)stats.sends, stats.sends_per_second, 
+              (double)stats.deliveries, (double)stats.bytes, (double)stats.grows,
+              (unsigned long)stats.max_depth);
+      reader_list = ArrayList_Get(&event_sys->type_list[type].reader_list, &inbox_count, NULL);
+      for(i = 0; i < inbox_count; i++)
+      {
+         fprintf(file, "%s{\"max_depth\": %lu, \"gets\": %.0f, \"events\": %.0f}", 
+                 (i > 0) ? ", " : "",
+                 (unsigned long)reader_list[i].stats.max_depth, 
+                 (double)reader_list[i].stats.gets, 
+                 (double)reader_list[i].stats.events);
+      }
+      fprintf(file, "]}%s\n", (type + 1 < event_sys->type_count) ? "," : "");
+   }
+   fprintf(file, "  ]\n}\n");
+}
+
+#endif // EVENTSYS_STATS
 
-   mem = ArrayList_Add(&inbox->event_list[inbox->list_index], NULL);
-   memcpy(mem, event_data, inbox->event_size);
+// Hands out a free inbox, adding a slab of them when there are none
+static ESInbox_T * EventSys_TakeInbox(EventSys_T * event_sys)
+{
+   ESInbox_T * slab, * inbox;
+   int i;
+
+   if(event_sys->inbox_free == NULL)
+   {
+      slab = malloc(sizeof(ESInbox_T) * ESINBOX_SLAB_SIZE);
+      event_sys->slab_list = realloc(event_sys->slab_list, 
+                                     sizeof(ESInbox_T *) * (event_sys->slab_count + 1));
+      event_sys->slab_list[event_sys->slab_count] = slab;
+      event_sys->slab_count ++;
+      for(i = ESINBOX_SLAB_SIZE - 1; i >= 0; i--)
+      {
+         slab[i].type      = NULL;
+         slab[i].next_free = event_sys->inbox_free;
+         event_sys->inbox_free = &slab[i];
+      }
+   }
+
+   inbox = event_sys->inbox_free;
+   event_sys->inbox_free = inbox->next_free;
+   inbox->next_free = NULL;
+   return inbox;
+}
+
+// Moves tail up to the oldest event an inbox still holds
+static void ESType_Reclaim(ESType_T * type)
+{
+   ESReader_T * reader_list;
+   size_t reader_count, i, oldest;
+
+   // Counts wrap, so compare how far back from head each one is
+   reader_list = ArrayList_Get(&type->reader_list, &reader_count, NULL);
+   oldest = type->head;
+   for(i = 0; i < reader_count; i++)
+   {
+      if(type->head - reader_list[i].held > type->head - oldest)
+      {
+         oldest = reader_list[i].held;
+      }
+   }
+   type->tail = oldest;
+
+   if(type->head - type->tail <= type->head - type->retired_until)
+   {
+      ESType_FreeRetired(type);
+   }
+}
+
+// Doubles the ring. Runs handed out from the old ring stay readable until
+// every inbox has moved past them.
+static void ESType_Grow(ESType_T * type)
+{
+   unsigned char * ring, ** retired;
+   size_t capacity, n;
+
+   if(type->capacity == 0)
+   {
+      capacity = ESTYPE_RING_START;
+   }
+   else
+   {
+      capacity = type->capacity * 2;
+   }
+   ring = malloc(capacity * type->event_size);
+   for(n = type->tail; n != type->head; n++)
+   {
+      memcpy(ring + (n & (capacity - 1)) * type->event_size,
+             type->ring + (n & (type->capacity - 1)) * type->event_size,
+             type->event_size);
+   }
+
+   if(type->ring != NULL)
+   {
+      retired = ArrayList_Add(&type->retired_list, NULL);
+      (*retired) = type->ring;
+      type->retired_until = type->head;
+   }
+   type->ring     = ring;
+   type->capacity = capacity;
+#ifdef EVENTSYS_STATS
+   type->grows ++;
+   type->bytes += (type->head - type->tail) * type->event_size;
+#endif // EVENTSYS_STATS
+}
+
+static void ESType_FreeRetired(ESType_T * type)
+{
+   unsigned char ** retired;
+   size_t count, i;
+
+   retired = ArrayList_Get(&type->retired_list, &count, NULL);
+   for(i = 0; i < count; i++)
+   {
+      free(retired[i]);
+   }
+   ArrayList_Clear(&type->retired_list);
+}
+
+// Moves head over the events senders have finished filling in. Senders
+// finish out of order, so it stops at the first one still being written.
+static void ESType_Collect(ESType_T * type)
+{
+   while(SDL_AtomicGet(&type->written[type->head & (type->capacity - 1)]) == 
+         (int)(unsigned int)(type->head + 1))
+   {
+      type->head ++;
+   }
+   SDL_MemoryBarrierAcquire();
 }
 
 
@@ -21,33 +21,133 @@
 #ifndef __EVENTSYS_H__
 #define __EVENTSYS_H__
 
+// With EVENTSYS_STATS defined (bam eventstats=true) every event type and
+// inbox keeps counters, which can be read back or dumped to a file.
+// Otherwise the counters and the EVENTSYS_DUMP_STATS macro compile away.
+
 typedef struct EventSys_S EventSys_T;
 typedef struct ESInbox_S ESInbox_T;
+typedef struct ESTypeInfo_S ESTypeInfo_T;
+typedef struct ESType_S ESType_T;
+typedef struct ESQueueStats_S ESQueueStats_T;
+typedef struct ESTypeStats_S ESTypeStats_T;
+typedef struct ESInboxStats_S ESInboxStats_T;
+
+// One entry per event type, indexed by the type's id. config_tool builds
+// the game's table from event_source.txt.
+struct ESTypeInfo_S
+{
+   const char * name;
+   size_t event_size;
+   int capacity;     // 0 when only the thread that owns the EventSys sends.
+                     // Otherwise any thread may, and at most this many
+                     // events wait unread before sends are refused.
+};
+
+// How a type any thread may send has been keeping up
+struct ESQueueStats_S
+{
+   int capacity;              // Rounded up to a power of two
+   unsigned int sent;         // Events that got a place in the ring
+   unsigned int refused;      // Events dropped because the ring was full
+   size_t high_water;         // Most events an inbox has had waiting
+};
 
 struct EventSys_S
 {
-   ArrayList_T event_type_list;
+   const ESTypeInfo_T * type_info;
+   ESType_T * type_list;
+   int type_count;
+   ESInbox_T ** slab_list;    // Inboxes are handed out from these and never move
+   int slab_count;
+   ESInbox_T * inbox_free;    // Destroyed inboxes, ready to be handed out again
+#ifdef EVENTSYS_STATS
+   Uint64 stats_start;        // Performance counter at EventSys_Init
+#endif // EVENTSYS_STATS
+};
+
+#ifdef EVENTSYS_STATS
+struct ESInboxStats_S
+{
+   size_t max_depth;          // Most events waiting when ESInbox_Get was called
+   Uint64 gets;               // Calls to ESInbox_Get that returned events
+   Uint64 events;             // Events those calls returned
 };
+#endif // EVENTSYS_STATS
 
+// Every inbox of a type reads the same ring. Where it is reading is kept
+// with the other inboxes of its type, at index.
 struct ESInbox_S
 {
-   size_t event_size;
-   int list_index;
-   ArrayList_T event_list[2];
+   ESType_T * type;
+   size_t index;
+   ESInbox_T * next_free;
 };
 
 
-void EventSys_Init(EventSys_T * event_sys);
+// Event types are the ids 0 to type_count - 1. Everything but the senders
+// of types with a capacity belongs to the thread that owns the EventSys,
+// and those types need their inboxes before other threads start sending.
+void EventSys_Init(EventSys_T * event_sys, const ESTypeInfo_T * type_info, int type_count);
 void EventSys_Destroy(EventSys_T * event_sys);
 
-void EventSys_RegisterEventType(EventSys_T * event_sys, int event_type, size_t event_size);
-
+// The inbox sees the events sent after it was created. It stays where it
+// is until it is destroyed, however many more get created.
 ESInbox_T * EventSys_CreateInbox(EventSys_T * event_sys, int event_type);
 
-void EventSys_Send(EventSys_T * event_sys, int event_type, void * event_data);
+// Unsubscribes the inbox, any run it was last given goes with it
+void EventSys_DestroyInbox(EventSys_T * event_sys, ESInbox_T * inbox);
+
+// Prefer the typed senders config_tool generates, this copies event_size
+// bytes from event_data
+void EventSys_Send(EventSys_T * event_sys, int event_type, const void * event_data);
+
+// Space in the type's ring for one event, which every inbox will see once
+// it is filled in. NULL when the type has no inboxes to see it, or has a
+// capacity.
+void * EventSys_Push(EventSys_T * event_sys, int event_type);
+
+// The same for types with a capacity, from any thread. Fill the event in
+// then commit it with the ticket. NULL when the ring is full, or the type
+// has no inboxes or no capacity.
+void * EventSys_Reserve(EventSys_T * event_sys, int event_type, int * ticket);
+void   EventSys_Commit(EventSys_T * event_sys, int event_type, int ticket);
+
+// Zeros for types without a capacity
+void EventSys_GetQueueStats(EventSys_T * event_sys, int event_type, ESQueueStats_T * stats);
+
+#ifdef EVENTSYS_STATS
+
+struct ESTypeStats_S
+{
+   const char * name;
+   int inbox_count;
+   Uint64 sends;              // Including ones no inbox was there to see
+   Uint64 deliveries;         // Each send counts once per inbox that sees it
+   Uint64 bytes;              // Copied by sends and by the ring growing
+   Uint64 grows;              // Times the ring was reallocated
+   size_t max_depth;          // Largest max_depth of its inboxes
+   double sends_per_second;   // Since EventSys_Init
+};
+
+void EventSys_GetTypeStats(EventSys_T * event_sys, int event_type, ESTypeStats_T * stats);
+void ESInbox_GetStats(ESInbox_T * inbox, ESInboxStats_T * stats);
+
+// Every type and inbox, as JSON when filename ends in .json and as CSV
+// otherwise. Only from the thread that owns the EventSys.
+void EventSys_DumpStats(EventSys_T * event_sys, const char * filename);
+
+#define EVENTSYS_DUMP_STATS(event_sys, filename) EventSys_DumpStats(event_sys, filename)
+
+#else // EVENTSYS_STATS
+
+#define EVENTSYS_DUMP_STATS(event_sys, filename)
+
+#endif // EVENTSYS_STATS
 
+// The unread events in the order sent, as one or two runs. Call it until
+// it returns NULL. A run stays valid until the next call on the inbox.
 void * ESInbox_Get(ESInbox_T * inbox, size_t * count, size_t * event_size);
-void ESInbox_Add(ESInbox_T * inbox, void * event_data);
 
 
 
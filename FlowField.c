@@ -0,0 +1,459 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDLInclude.h"
+
+#include "GlobalData.h"
+
+#include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "Movement.h"
+#include "FlowField.h"
+
+static void    FlowField_Rebuild(FlowField_T * field, Level_T * level);
+static uint8_t FlowField_GetEdges(Level_T * level, int x, int y);
+static void    FlowField_UpdateTile(FlowField_T * field, int index);
+static void    FlowField_UpdatePredecessors(FlowField_T * field, int index);
+
+static int  FlowField_Key(const FlowField_T * field, int index);
+static void FlowField_HeapSwap(FlowField_T * field, int a, int b);
+static void FlowField_HeapUp(FlowField_T * field, int pos);
+static void FlowField_HeapDown(FlowField_T * field, int pos);
+static void FlowField_HeapRemove(FlowField_T * field, int index);
+static int  FlowField_HeapPop(FlowField_T * field);
+
+
+void FlowField_Init(FlowField_T * field)
+{
+   field->level      = NULL;
+   field->generation = 0;
+   field->width      = 0;
+   field->height     = 0;
+   field->target     = -1;
+   field->edges      = NULL;
+   field->dist       = NULL;
+   field->rhs        = NULL;
+   field->heap       = NULL;
+   field->heap_pos   = NULL;
+   field->heap_size  = 0;
+   field->settled    = 0;
+}
+
+void FlowField_Destroy(FlowField_T * field)
+{
+   free(field->edges);
+   free(field->dist);
+   free(field->rhs);
+   free(field->heap);
+   free(field->heap_pos);
+}
+
+void FlowField_Sync(FlowField_T * field, Level_T * level)
+{
+   Pos2D_T * changes;
+   size_t count, i;
+   int x, y, index;
+   uint8_t edges;
+
+   if(field->level != level || field->generation != level->generation)
+   {
+      FlowField_Rebuild(field, level);
+   }
+   else
+   {
+      // A tile's moves depend on the tiles around it
+      changes = Level_GetHoleChanges(level, &count);
+      for(i = 0; i < count; i++)
+      {
+         for(y = changes[i].y - 1; y <= changes[i].y + 1; y++)
+         {
+            for(x = changes[i].x - 1; x <= changes[i].x + 1; x++)
+            {
+               if(x >= 0 && x < field->width && y >= 0 && y < field->height)
+               {
+                  index = x + (y * field->width);
+                  edges = FlowField_GetEdges(level, x, y);
+                  if(edges != field->edges[index])
+                  {
+                     field->edges[index] = edges;
+                     FlowField_UpdateTile(field, index);
+                  }
+               }
+            }
+         }
+      }
+   }
+}
+
+void FlowField_Invalidate(FlowField_T * field)
+{
+   field->level = NULL;
+}
+
+void FlowField_SetTarget(FlowField_T * field, int x, int y)
+{
+   int target, old_target;
+
+   if(x >= 0 && x < field->width && y >= 0 && y < field->height)
+   {
+      target = x + (y * field->width);
+   }
+   else
+   {
+      target = -1;
+   }
+
+   if(target != field->target)
+   {
+      old_target = field->target;
+      field->target = target;
+      if(old_target >= 0)
+      {
+         FlowField_UpdateTile(field, old_target);
+      }
+      if(target >= 0)
+      {
+         FlowField_UpdateTile(field, target);
+      }
+   }
+}
+
+void FlowField_Update(FlowField_T * field)
+{
+   int index;
+
+   field->settled = 0;
+   while(field->heap_size > 0)
+   {
+      index = FlowField_HeapPop(field);
+      field->settled ++;
+      if(field->dist[index] > field->rhs[index])
+      {
+         // Got closer, which settles it
+         field->dist[index] = field->rhs[index];
+      }
+      else
+      {
+         // Got further, look at it again once its neighbours are settled
+         field->dist[index] = FLOWFIELD_UNREACHABLE;
+         FlowField_UpdateTile(field, index);
+      }
+      FlowField_UpdatePredecessors(field, index);
+   }
+}
+
+int FlowField_GetStep(const FlowField_T * field, int x, int y)
+{
+   int index, best, result;
+   uint8_t edges;
+
+   result = 0;
+   if(x >= 0 && x < field->width && y >= 0 && y < field->height)
+   {
+      index = x + (y * field->width);
+      edges = field->edges[index];
+      best  = field->dist[index];
+      // Edges only lead to tiles inside the level
+      if((edges & FLOWFIELD_EDGE_UP) && field->dist[index - field->width] < best)
+      {
+         best   = field->dist[index - field->width];
+         result = FLOWFIELD_EDGE_UP;
+      }
+      if((edges & FLOWFIELD_EDGE_DOWN) && field->dist[index + field->width] < best)
+      {
+         best   = field->dist[index + field->width];
+         result = FLOWFIELD_EDGE_DOWN;
+      }
+      if((edges & FLOWFIELD_EDGE_LEFT) && field->dist[index - 1] < best)
+      {
+         best   = field->dist[index - 1];
+         result = FLOWFIELD_EDGE_LEFT;
+      }
+      if((edges & FLOWFIELD_EDGE_RIGHT) && field->dist[index + 1] < best)
+      {
+         best   = field->dist[index + 1];
+         result = FLOWFIELD_EDGE_RIGHT;
+      }
+   }
+   return result;
+}
+
+int FlowField_GetDistance(const FlowField_T * field, int x, int y)
+{
+   int result;
+   if(x >= 0 && x < field->width && y >= 0 && y < field->height)
+   {
+      result = field->dist[x + (y * field->width)];
+   }
+   else
+   {
+      result = FLOWFIELD_UNREACHABLE;
+   }
+   return result;
+}
+
+static void FlowField_Rebuild(FlowField_T * field, Level_T * level)
+{
+   size_t size;
+   int x, y, index;
+
+   if(field->width != level->tmap.width || field->height != level->tmap.height)
+   {
+      field->width  = level->tmap.width;
+      field->height = level->tmap.height;
+      size = (size_t)field->width * field->height;
+      free(field->edges);
+      free(field->dist);
+      free(field->rhs);
+      free(field->heap);
+      free(field->heap_pos);
+      field->edges    = malloc(size);
+      field->dist     = malloc(sizeof(int) * size);
+      field->rhs      = malloc(sizeof(int) * size);
+      field->heap     = malloc(sizeof(int) * size);
+      field->heap_pos = malloc(sizeof(int) * size);
+   }
+
+   for(y = 0; y < field->height; y++)
+   {
+      for(x = 0; x < field->width; x++)
+      {
+         index = x + (y * field->width);
+         field->edges[index]    = FlowField_GetEdges(level, x, y);
+         field->dist[index]     = FLOWFIELD_UNREACHABLE;
+         field->rhs[index]      = FLOWFIELD_UNREACHABLE;
+         field->heap_pos[index] = -1;
+      }
+   }
+   field->heap_size  = 0;
+   field->target     = -1;
+   field->level      = level;
+   field->generation = level->generation;
+}
+
+// Falling can't be refused, so a tile a guard falls from has no other move
+static uint8_t FlowField_GetEdges(Level_T * level, int x, int y)
+{
+   LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND];
+   Movement_Options_T options;
+   uint8_t result;
+
+   Movement_QueryAround(level, x, y, around);
+   Movement_GetOptions(around, &options);
+   result = 0;
+   if(options.fall)
+   {
+      result = FLOWFIELD_EDGE_DOWN;
+   }
+   else
+   {
+      if(options.move_left)
+      {
+         result |= FLOWFIELD_EDGE_LEFT;
+      }
+      if(options.move_right)
+      {
+         result |= FLOWFIELD_EDGE_RIGHT;
+      }
+      if(options.move_up)
+      {
+         result |= FLOWFIELD_EDGE_UP;
+      }
+      if(options.move_down || options.let_go)
+      {
+         result |= FLOWFIELD_EDGE_DOWN;
+      }
+   }
+   return result;
+}
+
+// Works out rhs from the tiles index can move to and queues index if it
+// no longer matches dist
+static void FlowField_UpdateTile(FlowField_T * field, int index)
+{
+   int best, x, y;
+   uint8_t edges;
+
+   if(index == field->target)
+   {
+      best = 0;
+   }
+   else
+   {
+      best = FLOWFIELD_UNREACHABLE;
+      edges = field->edges[index];
+      x = index % field->width;
+      y = index / field->width;
+      if((edges & FLOWFIELD_EDGE_LEFT) && x > 0 && 
+         field->dist[index - 1] < best)
+      {
+         best = field->dist[index - 1];
+      }
+      if((edges & FLOWFIELD_EDGE_RIGHT) && x + 1 < field->width && 
+         field->dist[index + 1] < best)
+      {
+         best = field->dist[index + 1];
+      }
+      if((edges & FLOWFIELD_EDGE_UP) && y > 0 && 
+         field->dist[index - field->width] < best)
+      {
+         best = field->dist[index - field->width];
+      }
+      if((edges & FLOWFIELD_EDGE_DOWN) && y + 1 < field->height && 
+         field->dist[index + field->width] < best)
+      {
+         best = field->dist[index + field->width];
+      }
+      if(best < FLOWFIELD_UNREACHABLE)
+      {
+         best ++;
+      }
+   }
+   field->rhs[index] = best;
+
+   if(field->dist[index] != field->rhs[index])
+   {
+      if(field->heap_pos[index] < 0)
+      {
+         field->heap_pos[index] = field->heap_size;
+         field->heap[field->heap_size] = index;
+         field->heap_size ++;
+      }
+      FlowField_HeapUp(field, field->heap_pos[index]);
+      FlowField_HeapDown(field, field->heap_pos[index]);
+   }
+   else if(field->heap_pos[index] >= 0)
+   {
+      FlowField_HeapRemove(field, index);
+   }
+}
+
+// The neighbours that have a move into index
+static void FlowField_UpdatePredecessors(FlowField_T * field, int index)
+{
+   int x, y;
+   x = index % field->width;
+   y = index / field->width;
+   if(x > 0 && (field->edges[index - 1] & FLOWFIELD_EDGE_RIGHT))
+   {
+      FlowField_UpdateTile(field, index - 1);
+   }
+   if(x + 1 < field->width && (field->edges[index + 1] & FLOWFIELD_EDGE_LEFT))
+   {
+      FlowField_UpdateTile(field, index + 1);
+   }
+   if(y > 0 && (field->edges[index - field->width] & FLOWFIELD_EDGE_DOWN))
+   {
+      FlowField_UpdateTile(field, index - field->width);
+   }
+   if(y + 1 < field->height && (field->edges[index + field->width] & FLOWFIELD_EDGE_UP))
+   {
+      FlowField_UpdateTile(field, index + field->width);
+   }
+}
+
+static int FlowField_Key(const FlowField_T * field, int index)
+{
+   return (field->dist[index] < field->rhs[index]) ? field->dist[index] : field->rhs[index];
+}
+
+static void FlowField_HeapSwap(FlowField_T * field, int a, int b)
+{
+   int temp;
+   temp = field->heap[a];
+   field->heap[a] = field->heap[b];
+   field->heap[b] = temp;
+   field->heap_pos[field->heap[a]] = a;
+   field->heap_pos[field->heap[b]] = b;
+}
+
+static void FlowField_HeapUp(FlowField_T * field, int pos)
+{
+   int parent;
+   while(pos > 0)
+   {
+      parent = (pos - 1) / 2;
+      if(FlowField_Key(field, field->heap[pos]) >= FlowField_Key(field, field->heap[parent]))
+      {
+         break;
+      }
+      FlowField_HeapSwap(field, pos, parent);
+      pos = parent;
+   }
+}
+
+static void FlowField_HeapDown(FlowField_T * field, int pos)
+{
+   int child, smallest;
+   while(1)
+   {
+      smallest = pos;
+      child = (pos * 2) + 1;
+      if(child < field->heap_size && 
+         FlowField_Key(field, field->heap[child]) < FlowField_Key(field, field->heap[smallest]))
+      {
+         smallest = child;
+      }
+      child ++;
+      if(child < field->heap_size && 
+         FlowField_Key(field, field->heap[child]) < FlowField_Key(field, field->heap[smallest]))
+      {
+         smallest = child;
+      }
+      if(smallest == pos)
+      {
+         break;
+      }
+      FlowField_HeapSwap(field, pos, smallest);
+      pos = smallest;
+   }
+}
+
+static void FlowField_HeapRemove(FlowField_T * field, int index)
+{
+   int pos, last;
+   pos  = field->heap_pos[index];
+   last = field->heap_size - 1;
+   if(pos != last)
+   {
+      FlowField_HeapSwap(field, pos, last);
+   }
+   field->heap_size --;
+   field->heap_pos[index] = -1;
+   if(pos < field->heap_size)
+   {
+      FlowField_HeapUp(field, pos);
+      FlowField_HeapDown(field, pos);
+   }
+}
+
+static int FlowField_HeapPop(FlowField_T * field)
+{
+   int index;
+   index = field->heap[0];
+   FlowField_HeapRemove(field, index);
+   return index;
+}
+
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __FLOWFIELD_H__
+#define __FLOWFIELD_H__
+
+// Distance from every tile to one target tile over the moves a guard can
+// make, which are the Movement rules without digging. Every guard reads
+// the same field and steps toward a neighbour that is closer, so the cost
+// of keeping it current does not depend on how many guards there are.
+//
+// The field is kept current incrementally. Moving the target or changing
+// a tile only revisits the tiles whose distance actually changes, in the
+// manner of Lifelong Planning A* with no heuristic. Only a new level
+// generation builds the field from scratch.
+
+#define FLOWFIELD_UNREACHABLE 0x3FFFFFFF
+
+// Moves out of a tile
+#define FLOWFIELD_EDGE_LEFT   0x01
+#define FLOWFIELD_EDGE_RIGHT  0x02
+#define FLOWFIELD_EDGE_UP     0x04
+#define FLOWFIELD_EDGE_DOWN   0x08   // Falling, climbing down or letting go
+
+typedef struct FlowField_S FlowField_T;
+
+struct FlowField_S
+{
+   Level_T * level;
+   int       generation;  // Of level when the edges were built
+   int       width;
+   int       height;
+   int       target;      // Tile index the field leads to, -1 for none
+   uint8_t * edges;       // FLOWFIELD_EDGE_* per tile
+   int     * dist;        // Settled distance to target
+   int     * rhs;         // Distance implied by the neighbours' dist
+   int     * heap;        // Tiles where dist and rhs differ, by key
+   int     * heap_pos;    // Index into heap, -1 when not in it
+   int       heap_size;
+   int       settled;     // Tiles settled by the last FlowField_Update
+};
+
+void FlowField_Init(FlowField_T * field);
+void FlowField_Destroy(FlowField_T * field);
+
+// Follows level, rebuilding everything if it is a different level or
+// generation than last time. Otherwise only the tiles around the level's
+// hole changes are looked at again, so call it before they are cleared.
+void FlowField_Sync(FlowField_T * field, Level_T * level);
+
+// Forgets the level so the next FlowField_Sync builds the field again
+void FlowField_Invalidate(FlowField_T * field);
+
+// Tiles outside the level clear the target
+void FlowField_SetTarget(FlowField_T * field, int x, int y);
+
+// Settles every tile whose distance changed since the last update
+void FlowField_Update(FlowField_T * field);
+
+// The FLOWFIELD_EDGE_* move from x, y to the neighbour closest to the
+// target, or 0 when no move gets any closer
+int  FlowField_GetStep(const FlowField_T * field, int x, int y);
+
+// FLOWFIELD_UNREACHABLE outside the level or when the target can't be reached
+int  FlowField_GetDistance(const FlowField_T * field, int x, int y);
+
+#endif // __FLOWFIELD_H__
+
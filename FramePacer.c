@@ -0,0 +1,123 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+
+#include "SDLInclude.h"
+
+#include "FramePacer.h"
+
+// SDL_Delay can oversleep by a scheduler quantum, so stop sleeping this far
+// ahead of the deadline and spin the rest of the way
+#define FRAMEPACER_SPIN_MS 2
+
+void FramePacer_Init(FramePacer_T * pacer, double frame_seconds)
+{
+   pacer->counter_freq = SDL_GetPerformanceFrequency();
+   pacer->frame_counts = (frame_seconds > 0) ? (Uint64)(frame_seconds * pacer->counter_freq) : 0;
+   pacer->deadline     = 0;
+   pacer->prev_frame   = 0;
+   pacer->prev_ms      = -1;
+   pacer->frames       = 0;
+   pacer->sum_ms       = 0;
+   pacer->sum_delta_ms = 0;
+   pacer->min_ms       = 0;
+   pacer->max_ms       = 0;
+   pacer->late         = 0;
+}
+
+void FramePacer_Wait(FramePacer_T * pacer)
+{
+   Uint64 now, remaining;
+   Uint32 sleep_ms;
+   double frame_ms, delta_ms;
+
+   now = SDL_GetPerformanceCounter();
+   if(pacer->frame_counts > 0)
+   {
+      if(pacer->deadline == 0)
+      {
+         pacer->deadline = now + pacer->frame_counts;
+      }
+
+      if(now < pacer->deadline)
+      {
+         remaining = pacer->deadline - now;
+         sleep_ms = (Uint32)((remaining * 1000) / pacer->counter_freq);
+         if(sleep_ms > FRAMEPACER_SPIN_MS)
+         {
+            SDL_Delay(sleep_ms - FRAMEPACER_SPIN_MS);
+         }
+         while(SDL_GetPerformanceCounter() < pacer->deadline)
+         {
+            // Spin
+         }
+         now = SDL_GetPerformanceCounter();
+         pacer->deadline += pacer->frame_counts;
+      }
+      else
+      {
+         // Start over from now rather than rushing frames out to catch up
+         pacer->late ++;
+         pacer->deadline = now + pacer->frame_counts;
+      }
+   }
+
+   if(pacer->prev_frame != 0)
+   {
+      frame_ms = (double)(now - pacer->prev_frame) * 1000.0 / pacer->counter_freq;
+      if(pacer->frames == 0 || frame_ms < pacer->min_ms) pacer->min_ms = frame_ms;
+      if(pacer->frames == 0 || frame_ms > pacer->max_ms) pacer->max_ms = frame_ms;
+      pacer->sum_ms += frame_ms;
+      if(pacer->prev_ms >= 0)
+      {
+         delta_ms = frame_ms - pacer->prev_ms;
+         pacer->sum_delta_ms += (delta_ms < 0) ? -delta_ms : delta_ms;
+      }
+      pacer->prev_ms = frame_ms;
+      pacer->frames ++;
+   }
+   pacer->prev_frame = now;
+}
+
+void FramePacer_GetStats(FramePacer_T * pacer, FramePacer_Stats_T * stats)
+{
+   stats->frames    = pacer->frames;
+   stats->min_ms    = pacer->min_ms;
+   stats->max_ms    = pacer->max_ms;
+   stats->late      = pacer->late;
+   stats->avg_ms    = (pacer->frames > 0) ? pacer->sum_ms / pacer->frames : 0;
+   stats->jitter_ms = (pacer->frames > 1) ? pacer->sum_delta_ms / (pacer->frames - 1) : 0;
+}
+
+void FramePacer_PrintReport(FramePacer_T * pacer, const char * mode_name)
+{
+   FramePacer_Stats_T stats;
+   FramePacer_GetStats(pacer, &stats);
+   printf("Frame pacing (%s): %lu frames, avg %.3f ms (%.1f fps), jitter %.3f ms, min %.3f ms, max %.3f ms",
+          mode_name, stats.frames, stats.avg_ms, 
+          (stats.avg_ms > 0) ? 1000.0 / stats.avg_ms : 0.0,
+          stats.jitter_ms, stats.min_ms, stats.max_ms);
+   if(pacer->frame_counts > 0)
+   {
+      printf(", %lu missed deadlines", stats.late);
+   }
+   printf("\n");
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __FRAMEPACER_H__
+#define __FRAMEPACER_H__
+
+// Holds each frame to a deadline and keeps track of how evenly frames came
+// out. Waiting sleeps with SDL_Delay while the deadline is far enough off
+// to wake up in time, then spins on the performance counter for the rest.
+
+typedef struct FramePacer_S       FramePacer_T;
+typedef struct FramePacer_Stats_S FramePacer_Stats_T;
+
+struct FramePacer_S
+{
+   Uint64 counter_freq;
+   Uint64 frame_counts;  // 0 to never wait
+   Uint64 deadline;
+   Uint64 prev_frame;    // 0 before the first frame
+   double prev_ms;       // Length of the frame before, -1 if none
+   unsigned long frames;
+   double sum_ms;
+   double sum_delta_ms;  // Of the changes in length between frames
+   double min_ms;
+   double max_ms;
+   unsigned long late;   // Frames that missed their deadline
+};
+
+struct FramePacer_Stats_S
+{
+   unsigned long frames;
+   double avg_ms;
+   double min_ms;
+   double max_ms;
+   double jitter_ms; // Average change in length from one frame to the next
+   unsigned long late;
+};
+
+// frame_seconds of 0 only measures
+void FramePacer_Init(FramePacer_T * pacer, double frame_seconds);
+
+// Call once per frame after it is presented
+void FramePacer_Wait(FramePacer_T * pacer);
+
+void FramePacer_GetStats(FramePacer_T * pacer, FramePacer_Stats_T * stats);
+void FramePacer_PrintReport(FramePacer_T * pacer, const char * mode_name);
+
+#endif // __FRAMEPACER_H__
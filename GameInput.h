@@ -19,6 +19,8 @@ enum GameInput_PlayerKeys_E
 enum GameInput_GameKeys_E
 {
    e_gigk_restart_level,
+   e_gigk_toggle_profiler,
+   e_gigk_dump_event_stats,
    e_gigk_last
 };
 
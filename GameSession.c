@@ -0,0 +1,602 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDLInclude.h"
+
+#include "GlobalData.h"
+
+#include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "LevelSet.h"
+#include "EventSys.h"
+#include "GameEvents.h"
+#include "GameInput.h"
+#include "Movement.h"
+#include "FlowField.h"
+#include "ActorStore.h"
+#include "Profiler.h"
+#include "GameSession.h"
+
+static Level_T * GameSession_GetLevel(GameLevelData_T * game_level_data, int level_index);
+static void GameSession_UpdateLevel(float seconds,
+                                    EventSys_T * event_sys,
+                                    GameLevelData_T * game_level_data);
+static void GameSession_UpdatePlayers(GameSession_T * session);
+static void GameSession_CheckPlayer(GameSession_T * session, int player);
+static void GameSession_SteerGuards(GameSession_T * session);
+static void GameSession_StartMove(GameSession_T * session, int index);
+static void GameSession_Respawn(GameSession_T * session, int player);
+static void GameSession_CatchPlayers(GameSession_T * session);
+static void GameSession_SpawnGuards(GameSession_T * session, Level_T * level);
+static void GameSession_ResetGuards(GameSession_T * session);
+
+static void Level_SetPlayerAtStart(Level_T * level, ActorStore_T * actors, int player);
+
+static int IsAllGoldColected(Level_T * level);
+
+
+void GameSession_Init(GameSession_T * session, LevelSet_T * levelset, int level_index, int copy_levels)
+{
+   int i;
+   Event_InitLevel_T event_initlevel;
+
+   EventSys_Init(&session->event_sys, GameEvents_Registry, EVENT_LAST);
+
+   session->inbox_levelstartpos = EventSys_CreateInbox(&session->event_sys, EVENT_LEVELSTARTPOS);
+   session->inbox_inputstate    = EventSys_CreateInbox(&session->event_sys, EVENT_INPUTSTATE);
+
+   for(i = 0; i < e_gigk_last; i++)
+   {
+      session->game_input_flags[i] = 0;
+   }
+   session->restart_key_prev = 0;
+
+   session->level_data.levelset    = levelset;
+   session->level_data.level_index = level_index;
+   session->level_data.copy_levels = copy_levels;
+   if(copy_levels == 1)
+   {
+      Level_Init(&session->level_data.level_copy);
+   }
+   session->level_data.level = GameSession_GetLevel(&session->level_data, level_index);
+   session->level_data.inbox_playerongold = EventSys_CreateInbox(&session->event_sys, EVENT_PLAYERONGOLD);
+   session->level_data.inbox_initlevel = EventSys_CreateInbox(&session->event_sys, EVENT_INITLEVEL);
+
+   // Players keep the first actors, guards come and go after them
+   ActorStore_Init(&session->actors);
+   session->player_count = 1;
+   for(i = 0; i < session->player_count; i++)
+   {
+      ActorStore_Add(&session->actors, ACTOR_KIND_PLAYER, 0, 0);
+      Level_SetPlayerAtStart(session->level_data.level, &session->actors, i);
+   }
+   session->actor_counts = 0;
+
+   FlowField_Init(&session->guard_data.field);
+   session->guard_data.level         = NULL;
+   session->guard_data.generation    = 0;
+   session->guard_data.field_counts  = 0;
+   session->guard_data.steer_counts  = 0;
+   session->guard_data.field_settled = 0;
+   session->guard_data.harmless      = 0;
+
+   event_initlevel.level_number = level_index;
+   GameEvents_SendInitLevel(&session->event_sys, &event_initlevel);
+}
+
+void GameSession_Destroy(GameSession_T * session)
+{
+   if(session->level_data.copy_levels == 1)
+   {
+      Level_Destroy(&session->level_data.level_copy);
+   }
+   ActorStore_Destroy(&session->actors);
+   FlowField_Destroy(&session->guard_data.field);
+   EventSys_Destroy(&session->event_sys);
+}
+
+void GameSession_SetPlayerKey(GameSession_T * session, int player, GameInput_PlayerKeys_T key, int state)
+{
+   Event_InputState_T event_inputstate;
+   event_inputstate.player = player;
+   event_inputstate.key    = key;
+   event_inputstate.state  = state;
+   GameEvents_SendInputState(&session->event_sys, &event_inputstate);
+}
+
+void GameSession_SetGameKey(GameSession_T * session, GameInput_GameKeys_T key, int state)
+{
+   session->game_input_flags[key] = state;
+}
+
+void GameSession_AddGuard(GameSession_T * session, int x, int y)
+{
+   ActorStore_Add(&session->actors, ACTOR_KIND_GUARD, x, y);
+}
+
+int GameSession_IsLevelSetComplete(GameSession_T * session)
+{
+   return session->actors.state[0] == ACTOR_STATE_WIN &&
+          (size_t)session->level_data.level_index + 1 >= LevelSet_GetCount(session->level_data.levelset);
+}
+
+// Returns NULL past the end of the set
+static Level_T * GameSession_GetLevel(GameLevelData_T * game_level_data, int level_index)
+{
+   Level_T * level;
+
+   if(game_level_data->copy_levels == 1)
+   {
+      // Other sessions may be asking the LevelSet for other levels, so keep
+      // this one loaded until it is copied
+      LevelSet_Pin(game_level_data->levelset, level_index);
+      level = LevelSet_GetLevel(game_level_data->levelset, level_index);
+      if(level != NULL)
+      {
+         Level_Copy(&game_level_data->level_copy, level);
+         level = &game_level_data->level_copy;
+      }
+      LevelSet_Unpin(game_level_data->levelset, level_index);
+   }
+   else
+   {
+      level = LevelSet_GetLevel(game_level_data->levelset, level_index);
+   }
+   return level;
+}
+
+static void GameSession_UpdateLevel(float seconds,
+                                    EventSys_T * event_sys,
+                                    GameLevelData_T * game_level_data)
+{
+
+   Level_T * next_level;
+   Event_LevelStartPos_T     event_levelstartpos;   
+   Event_GoldAmountChanged_T event_goldamountchanged;
+   Event_InitLevel_T         * list_initlevel;
+   Event_PlayerOnGold_T      * list_playerongold;
+   size_t count, i;
+   
+   
+   while((list_initlevel = ESInbox_Get(game_level_data->inbox_initlevel, &count, NULL)) != NULL)
+   {
+      for(i = 0; i < count; i ++)
+      {
+
+         next_level = GameSession_GetLevel(game_level_data, list_initlevel[i].level_number);
+         if(next_level != NULL)
+         {
+            game_level_data->level_index = list_initlevel[i].level_number;
+            game_level_data->level = next_level;
+            Level_Restart(game_level_data->level);
+
+            event_levelstartpos.player = 0;
+            Level_GetStartSpot(game_level_data->level,
+                               &event_levelstartpos.x,
+                               &event_levelstartpos.y);
+            GameEvents_SendLevelStartPos(event_sys, &event_levelstartpos);
+
+            event_goldamountchanged.delta = 0;         
+            event_goldamountchanged.new_amount = Level_GetGoldCount(game_level_data->level, &event_goldamountchanged.new_max);
+            GameEvents_SendGoldAmountChanged(event_sys, &event_goldamountchanged);
+      
+
+         }
+      }
+   }
+
+   event_goldamountchanged.delta = 0;
+   while((list_playerongold = ESInbox_Get(game_level_data->inbox_playerongold, &count, NULL)) != NULL)
+   {
+      for(i = 0; i < count; i++)
+      {
+         Level_RemoveGold(game_level_data->level, list_playerongold[i].gold_index);
+         event_goldamountchanged.delta --;
+      }
+   }
+   event_goldamountchanged.new_amount = Level_GetGoldCount(game_level_data->level, &event_goldamountchanged.new_max);
+   if(event_goldamountchanged.delta != 0)
+   {
+      GameEvents_SendGoldAmountChanged(event_sys, &event_goldamountchanged);
+   }
+   Level_Update(game_level_data->level, seconds);
+
+}
+
+void GameSession_Update(GameSession_T * session, float seconds)
+{
+   ActorStore_T * actors;
+   Event_InputState_T * list_inputstate;
+   Event_InitLevel_T event_initlevel;
+   size_t count, i;
+   int index;
+   Uint64 counter_start;
+
+   actors = &session->actors;
+
+   PROFILER_BEGIN(e_pp_update_actors);
+   while((list_inputstate = ESInbox_Get(session->inbox_inputstate, &count, NULL)) != NULL)
+   {
+      for(i = 0; i < count; i++)
+      {
+         if(list_inputstate[i].player >= 0 && list_inputstate[i].player < session->player_count)
+         {
+            index = list_inputstate[i].player;
+            if(list_inputstate[i].state == 1)
+            {
+               actors->input[index] |= ACTOR_INPUT(list_inputstate[i].key);
+            }
+            else
+            {
+               actors->input[index] &= ~ACTOR_INPUT(list_inputstate[i].key);
+            }
+         }
+      }
+   }
+
+   // Players are judged by where they stood when the tick began
+   for(index = 0; index < session->player_count; index++)
+   {
+      GameSession_CheckPlayer(session, index);
+   }
+   PROFILER_END(e_pp_update_actors);
+
+   PROFILER_BEGIN(e_pp_update_guards);
+   GameSession_SteerGuards(session);
+   PROFILER_END(e_pp_update_guards);
+
+   // Actors already moving carry on, the rest pick their next move from
+   // the keys they hold. Anything that arrives waits for the next tick.
+   PROFILER_BEGIN(e_pp_update_actors);
+   counter_start = SDL_GetPerformanceCounter();
+   ActorStore_Advance(actors, seconds);
+   for(index = 0; index < actors->count; index++)
+   {
+      if(actors->state[index] == ACTOR_STATE_NOT_MOVING)
+      {
+         GameSession_StartMove(session, index);
+      }
+      else if(actors->state[index] == ACTOR_STATE_DEATH && actors->input[index] != 0)
+      {
+         GameSession_Respawn(session, index);
+      }
+   }
+   ActorStore_Settle(actors);
+   if(session->guard_data.harmless == 0)
+   {
+      GameSession_CatchPlayers(session);
+   }
+   session->actor_counts += SDL_GetPerformanceCounter() - counter_start;
+
+   if(session->game_input_flags[e_gigk_restart_level] == 0 && session->restart_key_prev == 1)
+   {
+      event_initlevel.level_number = session->level_data.level_index;
+      GameEvents_SendInitLevel(&session->event_sys, &event_initlevel);
+   }
+   session->restart_key_prev = session->game_input_flags[e_gigk_restart_level];
+
+   if(actors->state[0] == ACTOR_STATE_WIN)
+   {
+      // We won, so move the next level
+      event_initlevel.level_number = session->level_data.level_index + 1;
+      GameEvents_SendInitLevel(&session->event_sys, &event_initlevel);
+   }
+   PROFILER_END(e_pp_update_actors);
+
+   // Level update
+   PROFILER_BEGIN(e_pp_update_level);
+   GameSession_UpdateLevel(seconds, &session->event_sys, &session->level_data);
+   PROFILER_END(e_pp_update_level);
+
+   PROFILER_BEGIN(e_pp_update_actors);
+   GameSession_UpdatePlayers(session);
+   if(session->guard_data.level != session->level_data.level || 
+      session->guard_data.generation != session->level_data.level->generation)
+   {
+      // A level (re)started, so it gets its own guards back
+      GameSession_SpawnGuards(session, session->level_data.level);
+   }
+   PROFILER_END(e_pp_update_actors);
+}
+
+// Players start each level from its start spot
+static void GameSession_UpdatePlayers(GameSession_T * session)
+{
+   Event_LevelStartPos_T * list_levelstartpos;
+   size_t count, i;
+   int player;
+
+   while((list_levelstartpos = ESInbox_Get(session->inbox_levelstartpos, &count, NULL)) != NULL)
+   {
+      for(i = 0; i < count; i++)
+      {
+         player = list_levelstartpos[i].player;
+         if(player >= 0 && player < session->player_count)
+         {
+            session->actors.grid_x[player] = list_levelstartpos[i].x;
+            session->actors.grid_y[player] = list_levelstartpos[i].y;
+            session->actors.next_x[player] = list_levelstartpos[i].x;
+            session->actors.next_y[player] = list_levelstartpos[i].y;
+            session->actors.state[player]  = ACTOR_STATE_DEATH;
+         }
+      }
+   }
+}
+
+static void GameSession_CheckPlayer(GameSession_T * session, int player)
+{
+   ActorStore_T * actors;
+   LevelTile_T tile;
+
+   actors = &session->actors;
+   Level_QueryTile(session->level_data.level, actors->grid_x[player], actors->grid_y[player], &tile);
+   if(IsAllGoldColected(session->level_data.level) == 1 && tile.terrain_type == TMAP_TILE_DOOR)
+   {
+      // TODO: WIN!!
+      actors->state[player] = ACTOR_STATE_WIN;
+   }
+   else if(actors->state[player] != ACTOR_STATE_DEATH)
+   {
+      if(tile.out_of_range == 1 || 
+         (tile.terrain_type == TMAP_TILE_DIRT && tile.has_hole == 0))
+      {
+         actors->state[player] = ACTOR_STATE_DEATH;
+         // Dec Lifes Here?
+      }
+   }
+}
+
+// Guards hold the key for the move the flow field gives them
+static void GameSession_SteerGuards(GameSession_T * session)
+{
+   GuardData_T * guard_data;
+   ActorStore_T * actors;
+   Level_T * level;
+   Uint64 counter_start, counter_field;
+   int index, step;
+
+   guard_data = &session->guard_data;
+   actors     = &session->actors;
+   level      = session->level_data.level;
+
+   counter_start = SDL_GetPerformanceCounter();
+   if(actors->count > session->player_count)
+   {
+      FlowField_Sync(&guard_data->field, level);
+      if(actors->state[0] == ACTOR_STATE_DEATH || actors->state[0] == ACTOR_STATE_WIN)
+      {
+         // Nothing to chase, the guards stay where they are
+         FlowField_SetTarget(&guard_data->field, -1, -1);
+      }
+      else
+      {
+         FlowField_SetTarget(&guard_data->field, actors->grid_x[0], actors->grid_y[0]);
+      }
+      FlowField_Update(&guard_data->field);
+      guard_data->field_settled += guard_data->field.settled;
+   }
+   else
+   {
+      // The hole changes are about to be dropped, so build again when needed
+      FlowField_Invalidate(&guard_data->field);
+   }
+   Level_ClearHoleChanges(level);
+   counter_field = SDL_GetPerformanceCounter();
+
+   for(index = session->player_count; index < actors->count; index++)
+   {
+      step = FlowField_GetStep(&guard_data->field, actors->grid_x[index], actors->grid_y[index]);
+      switch(step)
+      {
+         case FLOWFIELD_EDGE_UP:    actors->input[index] = ACTOR_INPUT(e_gipk_move_up);    break;
+         case FLOWFIELD_EDGE_DOWN:  actors->input[index] = ACTOR_INPUT(e_gipk_move_down);  break;
+         case FLOWFIELD_EDGE_LEFT:  actors->input[index] = ACTOR_INPUT(e_gipk_move_left);  break;
+         case FLOWFIELD_EDGE_RIGHT: actors->input[index] = ACTOR_INPUT(e_gipk_move_right); break;
+         default:                   actors->input[index] = 0;                              break;
+      }
+   }
+   guard_data->field_counts += counter_field - counter_start;
+   guard_data->steer_counts += SDL_GetPerformanceCounter() - counter_field;
+}
+
+// For an actor at rest. Every actor follows the same rules, only players
+// pick up gold and dig, and guards start over when a hole closes on them.
+static void GameSession_StartMove(GameSession_T * session, int index)
+{
+   int cmd_dig_left_valid, cmd_dig_right_valid;
+   int cmd_move_left_valid, cmd_move_right_valid;
+   int cmd_move_up_valid, cmd_move_down_valid, cmd_let_go_valid, cmd_fall_valid;
+   LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND];
+   Movement_Options_T options;
+   Event_PlayerOnGold_T event_playerongold;
+   ActorStore_T * actors;
+   Level_T * level;
+   int x, y, input, is_player;
+   float move_timeout;
+
+   actors    = &session->actors;
+   level     = session->level_data.level;
+   x         = actors->grid_x[index];
+   y         = actors->grid_y[index];
+   input     = actors->input[index];
+   is_player = (actors->kind[index] == ACTOR_KIND_PLAYER) ? 1 : 0;
+   
+   Movement_QueryAround(level, x, y, around);
+   if(is_player == 0 && 
+      (around[1][1].out_of_range == 1 || 
+       (around[1][1].terrain_type == TMAP_TILE_DIRT && around[1][1].has_hole == 0)))
+   {
+      // A hole closed on the guard
+      ActorStore_Respawn(actors, index);
+   }
+   else
+   {
+      Movement_GetOptions(around, &options);
+
+      if(is_player == 1 && around[1][1].gold_index >= 0) // Remove Gold if on Gold
+      {
+         event_playerongold.player = index;
+         event_playerongold.gold_index = around[1][1].gold_index;
+         GameEvents_SendPlayerOnGold(&session->event_sys, &event_playerongold); 
+      }
+
+      cmd_fall_valid       = options.fall;
+      cmd_dig_left_valid   = options.dig_left   && is_player && (input & ACTOR_INPUT(e_gipk_dig_left));
+      cmd_dig_right_valid  = options.dig_right  && is_player && (input & ACTOR_INPUT(e_gipk_dig_right));
+      cmd_move_left_valid  = options.move_left  && (input & ACTOR_INPUT(e_gipk_move_left));
+      cmd_move_right_valid = options.move_right && (input & ACTOR_INPUT(e_gipk_move_right));
+      cmd_move_up_valid    = options.move_up    && (input & ACTOR_INPUT(e_gipk_move_up));
+      cmd_move_down_valid  = options.move_down  && (input & ACTOR_INPUT(e_gipk_move_down));
+      cmd_let_go_valid     = options.let_go     && (input & ACTOR_INPUT(e_gipk_move_down));
+
+      move_timeout = is_player ? MOVE_TIMEOUT : GUARD_MOVE_TIMEOUT;
+
+      // Compute Next Position and state based on commands
+      // Order
+      // 1. Falling
+      // 2. Digging
+      // 3. Climbing
+      // 4. Letting Go
+      // 5. Horisontal Movement
+
+      if(cmd_fall_valid == 1)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_FALLING, x, y + 1, FALL_TIMEOUT);
+      }
+      else if(cmd_dig_left_valid == 1 && cmd_dig_right_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_DIGGING, x, y, DIG_TIMEOUT);
+         Level_AddDigSpot(level, x - 1, y + 1);
+      }
+      else if(cmd_dig_right_valid == 1 && cmd_dig_left_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_DIGGING, x, y, DIG_TIMEOUT);
+         Level_AddDigSpot(level, x + 1, y + 1);
+      }
+      else if(cmd_move_up_valid == 1 && cmd_move_down_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_MOVING, x, y - 1, move_timeout);
+      }
+      else if(cmd_move_down_valid == 1 && cmd_move_up_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_MOVING, x, y + 1, move_timeout);
+      }
+      else if(cmd_let_go_valid == 1)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_FALLING, x, y + 1, FALL_TIMEOUT);
+      }
+      else if(cmd_move_left_valid == 1 && cmd_move_right_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_MOVING, x - 1, y, move_timeout);
+      }
+      else if(cmd_move_right_valid == 1 && cmd_move_left_valid == 0)
+      {
+         ActorStore_Start(actors, index, ACTOR_STATE_MOVING, x + 1, y, move_timeout);
+      }
+   }
+}
+
+// Any key brings a dead player back, and the guards go back with them
+static void GameSession_Respawn(GameSession_T * session, int player)
+{
+   session->actors.state[player] = ACTOR_STATE_NOT_MOVING;
+   Level_SetPlayerAtStart(session->level_data.level, &session->actors, player);
+   GameSession_ResetGuards(session);
+   //printf("ComeAlive!\n");
+}
+
+// A guard on or moving onto a player's tile kills them
+static void GameSession_CatchPlayers(GameSession_T * session)
+{
+   ActorStore_T * actors;
+   int player, index;
+
+   actors = &session->actors;
+   for(player = 0; player < session->player_count; player++)
+   {
+      for(index = session->player_count; index < actors->count; index++)
+      {
+         if(actors->state[player] != ACTOR_STATE_DEATH && 
+            actors->state[player] != ACTOR_STATE_WIN &&
+            ((actors->grid_x[index] == actors->grid_x[player] && 
+              actors->grid_y[index] == actors->grid_y[player]) ||
+             (actors->next_x[index] == actors->grid_x[player] && 
+              actors->next_y[index] == actors->grid_y[player])))
+         {
+            actors->state[player] = ACTOR_STATE_DEATH;
+         }
+      }
+   }
+}
+
+static void GameSession_SpawnGuards(GameSession_T * session, Level_T * level)
+{
+   Pos2D_T * spot;
+   size_t count, i;
+
+   ActorStore_Truncate(&session->actors, session->player_count);
+   spot = Level_GetGuardSpots(level, &count);
+   for(i = 0; i < count; i++)
+   {
+      ActorStore_Add(&session->actors, ACTOR_KIND_GUARD, spot[i].x, spot[i].y);
+   }
+   session->guard_data.level      = level;
+   session->guard_data.generation = level->generation;
+}
+
+static void GameSession_ResetGuards(GameSession_T * session)
+{
+   int index;
+   for(index = session->player_count; index < session->actors.count; index++)
+   {
+      ActorStore_Respawn(&session->actors, index);
+   }
+}
+
+
+static int IsAllGoldColected(Level_T * level)
+{
+   int all_gold_colected;
+   int gold_count;
+ 
+   gold_count = Level_GetGoldCount(level, NULL);
+   if(gold_count > 0)
+   {
+      all_gold_colected = 0;
+   }
+   else
+   {
+      all_gold_colected = 1;
+   }
+   return all_gold_colected;
+}
+
+static void Level_SetPlayerAtStart(Level_T * level, ActorStore_T * actors, int player)
+{
+   Level_GetStartSpot(level, &actors->grid_x[player], &actors->grid_y[player]);
+   actors->next_x[player] = actors->grid_x[player];
+   actors->next_y[player] = actors->grid_y[player];
+}
+
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __GAMESESSION_H__
+#define __GAMESESSION_H__
+
+// One game being played: a level, the actors on it and the events between
+// them.
+// Sessions share nothing but the LevelSet, so several can be updated at
+// once on different threads when each plays its own copy of the levels.
+
+typedef struct GameLevelData_S           GameLevelData_T;
+typedef struct GuardData_S               GuardData_T;
+typedef struct GameSession_S             GameSession_T;
+
+struct GameLevelData_S
+{
+   int level_index;
+   LevelSet_T * levelset;
+   Level_T * level;
+   int copy_levels;      // Play level_copy rather than the LevelSet's level
+   Level_T level_copy;
+   ESInbox_T * inbox_playerongold;
+   ESInbox_T * inbox_initlevel;
+};
+
+// Guards are actors that can't dig. Each tick they hold the key for
+// whichever move the flow field says gets them closest to player 1.
+struct GuardData_S
+{
+   FlowField_T field;      // Shared by every guard
+   Level_T * level;        // Guards were spawned for this level
+   int generation;         // and generation
+   Uint64 field_counts;    // Performance counts spent keeping field current
+   Uint64 steer_counts;    // and picking guard moves, since the session started
+   long field_settled;     // Tiles the field has settled, also since start
+   int harmless;           // Set to let guards pass through players, so
+                           // benchmarks always have a player to chase
+};
+
+struct GameSession_S
+{
+   EventSys_T event_sys;
+   GameLevelData_T level_data;
+   ActorStore_T actors;    // Players first, then the level's guards
+   int player_count;
+   GuardData_T guard_data;
+   Uint64 actor_counts;    // Performance counts spent moving actors
+   ESInbox_T * inbox_levelstartpos;
+   ESInbox_T * inbox_inputstate;
+   int game_input_flags[e_gigk_last];
+   int restart_key_prev;
+};
+
+// Starts on level_index. With copy_levels set the session restarts a copy
+// of each level it plays, leaving the levels in levelset untouched.
+void GameSession_Init(GameSession_T * session, LevelSet_T * levelset, int level_index, int copy_levels);
+void GameSession_Destroy(GameSession_T * session);
+
+// Runs one tick of the game logic
+void GameSession_Update(GameSession_T * session, float seconds);
+
+// Input is seen by the next GameSession_Update
+void GameSession_SetPlayerKey(GameSession_T * session, int player, GameInput_PlayerKeys_T key, int state);
+void GameSession_SetGameKey(GameSession_T * session, GameInput_GameKeys_T key, int state);
+
+// Adds a guard to the level being played. Guards come from the level each
+// time it starts, so guards added this way last until the next start.
+void GameSession_AddGuard(GameSession_T * session, int x, int y);
+
+// True once the player has won the last level of the set
+int  GameSession_IsLevelSetComplete(GameSession_T * session);
+
+
+#endif // __GAMESESSION_H__
+
@@ -51,7 +51,9 @@ static void GameSettings_ParseFile(void)
 
    // Fill key data
 
-   settings.game_keys[e_gigk_restart_level] = settings.config.controls_game_restart_level;
+   settings.game_keys[e_gigk_restart_level]   = settings.config.controls_game_restart_level;
+   settings.game_keys[e_gigk_toggle_profiler] = settings.config.controls_game_toggle_profiler;
+   settings.game_keys[e_gigk_dump_event_stats] = settings.config.controls_game_dump_event_stats;
    // Fill player key data
    settings.player1_keys.key_string[e_gipk_move_up]    = settings.config.controls_player1_move_up;
    settings.player1_keys.key_string[e_gipk_move_down]  = settings.config.controls_player1_move_down;
@@ -61,6 +63,28 @@ static void GameSettings_ParseFile(void)
    settings.player1_keys.key_string[e_gipk_dig_right]  = settings.config.controls_player1_dig_right;
 
 
+   // Frame pacing, anything unusable falls back to vsync
+   settings.pacing = e_gsp_vsync;
+   if(SDL_strcasecmp(settings.config.window_pacing, "capped") == 0)
+   {
+      if(settings.config.window_fps_cap > 0)
+      {
+         settings.pacing = e_gsp_capped;
+      }
+      else
+      {
+         printf("window.fps_cap must be above 0 to cap frames, using vsync\n");
+      }
+   }
+   else if(SDL_strcasecmp(settings.config.window_pacing, "uncapped") == 0)
+   {
+      settings.pacing = e_gsp_uncapped;
+   }
+   else if(SDL_strcasecmp(settings.config.window_pacing, "vsync") != 0)
+   {
+      printf("Unknown window.pacing \"%s\", using vsync\n", settings.config.window_pacing);
+   }
+
    // Compute actual music volumes based on master
    settings.raw_volume_music = (int)(MIX_MAX_VOLUME * (
                                (settings.config.volume_master / 100.0f) *
@@ -3,6 +3,15 @@
 
 typedef struct GameSettings_S            GameSettings_T;
 typedef struct GameSettings_PlayerKeys_S GameSettings_PlayerKeys_T;
+typedef enum   GameSettings_Pacing_E     GameSettings_Pacing_T;
+
+// From window.pacing
+enum GameSettings_Pacing_E
+{
+   e_gsp_vsync,    // Present waits for the display
+   e_gsp_capped,   // Frames are held to window.fps_cap
+   e_gsp_uncapped  // As many frames as possible, for benchmarking
+};
 
 struct GameSettings_PlayerKeys_S
 {
@@ -15,6 +24,7 @@ struct GameSettings_S
    int raw_volume_effects;
    GameSettings_PlayerKeys_T player1_keys;
    const char * game_keys[e_gigk_last];
+   GameSettings_Pacing_T pacing;
 };
 
 
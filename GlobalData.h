@@ -50,6 +50,7 @@
 #define HOLE_TIMEOUT             5.0f
 #define DIG_SPOT_DELATA_FRAME_TIMEOUT 0.1f
 #define DIG_SPOT_FRAME_COUNT     3
+#define GUARD_MOVE_TIMEOUT       0.45f
 
 #endif // __GLOBALDATA_H__
 
@@ -0,0 +1,191 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "InputLog.h"
+
+#define KEY_BITS 7
+
+static void InputLog_WriteVarint(FILE * file, unsigned long value);
+static int  InputLog_ReadVarint(FILE * file, unsigned long * value);
+static void InputLog_ReadAhead(InputLog_T * log);
+
+int InputLog_OpenRecord(InputLog_T * log, const char * filename, int tick_rate)
+{
+   log->file       = fopen(filename, "wb");
+   log->recording  = 1;
+   log->tick_rate  = tick_rate;
+   log->tick       = 0;
+   log->has_record = 0;
+   log->ended      = 0;
+   if(log->file == NULL)
+   {
+      printf("Error: Could not create input log \"%s\"\n", filename);
+      return 0;
+   }
+   fwrite(INPUTLOG_MAGIC, 1, INPUTLOG_MAGIC_SIZE, log->file);
+   InputLog_WriteVarint(log->file, (unsigned long)tick_rate);
+   return 1;
+}
+
+int InputLog_OpenReplay(InputLog_T * log, const char * filename)
+{
+   char magic[INPUTLOG_MAGIC_SIZE];
+   unsigned long tick_rate;
+
+   log->file       = fopen(filename, "rb");
+   log->recording  = 0;
+   log->tick_rate  = 0;
+   log->tick       = 0;
+   log->has_record = 0;
+   log->ended      = 1;
+   if(log->file == NULL)
+   {
+      printf("Error: Could not open input log \"%s\"\n", filename);
+      return 0;
+   }
+
+   if(fread(magic, 1, INPUTLOG_MAGIC_SIZE, log->file) != INPUTLOG_MAGIC_SIZE ||
+      memcmp(magic, INPUTLOG_MAGIC, INPUTLOG_MAGIC_SIZE) != 0 ||
+      !InputLog_ReadVarint(log->file, &tick_rate))
+   {
+      printf("Error: \"%s\" is not an input log\n", filename);
+      fclose(log->file);
+      log->file = NULL;
+      return 0;
+   }
+   log->tick_rate = (int)tick_rate;
+   log->ended     = 0;
+   InputLog_ReadAhead(log);
+   return 1;
+}
+
+void InputLog_Close(InputLog_T * log, unsigned long tick)
+{
+   if(log->file != NULL)
+   {
+      if(log->recording == 1)
+      {
+         InputLog_WriteVarint(log->file, tick - log->tick);
+         InputLog_WriteVarint(log->file, 0);
+      }
+      fclose(log->file);
+      log->file = NULL;
+   }
+}
+
+void InputLog_Write(InputLog_T * log, unsigned long tick, int player, int key, int state)
+{
+   unsigned long code;
+   if(log->file != NULL)
+   {
+      // Code 0 is the end marker, so codes start at 1
+      code = ((((unsigned long)(player + 1) << KEY_BITS) | (unsigned long)key) << 1) | 
+             (state != 0 ? 1 : 0);
+      InputLog_WriteVarint(log->file, tick - log->tick);
+      InputLog_WriteVarint(log->file, code + 1);
+      log->tick = tick;
+   }
+}
+
+int InputLog_Read(InputLog_T * log, unsigned long tick, int * player, int * key, int * state)
+{
+   int result;
+   if(log->has_record == 1 && log->tick <= tick)
+   {
+      (*player) = log->player;
+      (*key)    = log->key;
+      (*state)  = log->state;
+      InputLog_ReadAhead(log);
+      result = 1;
+   }
+   else
+   {
+      result = 0;
+   }
+   return result;
+}
+
+int InputLog_IsFinished(InputLog_T * log, unsigned long tick)
+{
+   return log->ended == 1 && log->has_record == 0 && tick >= log->tick;
+}
+
+static void InputLog_ReadAhead(InputLog_T * log)
+{
+   unsigned long delta, code;
+   log->has_record = 0;
+   if(log->ended == 0)
+   {
+      if(!InputLog_ReadVarint(log->file, &delta) || 
+         !InputLog_ReadVarint(log->file, &code))
+      {
+         // Truncated log, stop where it stops
+         log->ended = 1;
+      }
+      else
+      {
+         log->tick += delta;
+         if(code == 0)
+         {
+            log->ended = 1;
+         }
+         else
+         {
+            code --;
+            log->state      = (int)(code & 1);
+            log->key        = (int)((code >> 1) & ((1 << KEY_BITS) - 1));
+            log->player     = (int)(code >> (KEY_BITS + 1)) - 1;
+            log->has_record = 1;
+         }
+      }
+   }
+}
+
+// Seven bits per byte, low bits first, high bit set on all but the last
+static void InputLog_WriteVarint(FILE * file, unsigned long value)
+{
+   while(value >= 0x80)
+   {
+      fputc((int)((value & 0x7F) | 0x80), file);
+      value >>= 7;
+   }
+   fputc((int)value, file);
+}
+
+static int InputLog_ReadVarint(FILE * file, unsigned long * value)
+{
+   int c, shift;
+   (*value) = 0;
+   shift = 0;
+   do
+   {
+      c = fgetc(file);
+      if(c == EOF || shift > 28)
+      {
+         return 0;
+      }
+      (*value) |= (unsigned long)(c & 0x7F) << shift;
+      shift += 7;
+   } while(c & 0x80);
+   return 1;
+}
+
@@ -0,0 +1,65 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __INPUTLOG_H__
+#define __INPUTLOG_H__
+
+// Records input changes against the simulation tick they take effect on,
+// and plays them back. Player is -1 for game keys.
+//
+// File layout: INPUTLOG_MAGIC, then varints. First the tick rate, then
+// per record the ticks since the previous record and a code holding
+// player, key and state. A code of 0 ends the log.
+
+#define INPUTLOG_MAGIC      "LCIN"
+#define INPUTLOG_MAGIC_SIZE 4
+
+typedef struct InputLog_S InputLog_T;
+
+struct InputLog_S
+{
+   FILE        * file;
+   int           recording;
+   int           tick_rate;
+   unsigned long tick;       // Tick of the last record written or read
+   int           has_record; // Replay: a record has been read ahead
+   int           ended;      // Replay: the end marker has been read
+   int           player;
+   int           key;
+   int           state;
+};
+
+// Both return 0 if the file could not be opened
+int  InputLog_OpenRecord(InputLog_T * log, const char * filename, int tick_rate);
+int  InputLog_OpenReplay(InputLog_T * log, const char * filename);
+
+// Writes the end marker when recording
+void InputLog_Close(InputLog_T * log, unsigned long tick);
+
+void InputLog_Write(InputLog_T * log, unsigned long tick, int player, int key, int state);
+
+// Call until it returns 0 to get every record for tick
+int  InputLog_Read(InputLog_T * log, unsigned long tick, int * player, int * key, int * state);
+
+// True once tick is at or past the tick the recording ended on
+int  InputLog_IsFinished(InputLog_T * log, unsigned long tick);
+
+#endif // __INPUTLOG_H__
+
@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "IntMap.h"
+
+#define DEFAULT_SIZE 16
+#define EMPTY_KEY    -1
+
+static size_t IntMap_Home(const IntMap_T * map, int key)
+{
+   // Fibonacci hashing, the top bits of the product depend on every bit of
+   // the key so keys a power of two apart still get different homes
+   return ((unsigned int)key * 2654435761u) >> map->shift;
+}
+
+static void IntMap_Alloc(IntMap_T * map, size_t size)
+{
+   size_t i;
+   map->keys   = malloc(sizeof(int) * size);
+   map->values = malloc(sizeof(int) * size);
+   map->size   = size;
+   map->count  = 0;
+   map->shift  = 32;
+   while(size > 1)
+   {
+      map->shift --;
+      size >>= 1;
+   }
+   for(i = 0; i < map->size; i++)
+   {
+      map->keys[i] = EMPTY_KEY;
+   }
+}
+
+static void IntMap_Grow(IntMap_T * map)
+{
+   int * old_keys, * old_values;
+   size_t i, old_size;
+
+   old_keys   = map->keys;
+   old_values = map->values;
+   old_size   = map->size;
+
+   IntMap_Alloc(map, (old_size == 0) ? DEFAULT_SIZE : old_size * 2);
+   for(i = 0; i < old_size; i++)
+   {
+      if(old_keys[i] != EMPTY_KEY)
+      {
+         IntMap_Set(map, old_keys[i], old_values[i]);
+      }
+   }
+
+   free(old_keys);
+   free(old_values);
+}
+
+// Nothing is allocated until the first IntMap_Set, most maps a level
+// keeps stay empty for much of its life
+void   IntMap_Init(IntMap_T * map)
+{
+   map->keys   = NULL;
+   map->values = NULL;
+   map->count  = 0;
+   map->size   = 0;
+   map->shift  = 32;
+}
+
+void   IntMap_Destroy(IntMap_T * map)
+{
+   free(map->keys);
+   free(map->values);
+   map->keys   = NULL;
+   map->values = NULL;
+   map->count  = 0;
+   map->size   = 0;
+}
+
+void   IntMap_Set(IntMap_T * map, int key, int value)
+{
+   size_t i;
+
+   // Keep the load factor under 3/4 so probe runs stay short
+   if((map->count + 1) * 4 > map->size * 3)
+   {
+      IntMap_Grow(map);
+   }
+
+   i = IntMap_Home(map, key);
+   while(map->keys[i] != EMPTY_KEY && map->keys[i] != key)
+   {
+      i = (i + 1) & (map->size - 1);
+   }
+
+   if(map->keys[i] == EMPTY_KEY)
+   {
+      map->keys[i] = key;
+      map->count ++;
+   }
+   map->values[i] = value;
+}
+
+int  * IntMap_Get(const IntMap_T * map, int key)
+{
+   size_t i;
+   int * result;
+
+   result = NULL;
+   if(map->count > 0)
+   {
+      i = IntMap_Home(map, key);
+      while(map->keys[i] != EMPTY_KEY)
+      {
+         if(map->keys[i] == key)
+         {
+            result = &map->values[i];
+            break;
+         }
+         i = (i + 1) & (map->size - 1);
+      }
+   }
+   return result;
+}
+
+void   IntMap_Remove(IntMap_T * map, int key)
+{
+   size_t i, j, home, mask;
+
+   if(map->count == 0)
+   {
+      return;
+   }
+
+   mask = map->size - 1;
+   i = IntMap_Home(map, key);
+   while(map->keys[i] != EMPTY_KEY && map->keys[i] != key)
+   {
+      i = (i + 1) & mask;
+   }
+
+   if(map->keys[i] == key)
+   {
+      map->keys[i] = EMPTY_KEY;
+      map->count --;
+
+      // Shift later entries of the probe run back so lookups never
+      // stop early on the new gap
+      j = i;
+      while(1)
+      {
+         j = (j + 1) & mask;
+         if(map->keys[j] == EMPTY_KEY)
+         {
+            break;
+         }
+
+         home = IntMap_Home(map, map->keys[j]);
+         if(((j - home) & mask) >= ((j - i) & mask))
+         {
+            map->keys[i]   = map->keys[j];
+            map->values[i] = map->values[j];
+            map->keys[j]   = EMPTY_KEY;
+            i = j;
+         }
+      }
+   }
+}
+
+void   IntMap_Clear(IntMap_T * map)
+{
+   size_t i;
+   if(map->count > 0)
+   {
+      for(i = 0; i < map->size; i++)
+      {
+         map->keys[i] = EMPTY_KEY;
+      }
+      map->count = 0;
+   }
+}
+
+void   IntMap_Copy(IntMap_T * dest, const IntMap_T * src)
+{
+   if(dest->size != src->size)
+   {
+      IntMap_Destroy(dest);
+      if(src->size > 0)
+      {
+         IntMap_Alloc(dest, src->size);
+      }
+   }
+   if(src->size > 0)
+   {
+      memcpy(dest->keys,   src->keys,   sizeof(int) * src->size);
+      memcpy(dest->values, src->values, sizeof(int) * src->size);
+   }
+   dest->count = src->count;
+}
+
+size_t IntMap_GetMemoryUsage(const IntMap_T * map)
+{
+   return map->size * (sizeof(int) + sizeof(int));
+}
+
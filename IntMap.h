@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __INTMAP_H__
+#define __INTMAP_H__
+
+// Hash map from non-negative int keys to int values
+
+typedef struct IntMap_S IntMap_T;
+
+struct IntMap_S
+{
+   int    * keys;
+   int    * values;
+   size_t   count;
+   size_t   size;      // A power of two, 0 until the first IntMap_Set
+   int      shift;     // 32 - log2(size)
+};
+
+void   IntMap_Init(IntMap_T * map);
+void   IntMap_Destroy(IntMap_T * map);
+
+void   IntMap_Set(IntMap_T * map, int key, int value);
+int  * IntMap_Get(const IntMap_T * map, int key);
+
+void   IntMap_Remove(IntMap_T * map, int key);
+void   IntMap_Clear(IntMap_T * map);
+
+// Makes dest hold the same entries as src, dest must be initialized
+void   IntMap_Copy(IntMap_T * dest, const IntMap_T * src);
+
+size_t IntMap_GetMemoryUsage(const IntMap_T * map);
+
+#endif // __INTMAP_H__
+
@@ -20,69 +20,223 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "SDLInclude.h"
 
 #include "GlobalData.h"
-#include "SDLTools.h"
 
 #include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
 #include "Pos2D.h"
+#include "MappedFile.h"
+#include "LevelFormat.h"
 #include "Level.h"
 
-
 static void TerrainMap_Init(TerrainMap_T * map, int width, int height);
 
 static void TerrainMap_Destroy(TerrainMap_T * map);
+static void TerrainMap_Copy(TerrainMap_T * dest, const TerrainMap_T * src);
+
+static TerrainChunk_T * TerrainMap_GetChunk(TerrainMap_T * map, int x, int y);
+static TerrainChunk_T * TerrainMap_GetWritableChunk(TerrainMap_T * map, int x, int y);
+
+static int  TerrainMap_GetTile(TerrainMap_T * map, int x, int y);
+static void TerrainMap_SetTile(TerrainMap_T * map, int x, int y, int terrain_type);
+static void TerrainMap_SetRow(TerrainMap_T * map, int y, const uint8_t * row);
+
+static int  TerrainMap_TestBit(TerrainMap_T * map, int plane, int x, int y);
+static void TerrainMap_SetBit(TerrainMap_T * map, int plane, int x, int y);
+static void TerrainMap_ClearBit(TerrainMap_T * map, int plane, int x, int y);
+static void TerrainMap_ClearPlane(TerrainMap_T * map, int plane);
+
+static size_t TerrainMap_GetMemoryUsage(TerrainMap_T * map);
+
+
+static void Level_LoadText(Level_T * level, FILE * fp);
+static int  Level_LoadBinary(Level_T * level, const MappedFile_T * mapped);
+static int  Level_CheckPositions(const uint8_t * data, size_t count, const LevelFormatHeader_T * header);
+static int  Level_CheckUnique(const uint8_t * data, size_t count, int width);
+static int  Level_CheckTiles(const LevelFormatHeader_T * header, const uint8_t * tiles, uint64_t * door_tiles);
+static int  Level_CheckDoors(TerrainMap_T * map, const uint8_t * data, size_t count);
+static void Level_LoadTiles(TerrainMap_T * map, const LevelFormatHeader_T * header, const uint8_t * tiles);
+static void Level_UpdateDoors(Level_T * level);
+static int  Level_DivFloor(int value, int divisor);
+static Gold_T * Level_GetGoldAt(Level_T * level, int tile_index, size_t * out_index);
+
+static int  Level_DigWheel_GetTick(double time);
+static void Level_DigWheel_Link(Level_T * level, DigSpot_T * dig_spot, int index);
+static void Level_DigWheel_Clear(Level_T * level);
+static void Level_DigSpot_Advance(DigSpot_T * dig_spot);
+static void Level_RemoveDigSpot(Level_T * level, int index);
+static int  Level_CompareIndexDescending(const void * a, const void * b);
+static void Level_CopyList(ArrayList_T * dest, const ArrayList_T * src);
+
+static void Level_Render_DigSpot(SDLTools_Batch_T * batch, SDL_Texture * t_terrain, DigSpot_T * dig_spot, int x, int y);
+static int  Level_Render_Tile(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, SDL_Texture * t_terrain, int x, int y, int draw_x, int draw_y);
+static void Level_Render_Direct(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats);
+static void Level_Render_Gold(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats);
+static int  Level_Render_Cached(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, LevelRenderCache_T * cache, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats);
+static void LevelSnapshot_CopyGold(LevelSnapshot_T * snapshot, Level_T * level);
+
+static void LevelRenderCache_Invalidate(LevelRenderCache_T * cache);
+static LevelRenderCacheSlot_T * LevelRenderCache_GetSlot(LevelRenderCache_T * cache, int block, int * is_new);
+static void LevelRenderCache_MarkTile(LevelRenderCache_T * cache, int blocks_wide, int x, int y);
+static void LevelRenderCache_MarkChanges(LevelRenderCache_T * cache, const LevelSnapshot_T * snapshot);
+static void LevelRenderCache_Remember(LevelRenderCache_T * cache, const LevelSnapshot_T * snapshot);
 
-//static int TerrainMap_GetTile(TerrainMap_T * map, int x, int y);
+// S TerrainMap
 
+// Stands in for every chunk that is still all air. It is never written.
+static TerrainChunk_T TerrainMap_EmptyChunk;
 
+// Each Level_Restart takes a new value so render caches can't mix up levels.
+// Atomic since levels are also loaded on the LevelSet worker thread.
+static SDL_atomic_t Level_NextGeneration;
 
+static void TerrainMap_Init(TerrainMap_T * map, int width, int height)
+{
+   int i;
+   map->width        = width; 
+   map->height       = height;
+   map->chunk_width  = (width  + TMAP_CHUNK_MASK) >> TMAP_CHUNK_SHIFT;
+   map->chunk_height = (height + TMAP_CHUNK_MASK) >> TMAP_CHUNK_SHIFT;
+   map->chunk_count  = 0;
+   map->chunks       = malloc(sizeof(TerrainChunk_T *) * map->chunk_width * map->chunk_height);
+   for(i = 0; i < map->chunk_width * map->chunk_height; i ++)
+   {
+      map->chunks[i] = &TerrainMap_EmptyChunk;
+   }
+}
 
-static void Level_Render_DigSpot(SDL_Renderer * rend, SDL_Texture * t_terrain, DigSpot_T * dig_spot, int x, int y);
+static void TerrainMap_Destroy(TerrainMap_T * map)
+{
+   int i;
+   for(i = 0; i < map->chunk_width * map->chunk_height; i ++)
+   {
+      if(map->chunks[i] != &TerrainMap_EmptyChunk)
+      {
+         free(map->chunks[i]);
+      }
+   }
+   free(map->chunks);
+   map->chunks      = NULL;
+   map->chunk_count = 0;
+}
 
-// S TerrainMap
+// dest must not hold any chunks
+static void TerrainMap_Copy(TerrainMap_T * dest, const TerrainMap_T * src)
+{
+   int i;
+   TerrainMap_Init(dest, src->width, src->height);
+   for(i = 0; i < src->chunk_width * src->chunk_height; i ++)
+   {
+      if(src->chunks[i] != &TerrainMap_EmptyChunk)
+      {
+         dest->chunks[i] = malloc(sizeof(TerrainChunk_T));
+         memcpy(dest->chunks[i], src->chunks[i], sizeof(TerrainChunk_T));
+      }
+   }
+   dest->chunk_count = src->chunk_count;
+}
 
+static TerrainChunk_T * TerrainMap_GetChunk(TerrainMap_T * map, int x, int y)
+{
+   return map->chunks[(x >> TMAP_CHUNK_SHIFT) + 
+                      ((y >> TMAP_CHUNK_SHIFT) * map->chunk_width)];
+}
 
-static void TerrainMap_Init(TerrainMap_T * map, int width, int height)
+static TerrainChunk_T * TerrainMap_GetWritableChunk(TerrainMap_T * map, int x, int y)
 {
-   size_t i;
-   size_t size;
-   map->width  = width; 
-   map->height = height;
-   size        = width * height;
-   map->data   = malloc(sizeof(int) * size);
-   for(i = 0; i < size; i ++)
+   TerrainChunk_T ** chunk;
+   chunk = &map->chunks[(x >> TMAP_CHUNK_SHIFT) + 
+                        ((y >> TMAP_CHUNK_SHIFT) * map->chunk_width)];
+   if((*chunk) == &TerrainMap_EmptyChunk)
    {
-      map->data[i] = TMAP_TILE_AIR;
+      (*chunk) = calloc(1, sizeof(TerrainChunk_T));
+      map->chunk_count ++;
    }
+   return (*chunk);
 }
 
-static void TerrainMap_Destroy(TerrainMap_T * map)
+static int  TerrainMap_GetTile(TerrainMap_T * map, int x, int y)
 {
-   free(map->data);
-   map->data = NULL;
+   return TerrainMap_GetChunk(map, x, y)->terrain[(x & TMAP_CHUNK_MASK) + 
+                                                  ((y & TMAP_CHUNK_MASK) << TMAP_CHUNK_SHIFT)];
 }
 
-/*
-static int TerrainMap_GetTile(TerrainMap_T * map, int x, int y)
+static void TerrainMap_SetTile(TerrainMap_T * map, int x, int y, int terrain_type)
 {
-   int index;
-   int result;
-   if(x >= 0 && x < map->width && y >= 0 && y < map->height)
+   TerrainChunk_T * chunk;
+   chunk = TerrainMap_GetChunk(map, x, y);
+   if(terrain_type != TMAP_TILE_AIR || chunk != &TerrainMap_EmptyChunk)
    {
-      index = x + (map->width * y);
-      result = map->data[index];
+      chunk = TerrainMap_GetWritableChunk(map, x, y);
+      chunk->terrain[(x & TMAP_CHUNK_MASK) + ((y & TMAP_CHUNK_MASK) << TMAP_CHUNK_SHIFT)] = (uint8_t)terrain_type;
    }
-   else
+}
+
+// Copies a full row of tiles, skipping the parts of it that are all air
+static void TerrainMap_SetRow(TerrainMap_T * map, int y, const uint8_t * row)
+{
+   static const uint8_t air[TMAP_CHUNK_SIZE];
+   TerrainChunk_T * chunk;
+   int x, count;
+   for(x = 0; x < map->width; x += TMAP_CHUNK_SIZE)
    {
-      printf("Error: (%i, %i) is Out of Map Range\n", x, y);
-      result = TMAP_TILE_AIR;
+      count = map->width - x;
+      if(count > TMAP_CHUNK_SIZE)
+      {
+         count = TMAP_CHUNK_SIZE;
+      }
+
+      chunk = TerrainMap_GetChunk(map, x, y);
+      if(chunk != &TerrainMap_EmptyChunk || memcmp(&row[x], air, count) != 0)
+      {
+         chunk = TerrainMap_GetWritableChunk(map, x, y);
+         memcpy(&chunk->terrain[(y & TMAP_CHUNK_MASK) << TMAP_CHUNK_SHIFT], &row[x], count);
+      }
    }
-   return result;
 }
-*/
+
+static int  TerrainMap_TestBit(TerrainMap_T * map, int plane, int x, int y)
+{
+   return (TerrainMap_GetChunk(map, x, y)->bits[plane][y & TMAP_CHUNK_MASK] >> (x & TMAP_CHUNK_MASK)) & 1;
+}
+
+static void TerrainMap_SetBit(TerrainMap_T * map, int plane, int x, int y)
+{
+   TerrainMap_GetWritableChunk(map, x, y)->bits[plane][y & TMAP_CHUNK_MASK] |= (1u << (x & TMAP_CHUNK_MASK));
+}
+
+static void TerrainMap_ClearBit(TerrainMap_T * map, int plane, int x, int y)
+{
+   TerrainChunk_T * chunk;
+   chunk = TerrainMap_GetChunk(map, x, y);
+   if(chunk != &TerrainMap_EmptyChunk)
+   {
+      chunk->bits[plane][y & TMAP_CHUNK_MASK] &= ~(1u << (x & TMAP_CHUNK_MASK));
+   }
+}
+
+static void TerrainMap_ClearPlane(TerrainMap_T * map, int plane)
+{
+   int i;
+   for(i = 0; i < map->chunk_width * map->chunk_height; i ++)
+   {
+      if(map->chunks[i] != &TerrainMap_EmptyChunk)
+      {
+         memset(map->chunks[i]->bits[plane], 0, sizeof(map->chunks[i]->bits[plane]));
+      }
+   }
+}
+
+static size_t TerrainMap_GetMemoryUsage(TerrainMap_T * map)
+{
+   return (sizeof(TerrainChunk_T *) * map->chunk_width * map->chunk_height) + 
+          (sizeof(TerrainChunk_T) * map->chunk_count);
+}
 
 // E TerrainMap
 // S Level
@@ -94,8 +248,18 @@ void Level_Init(Level_T * level)
    ArrayList_Init(&level->dig_list,       sizeof(DigSpot_T), 0);
    ArrayList_Init(&level->gold_list,      sizeof(Gold_T),    0);
    ArrayList_Init(&level->gold_list_init, sizeof(Gold_T),    0);
+   ArrayList_Init(&level->door_list,      sizeof(Pos2D_T),   0);
+   ArrayList_Init(&level->guard_list,     sizeof(Pos2D_T),   0);
+   IntMap_Init(&level->gold_map);
+   IntMap_Init(&level->dig_map);
+   ArrayList_Init(&level->dig_closed,     sizeof(int),       0);
+   ArrayList_Init(&level->hole_changes,   sizeof(Pos2D_T),   0);
+   Level_DigWheel_Clear(level);
    level->start_spot.x = 0;
    level->start_spot.y = 0;
+   level->generation = SDL_AtomicAdd(&Level_NextGeneration, 1) + 1;
+   level->gold_version = 0;
+   level->doors_open   = 0;
 }
 
 void Level_Destroy(Level_T * level)
@@ -104,298 +268,1323 @@ void Level_Destroy(Level_T * level)
    ArrayList_Destroy(&level->dig_list);
    ArrayList_Destroy(&level->gold_list);
    ArrayList_Destroy(&level->gold_list_init);
+   ArrayList_Destroy(&level->door_list);
+   ArrayList_Destroy(&level->guard_list);
+   IntMap_Destroy(&level->gold_map);
+   IntMap_Destroy(&level->dig_map);
+   ArrayList_Destroy(&level->dig_closed);
+   ArrayList_Destroy(&level->hole_changes);
+}
+
+static int  Level_DivFloor(int value, int divisor)
+{
+   int result;
+   result = value / divisor;
+   if((value % divisor) != 0 && value < 0)
+   {
+      result --;
+   }
+   return result;
+}
+
+static Gold_T * Level_GetGoldAt(Level_T * level, int tile_index, size_t * out_index)
+{
+   int * index;
+   index = IntMap_Get(&level->gold_map, tile_index);
+   if(out_index != NULL)
+   {
+      (*out_index) = (*index);
+   }
+   return ArrayList_GetIndex(&level->gold_list, *index);
+}
+
+// Every door opens once the last gold is picked up
+static void Level_UpdateDoors(Level_T * level)
+{
+   level->doors_open = (Level_GetGoldCount(level, NULL) == 0) ? 1 : 0;
+}
+
+// Compiled levels start with LEVELFORMAT_MAGIC, anything else is a text map
+void Level_Load(Level_T * level, const char * filename)
+{
+   FILE * fp;
+   MappedFile_T mapped;
+   char magic[LEVELFORMAT_MAGIC_SIZE];
+
+   fp = fopen(filename, "rb");
+
+   if(fp == NULL)
+   {
+      printf("Error: Could not open \"%s\"\n", filename);
+   }
+   else if(fread(magic, 1, LEVELFORMAT_MAGIC_SIZE, fp) == LEVELFORMAT_MAGIC_SIZE &&
+           memcmp(magic, LEVELFORMAT_MAGIC, LEVELFORMAT_MAGIC_SIZE) == 0)
+   {
+      fclose(fp);
+      if(!MappedFile_Open(&mapped, filename))
+      {
+         printf("Error: Could not map \"%s\"\n", filename);
+      }
+      else
+      {
+         if(Level_LoadBinary(level, &mapped))
+         {
+            Level_Restart(level);
+         }
+         else
+         {
+            printf("Error: \"%s\" is not a valid compiled level\n", filename);
+         }
+         MappedFile_Close(&mapped);
+      }
+   }
+   else
+   {
+      rewind(fp);
+      Level_LoadText(level, fp);
+      fclose(fp);
+      Level_Restart(level);
+   }
+}
+
+static void Level_LoadText(Level_T * level, FILE * fp)
+{
+   int input, index;
+   int w, h;
+   TerrainMap_T * map;
+   Pos2D_T p;
+   Gold_T * gold;
+   Pos2D_T * door;
+   Pos2D_T * guard;
+   size_t size;
+
+   map = &level->tmap;
+   fscanf(fp, "%i", &w);
+   fscanf(fp, "%i", &h);
+   TerrainMap_Destroy(map);
+
+   TerrainMap_Init(map, w, h);
+   ArrayList_Clear(&level->door_list);
+   ArrayList_Clear(&level->gold_list_init);
+   ArrayList_Clear(&level->guard_list);
+   size = w * h;
+   index = 0;
+   p.x = p.y = 0;
+   while(!feof(fp) && index < size)
+   {
+      fscanf(fp, "%i", &input);
+      switch(input)
+      {
+         case 0:  TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_AIR);    break;
+         case 1:  TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_DIRT);   break;
+         case 2:  
+            level->start_spot.x = p.x;
+            level->start_spot.y = p.y;
+            break;
+         case 3:  TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_LADDER); break;
+         case 4:  TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_BAR);    break;
+         case 5:
+            TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_AIR);
+            gold = ArrayList_Add(&level->gold_list_init, NULL);
+            gold->pos.x = p.x;
+            gold->pos.y = p.y;
+            break;
+         case 6:
+            TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_DOOR);
+            door = ArrayList_Add(&level->door_list, NULL);
+            door->x = p.x;
+            door->y = p.y;
+            break;
+         case 7:
+            TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_AIR);
+            guard = ArrayList_Add(&level->guard_list, NULL);
+            guard->x = p.x;
+            guard->y = p.y;
+            break;
+         default: TerrainMap_SetTile(map, p.x, p.y, TMAP_TILE_AIR);    break;
+      }
+      index ++;
+      p.x ++;
+      if(p.x >= w)
+      {
+         p.x = 0;
+         p.y ++;
+      }
+      
+   }
+}
+
+// Returns 0 and leaves the level untouched if the file doesn't check out
+static int Level_LoadBinary(Level_T * level, const MappedFile_T * mapped)
+{
+   const LevelFormatHeader_T * header;
+   const uint8_t * data, * doors, * tiles;
+   TerrainMap_T tmap;
+   size_t header_size;
+   uint64_t needed, door_tiles;
+   uint32_t guard_count;
+
+   if(mapped->size < LEVELFORMAT_HEADER_V1_SIZE)
+   {
+      return 0;
+   }
+
+   // Version 1 files end the header before guard_count and have no guards
+   header = mapped->data;
+   if(header->version == 1)
+   {
+      header_size = LEVELFORMAT_HEADER_V1_SIZE;
+      guard_count = 0;
+   }
+   else if(header->version == LEVELFORMAT_VERSION && mapped->size >= sizeof(LevelFormatHeader_T))
+   {
+      header_size = sizeof(LevelFormatHeader_T);
+      guard_count = header->guard_count;
+   }
+   else
+   {
+      return 0;
+   }
+
+   if(header->width  <= 0 || header->width  > LEVELFORMAT_MAX_SIDE ||
+      header->height <= 0 || header->height > LEVELFORMAT_MAX_SIDE ||
+      header->start_x < 0 || header->start_x >= header->width ||
+      header->start_y < 0 || header->start_y >= header->height)
+   {
+      return 0;
+   }
+
+   // Counts come straight from the file, so add them up where they can't wrap
+   needed = (uint64_t)header_size + 
+            ((uint64_t)header->gold_count + header->door_count + guard_count) * sizeof(int32_t) * 2 + 
+            header->tile_bytes;
+   if((uint64_t)mapped->size < needed)
+   {
+      return 0;
+   }
+
+   // Check everything before any of the level is replaced
+   data  = (const uint8_t *)mapped->data + header_size;
+   doors = data + (size_t)header->gold_count * sizeof(int32_t) * 2;
+   tiles = (const uint8_t *)mapped->data + (size_t)needed - header->tile_bytes;
+   if(!Level_CheckPositions(data, (size_t)header->gold_count + header->door_count + guard_count, header) ||
+      !Level_CheckUnique(data,  header->gold_count, header->width) ||
+      !Level_CheckUnique(doors, header->door_count, header->width) ||
+      !Level_CheckTiles(header, tiles, &door_tiles) ||
+      door_tiles != header->door_count)
+   {
+      return 0;
+   }
+
+   // Doors can only be found on the decoded map, so it is kept aside until
+   // they check out
+   TerrainMap_Init(&tmap, header->width, header->height);
+   Level_LoadTiles(&tmap, header, tiles);
+   if(!Level_CheckDoors(&tmap, doors, header->door_count))
+   {
+      TerrainMap_Destroy(&tmap);
+      return 0;
+   }
+   TerrainMap_Destroy(&level->tmap);
+   level->tmap = tmap;
+
+   // Positions are pairs of int32 which is how Gold_T and Pos2D_T are laid out
+   ArrayList_Clear(&level->gold_list_init);
+   ArrayList_AddArray(&level->gold_list_init, (void *)data, header->gold_count);
+   data += header->gold_count * sizeof(int32_t) * 2;
+   ArrayList_Clear(&level->door_list);
+   ArrayList_AddArray(&level->door_list, (void *)data, header->door_count);
+   data += header->door_count * sizeof(int32_t) * 2;
+   ArrayList_Clear(&level->guard_list);
+   ArrayList_AddArray(&level->guard_list, (void *)data, guard_count);
+
+   level->start_spot.x = header->start_x;
+   level->start_spot.y = header->start_y;
+   return 1;
+}
+
+// Returns 0 if any of count pairs of int32 x, y is off the map
+static int Level_CheckPositions(const uint8_t * data, size_t count, const LevelFormatHeader_T * header)
+{
+   int32_t pair[2];
+   size_t i;
+   int result;
+
+   result = 1;
+   for(i = 0; i < count && result == 1; i++)
+   {
+      memcpy(pair, &data[i * sizeof(pair)], sizeof(pair));
+      if(pair[0] < 0 || pair[0] >= header->width || 
+         pair[1] < 0 || pair[1] >= header->height)
+      {
+         result = 0;
+      }
+   }
+   return result;
+}
+
+// Returns 0 if two of count pairs of int32 x, y are the same tile. The
+// pairs have to be on the map already.
+static int Level_CheckUnique(const uint8_t * data, size_t count, int width)
+{
+   int32_t pair[2];
+   int * index_list;
+   size_t i;
+   int result;
+
+   result = 1;
+   if(count > 1)
+   {
+      index_list = malloc(sizeof(int) * count);
+      for(i = 0; i < count; i++)
+      {
+         memcpy(pair, &data[i * sizeof(pair)], sizeof(pair));
+         index_list[i] = pair[0] + pair[1] * width;
+      }
+      qsort(index_list, count, sizeof(int), Level_CompareIndexDescending);
+      for(i = 1; i < count && result == 1; i++)
+      {
+         if(index_list[i] == index_list[i - 1])
+         {
+            result = 0;
+         }
+      }
+      free(index_list);
+   }
+   return result;
+}
+
+// Returns 1 if the tile data covers every tile of the map with known
+// tiles, and counts the doors among them
+static int Level_CheckTiles(const LevelFormatHeader_T * header, const uint8_t * tiles, uint64_t * door_tiles)
+{
+   uint64_t size, covered, run;
+   size_t i;
+   int result;
+
+   size    = (uint64_t)header->width * header->height;
+   result  = 1;
+   (*door_tiles) = 0;
+   if(!(header->flags & LEVELFORMAT_FLAG_RLE))
+   {
+      if(header->tile_bytes != size)
+      {
+         result = 0;
+      }
+      for(i = 0; i < header->tile_bytes && result == 1; i++)
+      {
+         if(tiles[i] > TMAP_TILE_DOOR)
+         {
+            result = 0;
+         }
+         else if(tiles[i] == TMAP_TILE_DOOR)
+         {
+            (*door_tiles) ++;
+         }
+      }
+   }
+   else
+   {
+      // Runs past the end of the map are never decoded
+      covered = 0;
+      for(i = 0; i + 1 < header->tile_bytes && covered < size && result == 1; i += 2)
+      {
+         run = tiles[i];
+         if(run > size - covered)
+         {
+            run = size - covered;
+         }
+         if(tiles[i + 1] > TMAP_TILE_DOOR)
+         {
+            result = 0;
+         }
+         else if(tiles[i + 1] == TMAP_TILE_DOOR)
+         {
+            (*door_tiles) += run;
+         }
+         covered += run;
+      }
+      if(covered < size)
+      {
+         result = 0;
+      }
+   }
+   return result;
+}
+
+// Returns 0 if any of count pairs of int32 x, y isn't a door tile
+static int Level_CheckDoors(TerrainMap_T * map, const uint8_t * data, size_t count)
+{
+   int32_t pair[2];
+   size_t i;
+   int result;
+
+   result = 1;
+   for(i = 0; i < count && result == 1; i++)
+   {
+      memcpy(pair, &data[i * sizeof(pair)], sizeof(pair));
+      if(TerrainMap_GetTile(map, pair[0], pair[1]) != TMAP_TILE_DOOR)
+      {
+         result = 0;
+      }
+   }
+   return result;
+}
+
+// The tile data has to have been through Level_CheckTiles
+static void Level_LoadTiles(TerrainMap_T * map, const LevelFormatHeader_T * header, const uint8_t * tiles)
+{
+   uint8_t * row;
+   size_t i, filled;
+   int y, run;
+
+   if(!(header->flags & LEVELFORMAT_FLAG_RLE))
+   {
+      // Rows go straight from the mapped file into the chunks
+      for(y = 0; y < header->height; y++)
+      {
+         TerrainMap_SetRow(map, y, &tiles[(size_t)y * header->width]);
+      }
+   }
+   else
+   {
+      // Runs may cross rows, so decode into a row buffer
+      row = malloc(header->width);
+      filled = 0;
+      y = 0;
+      for(i = 0; i + 1 < header->tile_bytes && y < header->height; i += 2)
+      {
+         run = tiles[i];
+         while(run > 0 && y < header->height)
+         {
+            row[filled] = tiles[i + 1];
+            filled ++;
+            run --;
+            if(filled == (size_t)header->width)
+            {
+               TerrainMap_SetRow(map, y, row);
+               filled = 0;
+               y ++;
+            }
+         }
+      }
+      free(row);
+   }
+}
+
+void Level_Restart(Level_T * level)
+{
+   size_t i, size;
+   Gold_T * gold;
+   gold = ArrayList_Get(&level->gold_list_init, &size, NULL);
+   ArrayList_Clear(&level->gold_list);
+   IntMap_Clear(&level->gold_map);
+   TerrainMap_ClearPlane(&level->tmap, TMAP_PLANE_GOLD);
+   for(i = 0; i < size; i++)
+   {
+      Level_AddGold(level, gold[i].pos.x, gold[i].pos.y);
+   }
+   ArrayList_Clear(&level->dig_list);
+   IntMap_Clear(&level->dig_map);
+   Level_DigWheel_Clear(level);
+   TerrainMap_ClearPlane(&level->tmap, TMAP_PLANE_HOLE);
+   ArrayList_Clear(&level->hole_changes);
+   Level_UpdateDoors(level);
+   level->generation = SDL_AtomicAdd(&Level_NextGeneration, 1) + 1;
+
+}
+
+static void Level_CopyList(ArrayList_T * dest, const ArrayList_T * src)
+{
+   void * data;
+   size_t size;
+   data = ArrayList_Get(src, &size, NULL);
+   ArrayList_Clear(dest);
+   ArrayList_AddArray(dest, data, size);
+}
+
+void Level_Copy(Level_T * dest, const Level_T * src)
+{
+   TerrainMap_Destroy(&dest->tmap);
+   TerrainMap_Copy(&dest->tmap, &src->tmap);
+   Level_CopyList(&dest->dig_list,       &src->dig_list);
+   Level_CopyList(&dest->gold_list,      &src->gold_list);
+   Level_CopyList(&dest->gold_list_init, &src->gold_list_init);
+   Level_CopyList(&dest->door_list,      &src->door_list);
+   Level_CopyList(&dest->guard_list,     &src->guard_list);
+   Level_CopyList(&dest->dig_closed,     &src->dig_closed);
+   Level_CopyList(&dest->hole_changes,   &src->hole_changes);
+   IntMap_Copy(&dest->gold_map, &src->gold_map);
+   IntMap_Copy(&dest->dig_map,  &src->dig_map);
+   memcpy(dest->dig_wheel, src->dig_wheel, sizeof(dest->dig_wheel));
+   dest->dig_tick     = src->dig_tick;
+   dest->dig_time     = src->dig_time;
+   dest->start_spot   = src->start_spot;
+   dest->gold_version = src->gold_version;
+   dest->doors_open   = src->doors_open;
+   // Not the same level as far as a render cache can tell
+   dest->generation = SDL_AtomicAdd(&Level_NextGeneration, 1) + 1;
+}
+
+void LevelSnapshot_Init(LevelSnapshot_T * snapshot)
+{
+   snapshot->level        = NULL;
+   snapshot->generation   = 0;
+   snapshot->gold_version = 0;
+   snapshot->doors_open   = 0;
+   snapshot->gold_count   = 0;
+   ArrayList_Init(&snapshot->gold_rows, sizeof(uint32_t),  0);
+   IntMap_Init(&snapshot->gold_chunks);
+   ArrayList_Init(&snapshot->dig_list,  sizeof(DigSpot_T), 0);
+   IntMap_Init(&snapshot->dig_map);
+}
+
+void LevelSnapshot_Destroy(LevelSnapshot_T * snapshot)
+{
+   ArrayList_Destroy(&snapshot->gold_rows);
+   IntMap_Destroy(&snapshot->gold_chunks);
+   ArrayList_Destroy(&snapshot->dig_list);
+   IntMap_Destroy(&snapshot->dig_map);
+}
+
+// Rebuilds the gold bits of just the chunks that have gold, so rendering
+// can walk them over the visible range the way the level's gold plane is
+static void LevelSnapshot_CopyGold(LevelSnapshot_T * snapshot, Level_T * level)
+{
+   static const uint32_t empty_rows[TMAP_CHUNK_SIZE];
+   TerrainMap_T * map;
+   Gold_T * gold;
+   uint32_t * rows;
+   int * first;
+   size_t i, size, index;
+   int chunk;
+
+   map = &level->tmap;
+   ArrayList_Clear(&snapshot->gold_rows);
+   IntMap_Clear(&snapshot->gold_chunks);
+   gold = ArrayList_Get(&level->gold_list, &size, NULL);
+   for(i = 0; i < size; i++)
+   {
+      if(gold[i].pos.x < 0 || gold[i].pos.x >= map->width ||
+         gold[i].pos.y < 0 || gold[i].pos.y >= map->height)
+      {
+         continue;
+      }
+
+      chunk = (gold[i].pos.x >> TMAP_CHUNK_SHIFT) + 
+              ((gold[i].pos.y >> TMAP_CHUNK_SHIFT) * map->chunk_width);
+      first = IntMap_Get(&snapshot->gold_chunks, chunk);
+      if(first == NULL)
+      {
+         index = snapshot->gold_rows.count;
+         ArrayList_AddArray(&snapshot->gold_rows, (void *)empty_rows, TMAP_CHUNK_SIZE);
+         IntMap_Set(&snapshot->gold_chunks, chunk, (int)index);
+      }
+      else
+      {
+         index = (size_t)(*first);
+      }
+      rows = ArrayList_GetIndex(&snapshot->gold_rows, index + (gold[i].pos.y & TMAP_CHUNK_MASK));
+      (*rows) |= (uint32_t)1 << (gold[i].pos.x & TMAP_CHUNK_MASK);
+   }
+   snapshot->gold_count = (int)size;
+}
+
+void Level_TakeSnapshot(Level_T * level, LevelSnapshot_T * snapshot)
+{
+   void * data;
+   size_t size;
+
+   // Gold only changes when it is picked up, dig spots change every frame
+   if(snapshot->level        != level || 
+      snapshot->generation   != level->generation ||
+      snapshot->gold_version != level->gold_version)
+   {
+      LevelSnapshot_CopyGold(snapshot, level);
+   }
+
+   data = ArrayList_Get(&level->dig_list, &size, NULL);
+   ArrayList_Clear(&snapshot->dig_list);
+   ArrayList_AddArray(&snapshot->dig_list, data, size);
+   IntMap_Copy(&snapshot->dig_map, &level->dig_map);
+
+   snapshot->level        = level;
+   snapshot->generation   = level->generation;
+   snapshot->gold_version = level->gold_version;
+   snapshot->doors_open   = level->doors_open;
+}
+
+static void  Level_Render_DigSpot(SDLTools_Batch_T * batch, SDL_Texture * t_terrain, DigSpot_T * dig_spot, int x, int y)
+{
+   int show;
+   int tile;
+   if(dig_spot->state == e_dss_opening)
+   {
+      switch(dig_spot->frame)
+      {
+         case 0:  show = 1; tile = IMGID_BROKENBLOCK_0; break;
+         case 1:  show = 1; tile = IMGID_BROKENBLOCK_1; break;
+         case 2:  show = 1; tile = IMGID_BROKENBLOCK_2; break;
+         default: show = 0; tile = 0xFFFF;              break;
+      }
+   }
+   else if(dig_spot->state == e_dss_open)
+   {
+      show = 0;
+      tile = 0xFFF;
+   }
+   else if(dig_spot->state == e_dss_closing)
+   {
+      switch(dig_spot->frame)
+      {
+         case 0:  show = 1; tile = IMGID_BROKENBLOCK_2; break;
+         case 1:  show = 1; tile = IMGID_BROKENBLOCK_1; break;
+         case 2:  show = 1; tile = IMGID_BROKENBLOCK_0; break;
+         default: show = 0; tile = 0xFFFF;              break;
+      }
+   }
+
+   if(show == 1)
+   {
+      SDLTools_Batch_Add(batch, t_terrain, tile, x, y);
+   }
+
+}
+
+static int  Level_Render_Tile(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, SDL_Texture * t_terrain, int x, int y, int draw_x, int draw_y)
+{
+   TerrainMap_T * map;
+   DigSpot_T * dig_spot;
+   int * dig_index;
+   int tile;
+
+   map = &snapshot->level->tmap;
+   tile = TerrainMap_GetTile(map, x, y);
+   switch(tile)
+   {
+      case TMAP_TILE_DIRT:
+         dig_index = IntMap_Get(&snapshot->dig_map, x + (y * map->width));
+         if(dig_index == NULL)
+         {
+            SDLTools_Batch_Add(batch, t_terrain, IMGID_BLOCK, draw_x, draw_y);
+         }
+         else
+         {
+            dig_spot = ArrayList_GetIndex(&snapshot->dig_list, *dig_index);
+            Level_Render_DigSpot(batch, t_terrain, dig_spot, draw_x, draw_y);
+         }
+         break;
+      case TMAP_TILE_LADDER:
+         SDLTools_Batch_Add(batch, t_terrain, IMGID_LADDER, draw_x, draw_y);
+         break;
+      case TMAP_TILE_BAR:
+         SDLTools_Batch_Add(batch, t_terrain, IMGID_BAR, draw_x, draw_y);
+         break;
+      case TMAP_TILE_DOOR:
+         if(snapshot->doors_open == 1)
+         {
+            SDLTools_Batch_Add(batch, t_terrain, IMGID_DOOROPEN, draw_x, draw_y);
+         }
+         else
+         {
+            SDLTools_Batch_Add(batch, t_terrain, IMGID_DOORCLOSE, draw_x, draw_y);
+         }
+         break;
+   }
+   return (tile != TMAP_TILE_AIR) ? 1 : 0;
+}
+
+static void Level_Render_Direct(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats)
+{
+   Pos2D_T p;
+   TerrainMap_T * map;
+
+   map = &snapshot->level->tmap;
+   for(p.y = start->y; p.y < end->y; p.y ++)
+   {
+      p.x = start->x;
+      while(p.x < end->x)
+      {
+         // Nothing to draw in an all-air chunk, skip to the next one
+         if(TerrainMap_GetChunk(map, p.x, p.y) == &TerrainMap_EmptyChunk)
+         {
+            p.x = (p.x | TMAP_CHUNK_MASK) + 1;
+            continue;
+         }
+
+         stats->tiles_drawn += Level_Render_Tile(snapshot, batch, t_terrain, p.x, p.y, 
+                                                 (p.x * TILE_WIDTH)  + offset_x, 
+                                                 (p.y * TILE_HEIGHT) + offset_y);
+         p.x ++;
+      }
+   }
+}
+
+static void Level_Render_Gold(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats)
+{
+   Pos2D_T p;
+   TerrainMap_T * map;
+   const uint32_t * rows;
+   int * first;
+   uint32_t gold_row;
+
+   map = &snapshot->level->tmap;
+   rows = snapshot->gold_rows.array;
+   for(p.y = start->y; p.y < end->y; p.y ++)
+   {
+      p.x = start->x;
+      while(p.x < end->x)
+      {
+         first = IntMap_Get(&snapshot->gold_chunks, (p.x >> TMAP_CHUNK_SHIFT) + 
+                                                    ((p.y >> TMAP_CHUNK_SHIFT) * map->chunk_width));
+         gold_row = 0;
+         if(first != NULL)
+         {
+            gold_row = rows[(*first) + (p.y & TMAP_CHUNK_MASK)] >> (p.x & TMAP_CHUNK_MASK);
+         }
+         if(gold_row == 0)
+         {
+            // No gold left in this chunk row
+            p.x = (p.x | TMAP_CHUNK_MASK) + 1;
+            continue;
+         }
+
+         if(gold_row & 1)
+         {
+            SDLTools_Batch_Add(batch, t_terrain, IMGID_GOLD, 
+                                  (p.x * TILE_WIDTH)  + offset_x, 
+                                  (p.y * TILE_HEIGHT) + offset_y);
+            stats->gold_drawn ++;
+         }
+         p.x ++;
+      }
+   }
+}
+
+// S LevelRenderCache
+
+void LevelRenderCache_Init(LevelRenderCache_T * cache, SDL_Renderer * rend)
+{
+   cache->rend       = rend;
+   cache->enabled    = (SDL_RenderTargetSupported(rend) == SDL_TRUE) ? 1 : 0;
+   cache->level      = NULL;
+   cache->generation = 0;
+   cache->frame      = 0;
+   ArrayList_Init(&cache->slot_list, sizeof(LevelRenderCacheSlot_T), 0);
+   IntMap_Init(&cache->block_map);
+   cache->doors_open = 0;
+   ArrayList_Init(&cache->dig_list, sizeof(DigSpot_T), 0);
+   IntMap_Init(&cache->dig_map);
+   if(cache->enabled == 0)
+   {
+      printf("Render targets not supported, terrain is drawn per tile\n");
+   }
+}
+
+void LevelRenderCache_Destroy(LevelRenderCache_T * cache)
+{
+   size_t i, size;
+   LevelRenderCacheSlot_T * slot;
+   slot = ArrayList_Get(&cache->slot_list, &size, NULL);
+   for(i = 0; i < size; i++)
+   {
+      SDL_DestroyTexture(slot[i].texture);
+   }
+   ArrayList_Destroy(&cache->slot_list);
+   IntMap_Destroy(&cache->block_map);
+   ArrayList_Destroy(&cache->dig_list);
+   IntMap_Destroy(&cache->dig_map);
+}
+
+static void LevelRenderCache_Invalidate(LevelRenderCache_T * cache)
+{
+   size_t i, size;
+   LevelRenderCacheSlot_T * slot;
+   slot = ArrayList_Get(&cache->slot_list, &size, NULL);
+   for(i = 0; i < size; i++)
+   {
+      slot[i].block     = -1;
+      slot[i].last_used = -1;
+   }
+   IntMap_Clear(&cache->block_map);
 }
 
-void Level_Load(Level_T * level, const char * filename)
+// Finds the slot holding block, or reuses the least recently drawn slot.
+// is_new is set when the slot contents have to be drawn.
+static LevelRenderCacheSlot_T * LevelRenderCache_GetSlot(LevelRenderCache_T * cache, int block, int * is_new)
 {
-   FILE * fp;
-   int input, index;
-   int w, h;
-   TerrainMap_T * map;
-   Pos2D_T p;
-   Gold_T * gold;
-   size_t size;
-
-   map = &level->tmap;
-   fp = fopen(filename, "r");
+   size_t i, size, slot_index;
+   int * index;
+   LevelRenderCacheSlot_T * slot, * result;
 
-   if(fp == NULL)
+   index = IntMap_Get(&cache->block_map, block);
+   if(index != NULL)
    {
-      printf("Error: Could not open \"%s\"\n", filename);
+      result = ArrayList_GetIndex(&cache->slot_list, *index);
+      (*is_new) = 0;
    }
    else
    {
-      fscanf(fp, "%i", &w);
-      fscanf(fp, "%i", &h);
-      TerrainMap_Destroy(map);
-
-      TerrainMap_Init(map, w, h);
-      size = w * h;
-      index = 0;
-      p.x = p.y = 0;
-      while(!feof(fp) && index < size)
+      result = NULL;
+      slot = ArrayList_Get(&cache->slot_list, &size, NULL);
+      for(i = 0; i < size; i++)
       {
-         fscanf(fp, "%i", &input);
-         switch(input)
+         if(slot[i].last_used != cache->frame && 
+            (result == NULL || slot[i].last_used < result->last_used))
          {
-            case 0:  map->data[index] = TMAP_TILE_AIR;    break;
-            case 1:  map->data[index] = TMAP_TILE_DIRT;   break;
-            case 2:  
-               level->start_spot.x = p.x;
-               level->start_spot.y = p.y;
-               break;
-            case 3:  map->data[index] = TMAP_TILE_LADDER; break;
-            case 4:  map->data[index] = TMAP_TILE_BAR;    break;
-            case 5:
-               map->data[index] = TMAP_TILE_AIR;
-               gold = ArrayList_Add(&level->gold_list_init, NULL);
-               gold->pos.x = p.x;
-               gold->pos.y = p.y;
-               break;
-            case 6: map->data[index] = TMAP_TILE_DOOR;    break;
-            default: map->data[index] = TMAP_TILE_AIR;    break;
+            result = &slot[i];
+            slot_index = i;
          }
-         index ++;
-         p.x ++;
-         if(p.x >= w)
+      }
+
+      if(result == NULL)
+      {
+         result = ArrayList_Add(&cache->slot_list, &slot_index);
+         result->texture = SDL_CreateTexture(cache->rend, 
+                                             SDL_PIXELFORMAT_RGBA8888, 
+                                             SDL_TEXTUREACCESS_TARGET, 
+                                             TMAP_BLOCK_SIZE * TILE_WIDTH, 
+                                             TMAP_BLOCK_SIZE * TILE_HEIGHT);
+         if(result->texture == NULL)
          {
-            p.x = 0;
-            p.y ++;
+            printf("Error: Could not create terrain cache texture: %s\n", SDL_GetError());
+            ArrayList_RemoveSwap(&cache->slot_list, slot_index);
+            cache->enabled = 0;
+            return NULL;
          }
-         
+         SDL_SetTextureBlendMode(result->texture, SDL_BLENDMODE_BLEND);
+      }
+      else if(result->block >= 0)
+      {
+         IntMap_Remove(&cache->block_map, result->block);
       }
 
-      fclose(fp);
-      Level_Restart(level);
+      result->block = block;
+      IntMap_Set(&cache->block_map, block, (int)slot_index);
+      (*is_new) = 1;
    }
+
+   result->last_used = cache->frame;
+   return result;
 }
 
-void Level_Restart(Level_T * level)
+// Flags the cached block holding the tile, if there is one, to be redrawn
+static void LevelRenderCache_MarkTile(LevelRenderCache_T * cache, int blocks_wide, int x, int y)
 {
-   size_t size;
-   Gold_T * gold;
-   gold = ArrayList_Get(&level->gold_list_init, &size, NULL);
-   ArrayList_Clear(&level->gold_list);
-   ArrayList_AddArray(&level->gold_list, gold, size);
-   ArrayList_Clear(&level->dig_list);
+   int * index;
+   LevelRenderCacheSlot_T * slot;
 
+   index = IntMap_Get(&cache->block_map, (x >> TMAP_BLOCK_SHIFT) + ((y >> TMAP_BLOCK_SHIFT) * blocks_wide));
+   if(index != NULL)
+   {
+      slot = ArrayList_GetIndex(&cache->slot_list, *index);
+      slot->dirty = 1;
+   }
 }
 
-static void  Level_Render_DigSpot(SDL_Renderer * rend, SDL_Texture * t_terrain, DigSpot_T * dig_spot, int x, int y)
+// Compares snapshot against what the cache last drew and flags the blocks
+// of every dig spot and door that looks different
+static void LevelRenderCache_MarkChanges(LevelRenderCache_T * cache, const LevelSnapshot_T * snapshot)
 {
-   int show;
-   int tile;
-   if(dig_spot->state == e_dss_opening)
+   size_t i, size;
+   DigSpot_T * dig_spot, * old_spot;
+   Pos2D_T * door;
+   int * index;
+   int width, blocks_wide;
+
+   width       = snapshot->level->tmap.width;
+   blocks_wide = snapshot->level->tmap.chunk_width * TMAP_BLOCKS_PER_CHUNK_ROW;
+
+   dig_spot = ArrayList_Get(&snapshot->dig_list, &size, NULL);
+   for(i = 0; i < size; i++)
    {
-      switch(dig_spot->frame)
+      index = IntMap_Get(&cache->dig_map, dig_spot[i].pos.x + (dig_spot[i].pos.y * width));
+      old_spot = (index == NULL) ? NULL : ArrayList_GetIndex(&cache->dig_list, *index);
+      if(old_spot == NULL || 
+         old_spot->state != dig_spot[i].state || 
+         old_spot->frame != dig_spot[i].frame)
       {
-         case 0:  show = 1; tile = IMGID_BROKENBLOCK_0; break;
-         case 1:  show = 1; tile = IMGID_BROKENBLOCK_1; break;
-         case 2:  show = 1; tile = IMGID_BROKENBLOCK_2; break;
-         default: show = 0; tile = 0xFFFF;              break;
+         LevelRenderCache_MarkTile(cache, blocks_wide, dig_spot[i].pos.x, dig_spot[i].pos.y);
       }
    }
-   else if(dig_spot->state == e_dss_open)
-   {
-      show = 0;
-      tile = 0xFFF;
-   }
-   else if(dig_spot->state == e_dss_closing)
+
+   // Spots that closed since
+   dig_spot = ArrayList_Get(&cache->dig_list, &size, NULL);
+   for(i = 0; i < size; i++)
    {
-      switch(dig_spot->frame)
+      if(IntMap_Get(&snapshot->dig_map, dig_spot[i].pos.x + (dig_spot[i].pos.y * width)) == NULL)
       {
-         case 0:  show = 1; tile = IMGID_BROKENBLOCK_2; break;
-         case 1:  show = 1; tile = IMGID_BROKENBLOCK_1; break;
-         case 2:  show = 1; tile = IMGID_BROKENBLOCK_0; break;
-         default: show = 0; tile = 0xFFFF;              break;
+         LevelRenderCache_MarkTile(cache, blocks_wide, dig_spot[i].pos.x, dig_spot[i].pos.y);
       }
    }
 
-   if(show == 1)
+   if(cache->doors_open != snapshot->doors_open)
    {
-      SDLTools_DrawSubimage(rend, t_terrain, tile, x, y);
+      door = ArrayList_Get(&snapshot->level->door_list, &size, NULL);
+      for(i = 0; i < size; i++)
+      {
+         LevelRenderCache_MarkTile(cache, blocks_wide, door[i].x, door[i].y);
+      }
    }
-
 }
 
-void Level_Render(Level_T * level, SDL_Renderer * rend, int offset_x, int offset_y, SDL_Texture * t_terrain)
+static void LevelRenderCache_Remember(LevelRenderCache_T * cache, const LevelSnapshot_T * snapshot)
 {
-   DigSpot_T * dig_spot;
-   int index;
-   Pos2D_T p, c;
-   TerrainMap_T * map;
-   Gold_T * gold;
-   size_t i, size;
-   int gold_count;
-
+   void * data;
+   size_t size;
 
-   gold_count = Level_GetGoldCount(level, NULL);
+   cache->doors_open = snapshot->doors_open;
+   data = ArrayList_Get(&snapshot->dig_list, &size, NULL);
+   ArrayList_Clear(&cache->dig_list);
+   ArrayList_AddArray(&cache->dig_list, data, size);
+   IntMap_Copy(&cache->dig_map, &snapshot->dig_map);
+}
 
-   map = &level->tmap;
-   p.x = 0;
-   p.y = 0;
-   index = 0;
-   c.x = offset_x;
-   c.y = offset_y; 
-   while(p.y < map->height)
+// Returns 0 if the cache could not be used and nothing was drawn
+static int  Level_Render_Cached(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, LevelRenderCache_T * cache, Pos2D_T * start, Pos2D_T * end, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats)
+{
+   Level_T * level;
+   TerrainMap_T * map;
+   TerrainChunk_T * chunk;
+   LevelRenderCacheSlot_T * slot;
+   Pos2D_T b, b_start, b_end, t, t_end;
+   SDL_Rect viewport, dest;
+   SDL_BlendMode blend;
+   Uint8 red, green, blue, alpha;
+   int blocks_wide, is_new, targeting, result;
+   SDL_Renderer * rend;
+
+   level = snapshot->level;
+   map  = &level->tmap;
+   rend = batch->rend;
+   if(cache->level != level || cache->generation != snapshot->generation)
+   {
+      LevelRenderCache_Invalidate(cache);
+      cache->level      = level;
+      cache->generation = snapshot->generation;
+   }
+   else
+   {
+      LevelRenderCache_MarkChanges(cache, snapshot);
+   }
+   LevelRenderCache_Remember(cache, snapshot);
+   cache->frame ++;
+
+   blocks_wide = map->chunk_width * TMAP_BLOCKS_PER_CHUNK_ROW;
+   b_start.x   = start->x >> TMAP_BLOCK_SHIFT;
+   b_start.y   = start->y >> TMAP_BLOCK_SHIFT;
+   b_end.x     = ((end->x - 1) >> TMAP_BLOCK_SHIFT) + 1;
+   b_end.y     = ((end->y - 1) >> TMAP_BLOCK_SHIFT) + 1;
+
+   // Redraw the visible blocks that are missing or dirty
+   targeting = 0;
+   result = 1;
+   for(b.y = b_start.y; b.y < b_end.y && result == 1; b.y ++)
    {
-      switch(map->data[index])
+      for(b.x = b_start.x; b.x < b_end.x; b.x ++)
       {
-         case TMAP_TILE_DIRT:
-            dig_spot = Level_GetDigSpot(level, p.x, p.y);
-            if(dig_spot == NULL)
-            {
-               SDLTools_DrawSubimage(rend, t_terrain, IMGID_BLOCK, c.x, c.y);
-            }
-            else
+         chunk = TerrainMap_GetChunk(map, b.x << TMAP_BLOCK_SHIFT, b.y << TMAP_BLOCK_SHIFT);
+         if(chunk == &TerrainMap_EmptyChunk)
+         {
+            continue;
+         }
+
+         slot = LevelRenderCache_GetSlot(cache, b.x + (b.y * blocks_wide), &is_new);
+         if(slot == NULL)
+         {
+            result = 0;
+            break;
+         }
+
+         if(is_new == 1 || slot->dirty == 1)
+         {
+            if(targeting == 0)
             {
-               Level_Render_DigSpot(rend, t_terrain, dig_spot, c.x, c.y);
+               targeting = 1;
+               // Anything queued so far belongs on the screen, not in a block
+               SDLTools_Batch_Flush(batch);
+               SDL_RenderGetViewport(rend, &viewport);
+               SDL_GetRenderDrawColor(rend, &red, &green, &blue, &alpha);
+               SDL_GetTextureBlendMode(t_terrain, &blend);
+               // Copy tiles as they are so the block keeps their alpha
+               SDL_SetTextureBlendMode(t_terrain, SDL_BLENDMODE_NONE);
+               SDL_SetRenderDrawColor(rend, 0, 0, 0, 0);
             }
-            break;
-         case TMAP_TILE_LADDER:
-            SDLTools_DrawSubimage(rend, t_terrain, IMGID_LADDER, c.x, c.y);
-            break;
-         case TMAP_TILE_BAR:
-            SDLTools_DrawSubimage(rend, t_terrain, IMGID_BAR, c.x, c.y);
-            break;
-         case TMAP_TILE_DOOR:
-            if(gold_count == 0)
+
+            SDL_SetRenderTarget(rend, slot->texture);
+            SDL_RenderClear(rend);
+            t_end.x = (b.x + 1) << TMAP_BLOCK_SHIFT;
+            t_end.y = (b.y + 1) << TMAP_BLOCK_SHIFT;
+            if(t_end.x > map->width)  t_end.x = map->width;
+            if(t_end.y > map->height) t_end.y = map->height;
+            for(t.y = b.y << TMAP_BLOCK_SHIFT; t.y < t_end.y; t.y ++)
             {
-               SDLTools_DrawSubimage(rend, t_terrain, IMGID_DOOROPEN, c.x, c.y);
+               for(t.x = b.x << TMAP_BLOCK_SHIFT; t.x < t_end.x; t.x ++)
+               {
+                  stats->tiles_drawn += Level_Render_Tile(snapshot, batch, t_terrain, t.x, t.y, 
+                                                          (t.x & TMAP_BLOCK_MASK) * TILE_WIDTH, 
+                                                          (t.y & TMAP_BLOCK_MASK) * TILE_HEIGHT);
+               }
             }
-            else
+            SDLTools_Batch_Flush(batch);
+            slot->dirty = 0;
+            stats->blocks_refreshed ++;
+         }
+      }
+   }
+
+   if(targeting == 1)
+   {
+      SDL_SetRenderTarget(rend, NULL);
+      SDL_RenderSetViewport(rend, &viewport);
+      SDL_SetRenderDrawColor(rend, red, green, blue, alpha);
+      SDL_SetTextureBlendMode(t_terrain, blend);
+   }
+
+   if(result == 1)
+   {
+      SDLTools_Batch_Flush(batch);
+      dest.w = TMAP_BLOCK_SIZE * TILE_WIDTH;
+      dest.h = TMAP_BLOCK_SIZE * TILE_HEIGHT;
+      for(b.y = b_start.y; b.y < b_end.y; b.y ++)
+      {
+         for(b.x = b_start.x; b.x < b_end.x; b.x ++)
+         {
+            if(TerrainMap_GetChunk(map, b.x << TMAP_BLOCK_SHIFT, b.y << TMAP_BLOCK_SHIFT) != &TerrainMap_EmptyChunk)
             {
-               SDLTools_DrawSubimage(rend, t_terrain, IMGID_DOORCLOSE, c.x, c.y);
+               slot = ArrayList_GetIndex(&cache->slot_list, *IntMap_Get(&cache->block_map, b.x + (b.y * blocks_wide)));
+               dest.x = (b.x * TMAP_BLOCK_SIZE * TILE_WIDTH)  + offset_x;
+               dest.y = (b.y * TMAP_BLOCK_SIZE * TILE_HEIGHT) + offset_y;
+               SDL_RenderCopy(rend, slot->texture, NULL, &dest);
+               stats->blocks_drawn ++;
+               batch->draw_calls ++;
             }
-            break;
+         }
       }
+   }
+   return result;
+}
 
-      index ++;
-      p.x ++;
-      c.x += TILE_WIDTH;
-      if(p.x >= map->width)
+// E LevelRenderCache
+
+void Level_Render(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, LevelRenderCache_T * cache, const SDL_Rect * view, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats)
+{
+   Pos2D_T start, end;
+   TerrainMap_T * map;
+   int drawn;
+
+
+   map = &snapshot->level->tmap;
+   stats->tiles_drawn      = 0;
+   stats->gold_drawn       = 0;
+   stats->blocks_drawn     = 0;
+   stats->blocks_refreshed = 0;
+
+   // Tile range that intersects the view, rounded outward
+   start.x = Level_DivFloor(view->x - offset_x,                TILE_WIDTH);
+   start.y = Level_DivFloor(view->y - offset_y,                TILE_HEIGHT);
+   end.x   = Level_DivFloor(view->x + view->w - offset_x - 1,  TILE_WIDTH)  + 1;
+   end.y   = Level_DivFloor(view->y + view->h - offset_y - 1,  TILE_HEIGHT) + 1;
+   if(start.x < 0)           start.x = 0;
+   if(start.y < 0)           start.y = 0;
+   if(end.x   > map->width)  end.x   = map->width;
+   if(end.y   > map->height) end.y   = map->height;
+
+   if(end.x > start.x && end.y > start.y)
+   {
+      drawn = 0;
+      if(cache != NULL && cache->enabled == 1)
       {
-         p.x = 0;
-         c.x = offset_x;
-         p.y ++;
-         c.y += TILE_HEIGHT;
+         drawn = Level_Render_Cached(snapshot, batch, cache, &start, &end, offset_x, offset_y, t_terrain, stats);
       }
+
+      if(drawn == 0)
+      {
+         Level_Render_Direct(snapshot, batch, &start, &end, offset_x, offset_y, t_terrain, stats);
+      }
+
+      Level_Render_Gold(snapshot, batch, &start, &end, offset_x, offset_y, t_terrain, stats);
+      stats->tiles_culled = (map->width * map->height) - ((end.x - start.x) * (end.y - start.y));
    }
-   
-   gold = ArrayList_Get(&level->gold_list, &size, NULL);
-   for(i = 0; i < size; i++)
+   else
    {
-      c.x = (gold[i].pos.x * TILE_WIDTH)  + offset_x;
-      c.y = (gold[i].pos.y * TILE_HEIGHT) + offset_y;
-      SDLTools_DrawSubimage(rend, t_terrain, IMGID_GOLD, c.x, c.y);
+      stats->tiles_culled = map->width * map->height;
    }
-   
+   stats->gold_culled = snapshot->gold_count - stats->gold_drawn;
 }
 
+// Spots sit in the wheel slot of their deadline tick, so an update only
+// visits the slots for the ticks that passed since the last one.
 void Level_Update(Level_T * level, float seconds)
 {
-   // Update Dig Spots
    size_t size, i;
+   int tick, end_tick, slot, count;
+   int index, next;
+   int * closed;
    DigSpot_T * dig_spot;
 
+   level->dig_time += seconds;
+   end_tick = Level_DigWheel_GetTick(level->dig_time);
    dig_spot = ArrayList_Get(&level->dig_list, &size, NULL);
 
-   // Update Dig Spots
-   for(i = 0; i < size; i++)
+   // The current tick is visited again next update since it is only
+   // partly over. Past LEVEL_DIG_WHEEL_SIZE ticks every slot is covered.
+   count = 0;
+   for(tick = level->dig_tick; tick <= end_tick && count < LEVEL_DIG_WHEEL_SIZE; tick++)
    {
-      dig_spot[i].timer += seconds;
-      if(dig_spot[i].state == e_dss_opening)
+      slot  = tick & (LEVEL_DIG_WHEEL_SIZE - 1);
+      index = level->dig_wheel[slot];
+      level->dig_wheel[slot] = -1;
+      while(index != -1)
       {
-         if(dig_spot[i].timer >= DIG_SPOT_DELATA_FRAME_TIMEOUT)
+         next = dig_spot[index].wheel_next;
+         if(dig_spot[index].deadline <= level->dig_time)
          {
-            dig_spot[i].frame ++;
-            dig_spot[i].timer -= DIG_SPOT_DELATA_FRAME_TIMEOUT;
+            while(dig_spot[index].state != e_dss_close && 
+                  dig_spot[index].deadline <= level->dig_time)
+            {
+               Level_DigSpot_Advance(&dig_spot[index]);
+            }
          }
 
-         if(dig_spot[i].frame >= DIG_SPOT_FRAME_COUNT)
+         if(dig_spot[index].state == e_dss_close)
          {
-            dig_spot[i].state = e_dss_open;
+            closed = ArrayList_Add(&level->dig_closed, NULL);
+            (*closed) = index;
          }
-      }
-      else if(dig_spot[i].state == e_dss_open)
-      {
-         if(dig_spot[i].timer >= HOLE_TIMEOUT)
+         else
          {
-            dig_spot[i].frame = 0;
-            dig_spot[i].timer -= HOLE_TIMEOUT;
-            dig_spot[i].state = e_dss_closing;
+            // Anything still pending is due no earlier than the current tick
+            Level_DigWheel_Link(level, &dig_spot[index], index);
          }
+         index = next;
       }
-      else if(dig_spot[i].state == e_dss_closing)
-      {
-         if(dig_spot[i].timer >= DIG_SPOT_DELATA_FRAME_TIMEOUT)
-         {
-            dig_spot[i].frame ++;
-            dig_spot[i].timer -= DIG_SPOT_DELATA_FRAME_TIMEOUT;
-         }
+      count ++;
+   }
+   level->dig_tick = end_tick;
 
-         if(dig_spot[i].frame >= DIG_SPOT_FRAME_COUNT)
-         {
-            dig_spot[i].state = e_dss_close;
-         }
-      }
+   // Remove from the back so a swapped in spot is never one still pending
+   closed = ArrayList_Get(&level->dig_closed, &size, NULL);
+   if(size > 1)
+   {
+      qsort(closed, size, sizeof(int), Level_CompareIndexDescending);
+   }
+   for(i = 0; i < size; i++)
+   {
+      Level_RemoveDigSpot(level, closed[i]);
+   }
+   ArrayList_Clear(&level->dig_closed);
+}
+
+static int Level_DigWheel_GetTick(double time)
+{
+   return (int)(time / DIG_SPOT_DELATA_FRAME_TIMEOUT);
+}
 
+static void Level_DigWheel_Link(Level_T * level, DigSpot_T * dig_spot, int index)
+{
+   DigSpot_T * head;
+   int slot;
+   slot = Level_DigWheel_GetTick(dig_spot->deadline) & (LEVEL_DIG_WHEEL_SIZE - 1);
+   dig_spot->wheel_slot = slot;
+   dig_spot->wheel_prev = -1;
+   dig_spot->wheel_next = level->dig_wheel[slot];
+   if(dig_spot->wheel_next != -1)
+   {
+      head = ArrayList_GetIndex(&level->dig_list, dig_spot->wheel_next);
+      head->wheel_prev = index;
+   }
+   level->dig_wheel[slot] = index;
+}
+
+static void Level_DigWheel_Clear(Level_T * level)
+{
+   int i;
+   for(i = 0; i < LEVEL_DIG_WHEEL_SIZE; i++)
+   {
+      level->dig_wheel[i] = -1;
+   }
+   level->dig_tick = 0;
+   level->dig_time = 0;
+}
+
+// Takes the one step that is due at dig_spot->deadline
+static void Level_DigSpot_Advance(DigSpot_T * dig_spot)
+{
+   if(dig_spot->state == e_dss_opening)
+   {
+      dig_spot->frame ++;
+      if(dig_spot->frame >= DIG_SPOT_FRAME_COUNT)
+      {
+         dig_spot->state = e_dss_open;
+         dig_spot->deadline += HOLE_TIMEOUT;
+      }
+      else
+      {
+         dig_spot->deadline += DIG_SPOT_DELATA_FRAME_TIMEOUT;
+      }
+   }
+   else if(dig_spot->state == e_dss_open)
+   {
+      dig_spot->frame = 0;
+      dig_spot->state = e_dss_closing;
+      dig_spot->deadline += DIG_SPOT_DELATA_FRAME_TIMEOUT;
+   }
+   else if(dig_spot->state == e_dss_closing)
+   {
+      dig_spot->frame ++;
+      if(dig_spot->frame >= DIG_SPOT_FRAME_COUNT)
+      {
+         dig_spot->state = e_dss_close;
+      }
+      else
+      {
+         dig_spot->deadline += DIG_SPOT_DELATA_FRAME_TIMEOUT;
+      }
    }
+}
 
-   // Remove spots
+// The spot must already be out of the wheel
+static void Level_RemoveDigSpot(Level_T * level, int index)
+{
+   size_t size;
+   int tile_index, last;
+   DigSpot_T * dig_spot;
+   Pos2D_T * changed;
 
-   // Iterate backward so that the removes don't effect the index
-   for(i = size - 1; i < size; i--)
+   dig_spot = ArrayList_Get(&level->dig_list, &size, NULL);
+   last = (int)size - 1;
+   tile_index = dig_spot[index].pos.x + (dig_spot[index].pos.y * level->tmap.width);
+   TerrainMap_ClearBit(&level->tmap, TMAP_PLANE_HOLE, dig_spot[index].pos.x, dig_spot[index].pos.y);
+   IntMap_Remove(&level->dig_map, tile_index);
+   changed = ArrayList_Add(&level->hole_changes, NULL);
+   (*changed) = dig_spot[index].pos;
+
+   if(index != last)
    {
-      if(dig_spot[i].state == e_dss_close)
+      // The last spot moves into index, so repoint everything that refers to it
+      if(dig_spot[last].wheel_prev == -1)
+      {
+         level->dig_wheel[dig_spot[last].wheel_slot] = index;
+      }
+      else
+      {
+         dig_spot[dig_spot[last].wheel_prev].wheel_next = index;
+      }
+
+      if(dig_spot[last].wheel_next != -1)
       {
-         ArrayList_Remove(&level->dig_list, i);
+         dig_spot[dig_spot[last].wheel_next].wheel_prev = index;
       }
+      tile_index = dig_spot[last].pos.x + (dig_spot[last].pos.y * level->tmap.width);
+      IntMap_Set(&level->dig_map, tile_index, index);
    }
+   ArrayList_RemoveSwap(&level->dig_list, (size_t)index);
+}
 
+static int Level_CompareIndexDescending(const void * a, const void * b)
+{
+   return (*(const int *)b) - (*(const int *)a);
 }
 
 void Level_AddDigSpot(Level_T * level, int x, int y)
 {
    DigSpot_T * dig_spot;
-   dig_spot = ArrayList_Add(&level->dig_list, NULL);
-   dig_spot->pos.x = x;
-   dig_spot->pos.y = y;
-   dig_spot->timer = 0;
-   dig_spot->state = e_dss_opening;
-   dig_spot->frame = 0;
+   Pos2D_T * changed;
+   size_t index;
+   int tile_index;
+
+   if(x >= 0 && x < level->tmap.width && y >= 0 && y < level->tmap.height)
+   {
+      tile_index = x + (y * level->tmap.width);
+      // Digging an existing hole leaves it as it is
+      if(TerrainMap_TestBit(&level->tmap, TMAP_PLANE_HOLE, x, y) == 0)
+      {
+         dig_spot = ArrayList_Add(&level->dig_list, &index);
+         dig_spot->pos.x = x;
+         dig_spot->pos.y = y;
+         dig_spot->deadline = level->dig_time + DIG_SPOT_DELATA_FRAME_TIMEOUT;
+         dig_spot->state = e_dss_opening;
+         dig_spot->frame = 0;
+         Level_DigWheel_Link(level, dig_spot, (int)index);
+         TerrainMap_SetBit(&level->tmap, TMAP_PLANE_HOLE, x, y);
+         IntMap_Set(&level->dig_map, tile_index, (int)index);
+         changed = ArrayList_Add(&level->hole_changes, NULL);
+         changed->x = x;
+         changed->y = y;
+      }
+   }
 }
 
 void Level_AddGold(Level_T * level, int x, int y)
 {
    Gold_T * gold;
-   gold = ArrayList_Add(&level->gold_list, NULL);
+   size_t index;
+   int tile_index;
+   gold = ArrayList_Add(&level->gold_list, &index);
    gold->pos.x = x;
    gold->pos.y = y;
+   if(x >= 0 && x < level->tmap.width && y >= 0 && y < level->tmap.height)
+   {
+      tile_index = x + (y * level->tmap.width);
+      TerrainMap_SetBit(&level->tmap, TMAP_PLANE_GOLD, x, y);
+      IntMap_Set(&level->gold_map, tile_index, (int)index);
+   }
+   level->gold_version ++;
+
+   if(index == 0)
+   {
+      Level_UpdateDoors(level);
+   }
 }
 
 void Level_RemoveGold(Level_T * level, size_t gold_index)
 {
-   ArrayList_Remove(&level->gold_list, gold_index);
+   size_t size;
+   Gold_T * gold;
+   Pos2D_T p;
+   int tile_index;
+   gold = ArrayList_Get(&level->gold_list, &size, NULL);
+   if(gold_index < size)
+   {
+      p = gold[gold_index].pos;
+      if(p.x >= 0 && p.x < level->tmap.width && p.y >= 0 && p.y < level->tmap.height)
+      {
+         tile_index = p.x + (p.y * level->tmap.width);
+         TerrainMap_ClearBit(&level->tmap, TMAP_PLANE_GOLD, p.x, p.y);
+         IntMap_Remove(&level->gold_map, tile_index);
+      }
+
+      // The last gold fills the hole, so its map entry has to follow it
+      ArrayList_RemoveSwap(&level->gold_list, gold_index);
+      level->gold_version ++;
+      if(gold_index < size - 1)
+      {
+         p = gold[gold_index].pos;
+         if(p.x >= 0 && p.x < level->tmap.width && p.y >= 0 && p.y < level->tmap.height)
+         {
+            IntMap_Set(&level->gold_map, p.x + (p.y * level->tmap.width), (int)gold_index);
+         }
+      }
+
+      if(size == 1)
+      {
+         Level_UpdateDoors(level);
+      }
+   }
 }
 
 Gold_T * Level_GetGold(Level_T * level, int x, int y, size_t * out_index)
 {
-   size_t i, size;
-   Gold_T * gold, * result;
+   int tile_index;
+   Gold_T * result;
    result = NULL;
-   gold = ArrayList_Get(&level->gold_list, &size, NULL);
-   for(i = 0; i < size; i++)
+   if(x >= 0 && x < level->tmap.width && y >= 0 && y < level->tmap.height)
    {
-      if(x == gold[i].pos.x && y == gold[i].pos.y)
+      tile_index = x + (y * level->tmap.width);
+      if(TerrainMap_TestBit(&level->tmap, TMAP_PLANE_GOLD, x, y) == 1)
       {
-
-         result = &gold[i];
-         if(out_index != NULL)
-         {
-            (*out_index) = i;
-         }
-         break;
+         result = Level_GetGoldAt(level, tile_index, out_index);
       }
    }
    return result;
@@ -403,17 +1592,18 @@ Gold_T * Level_GetGold(Level_T * level, int x, int y, size_t * out_index)
 
 DigSpot_T * Level_GetDigSpot(Level_T * level, int x, int y)
 {
-   size_t i, size;
-   DigSpot_T * dig_spot, * result;
+   int tile_index;
+   int * index;
+   DigSpot_T * result;
 
    result = NULL;
-   dig_spot = ArrayList_Get(&level->dig_list, &size, NULL);
-   for(i = 0; i < size; i ++)
+   if(x >= 0 && x < level->tmap.width && y >= 0 && y < level->tmap.height)
    {
-      if(x == dig_spot[i].pos.x && y == dig_spot[i].pos.y)
+      tile_index = x + (y * level->tmap.width);
+      if(TerrainMap_TestBit(&level->tmap, TMAP_PLANE_HOLE, x, y) == 1)
       {
-         result = &dig_spot[i];
-         break;
+         index = IntMap_Get(&level->dig_map, tile_index);
+         result = ArrayList_GetIndex(&level->dig_list, *index);
       }
    }
 
@@ -422,38 +1612,27 @@ DigSpot_T * Level_GetDigSpot(Level_T * level, int x, int y)
 
 void Level_QueryTile(Level_T * level, int x, int y, LevelTile_T * tile)
 {
-   DigSpot_T * dig_spot;
-   Gold_T * gold;
+   TerrainMap_T * map;
    size_t index;
+   map = &level->tmap;
    tile->pos.x = x;
    tile->pos.y = y;
-   if(x >= 0 && x < level->tmap.width && y >= 0 && y < level->tmap.height)
+   if(x >= 0 && x < map->width && y >= 0 && y < map->height)
    {
-      tile->index = x + (y * level->tmap.width);
+      tile->index = x + (y * map->width);
       tile->out_of_range = 0;
-      tile->terrain_type = level->tmap.data[tile->index];
-      tile->has_hole = 0;
-
-      // Check for hole
-      dig_spot = Level_GetDigSpot(level, x, y);
-      if(dig_spot == NULL)
-      {
-         tile->has_hole = 0;
-      }
-      else
-      {
-         tile->has_hole = 1;
-      }
+      tile->terrain_type = TerrainMap_GetTile(map, x, y);
+      tile->has_hole     = TerrainMap_TestBit(map, TMAP_PLANE_HOLE, x, y);
 
       // Check for gold
-      gold = Level_GetGold(level, x, y, &index);
-      if(gold == NULL)
+      if(TerrainMap_TestBit(map, TMAP_PLANE_GOLD, x, y) == 1)
       {
-         tile->gold_index = -1;
+         (void)Level_GetGoldAt(level, tile->index, &index);
+         tile->gold_index = (int)index;
       }
       else
       {
-         tile->gold_index = (int)index;
+         tile->gold_index = -1;
       }
    }
    else
@@ -489,6 +1668,42 @@ void Level_GetStartSpot(Level_T * level, int * x, int * y)
    }
 }
 
+Pos2D_T * Level_GetGuardSpots(Level_T * level, size_t * count)
+{
+   return ArrayList_Get(&level->guard_list, count, NULL);
+}
+
+Pos2D_T * Level_GetHoleChanges(Level_T * level, size_t * count)
+{
+   return ArrayList_Get(&level->hole_changes, count, NULL);
+}
+
+void Level_ClearHoleChanges(Level_T * level)
+{
+   ArrayList_Clear(&level->hole_changes);
+}
+
+// Compared against the one int per tile the terrain used to be stored in,
+// when gold and holes were found by searching their lists
+void Level_PrintMemoryReport(Level_T * level)
+{
+   size_t size, chunked, unpacked, lookup;
+   size     = (size_t)level->tmap.width * level->tmap.height;
+   chunked  = TerrainMap_GetMemoryUsage(&level->tmap);
+   unpacked = size * sizeof(int);
+   lookup   = IntMap_GetMemoryUsage(&level->gold_map) + 
+              IntMap_GetMemoryUsage(&level->dig_map);
+
+   printf("Level %ix%i Memory:\n", level->tmap.width, level->tmap.height);
+   printf("   Chunks:          %i of %i allocated\n", 
+          level->tmap.chunk_count, 
+          level->tmap.chunk_width * level->tmap.chunk_height);
+   printf("   Chunk Storage:   %lu bytes\n", (unsigned long)chunked);
+   printf("   Slot Lookups:    %lu bytes\n", (unsigned long)lookup);
+   printf("   Int Per Tile:    %lu bytes\n", (unsigned long)unpacked);
+   printf("   Reduction:       %.1fx\n", (double)unpacked / (double)(chunked + lookup));
+}
+
 // E Level
 
 
@@ -21,6 +21,28 @@
 #ifndef __LEVEL_H__
 #define __LEVEL_H__
 
+#include <stdint.h>
+
+// Terrain is stored in square chunks of TMAP_CHUNK_SIZE tiles
+#define TMAP_CHUNK_SHIFT 5
+#define TMAP_CHUNK_SIZE  (1 << TMAP_CHUNK_SHIFT)
+#define TMAP_CHUNK_MASK  (TMAP_CHUNK_SIZE - 1)
+
+// Chunks are split into square render blocks of TMAP_BLOCK_SIZE tiles
+#define TMAP_BLOCK_SHIFT 3
+#define TMAP_BLOCK_SIZE  (1 << TMAP_BLOCK_SHIFT)
+#define TMAP_BLOCK_MASK  (TMAP_BLOCK_SIZE - 1)
+#define TMAP_BLOCKS_PER_CHUNK_ROW (TMAP_CHUNK_SIZE / TMAP_BLOCK_SIZE)
+
+// Bit planes held by each chunk
+#define TMAP_PLANE_GOLD  0
+#define TMAP_PLANE_HOLE  1
+#define TMAP_PLANE_COUNT 2
+
+// Dig spot transitions are scheduled on a wheel of this many slots, one slot
+// per DIG_SPOT_DELATA_FRAME_TIMEOUT. It must be a power of two.
+#define LEVEL_DIG_WHEEL_SIZE 64
+
 // Map Tile Type
 #define TMAP_TILE_AIR    0
 #define TMAP_TILE_DIRT   1
@@ -31,18 +53,40 @@
 
 typedef struct Level_S          Level_T;
 typedef struct TerrainMap_S     TerrainMap_T;
+typedef struct TerrainChunk_S   TerrainChunk_T;
 typedef struct Gold_S           Gold_T;
 typedef enum   DigSpot_State_E  DigSpot_State_T;
 typedef struct DigSpot_S        DigSpot_T;
 typedef struct LevelTile_S      LevelTile_T;
+typedef struct LevelRenderStats_S LevelRenderStats_T;
+typedef struct LevelSnapshot_S  LevelSnapshot_T;
+
 
 
+struct TerrainChunk_S
+{
+   uint8_t  terrain[TMAP_CHUNK_SIZE * TMAP_CHUNK_SIZE]; // One TMAP_TILE_* per tile
+   uint32_t bits[TMAP_PLANE_COUNT][TMAP_CHUNK_SIZE];    // One word per chunk row
+};
 
 struct TerrainMap_S
 {
    int width;
    int height;
-   int * data;
+   int chunk_width;
+   int chunk_height;
+   int chunk_count;             // Chunks that are allocated
+   TerrainChunk_T ** chunks;    // All-air chunks share one empty chunk
+};
+
+struct LevelRenderStats_S
+{
+   int tiles_drawn;
+   int tiles_culled;
+   int gold_drawn;
+   int gold_culled;
+   int blocks_drawn;
+   int blocks_refreshed;
 };
 
 struct Level_S
@@ -51,7 +95,36 @@ struct Level_S
    ArrayList_T  dig_list;
    ArrayList_T  gold_list;
    ArrayList_T  gold_list_init;
+   ArrayList_T  door_list;
+   ArrayList_T  guard_list;   // Pos2D_T where each guard starts
+   IntMap_T     gold_map; // Tile index to gold_list index
+   IntMap_T     dig_map;  // Tile index to dig_list index
+   ArrayList_T  dig_closed; // dig_list indices to remove after an update
+   ArrayList_T  hole_changes; // Pos2D_T of holes opened or closed since
+                              // the last Level_ClearHoleChanges
+   int          dig_wheel[LEVEL_DIG_WHEEL_SIZE]; // First dig_list index or -1
+   int          dig_tick;   // Last wheel tick processed
+   double       dig_time;   // Seconds since the level was restarted
    Pos2D_T start_spot;
+   int generation;                  // Changes whenever every block is stale
+   int gold_version;                // Changes whenever gold is added or removed
+   int doors_open;
+};
+
+// Copy of everything Level_Render draws that changes while a level is
+// played, so the level can be rendered on another thread while it updates.
+// Terrain is read from level itself since it is fixed once loaded.
+struct LevelSnapshot_S
+{
+   Level_T    * level;
+   int          generation;
+   int          gold_version;
+   int          doors_open;
+   int          gold_count;
+   ArrayList_T  gold_rows;    // uint32_t gold bits, TMAP_CHUNK_SIZE rows per
+   IntMap_T     gold_chunks;  // chunk with gold, found by chunk index
+   ArrayList_T  dig_list;
+   IntMap_T     dig_map;  // Tile index to dig_list index
 };
 
 
@@ -71,9 +144,12 @@ enum DigSpot_State_E
 struct DigSpot_S
 {
    Pos2D_T pos;
-   float timer;
+   double deadline; // Level time of the next state or frame change
    DigSpot_State_T state;
    int frame;
+   int wheel_slot;
+   int wheel_prev;  // dig_list indices, -1 at either end of the slot
+   int wheel_next;
 };
 
 struct LevelTile_S
@@ -95,9 +171,51 @@ void Level_Load(Level_T * level, const char * filename);
 
 void Level_Restart(Level_T * level);
 
+// Makes dest, which must have been through Level_Init, a deep copy of src
+// that can be updated without touching src
+void Level_Copy(Level_T * dest, const Level_T * src);
+
+void LevelSnapshot_Init(LevelSnapshot_T * snapshot);
+void LevelSnapshot_Destroy(LevelSnapshot_T * snapshot);
+
+// Gold is only copied again when it changed since snapshot was last taken
+void Level_TakeSnapshot(Level_T * level, LevelSnapshot_T * snapshot);
+
 
 #ifdef SDL_LIB_INCLUDED
-void Level_Render(Level_T * level, SDL_Renderer * rend, int offset_x, int offset_y, SDL_Texture * t_terrain);
+typedef struct LevelRenderCache_S     LevelRenderCache_T;
+typedef struct LevelRenderCacheSlot_S LevelRenderCacheSlot_T;
+
+// Static terrain pre-rendered into one target texture per render block
+struct LevelRenderCache_S
+{
+   SDL_Renderer * rend;
+   int            enabled;
+   Level_T      * level;
+   int            generation;
+   int            frame;
+   ArrayList_T    slot_list;
+   IntMap_T       block_map; // Block index to slot_list index
+   int            doors_open; // As last drawn, blocks are refreshed where
+   ArrayList_T    dig_list;   // the next snapshot differs from these
+   IntMap_T       dig_map;
+};
+
+struct LevelRenderCacheSlot_S
+{
+   SDL_Texture * texture;
+   int           block;
+   int           last_used;
+   int           dirty;
+};
+
+void LevelRenderCache_Init(LevelRenderCache_T * cache, SDL_Renderer * rend);
+void LevelRenderCache_Destroy(LevelRenderCache_T * cache);
+
+// view is the visible area in the same coordinates as the offsets
+// Sprites are queued in batch, cache may be NULL to queue every visible tile
+// stats gets what this call drew and culled
+void Level_Render(const LevelSnapshot_T * snapshot, SDLTools_Batch_T * batch, LevelRenderCache_T * cache, const SDL_Rect * view, int offset_x, int offset_y, SDL_Texture * t_terrain, LevelRenderStats_T * stats);
 #endif // SDL_LIB_INCLUDED
 
 void Level_Update(Level_T * level, float seconds);
@@ -118,5 +236,15 @@ int Level_GetGoldCount(Level_T * level, int * level_total);
 
 void Level_GetStartSpot(Level_T * level, int * x, int * y);
 
+Pos2D_T * Level_GetGuardSpots(Level_T * level, size_t * count);
+
+// Tiles that gained or lost a hole. The list keeps growing until cleared,
+// so whoever updates the level clears it once it has seen the changes.
+// A new generation means every tile may have changed.
+Pos2D_T * Level_GetHoleChanges(Level_T * level, size_t * count);
+void Level_ClearHoleChanges(Level_T * level);
+
+void Level_PrintMemoryReport(Level_T * level);
+
 #endif // __LEVEL_H__
 
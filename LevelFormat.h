@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __LEVELFORMAT_H__
+#define __LEVELFORMAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compiled level file, written by level_tool and read by Level_Load.
+//
+// Layout, in the byte order of the machine that wrote it:
+//    LevelFormatHeader_T
+//    gold_count pairs of int32 x, y
+//    door_count pairs of int32 x, y
+//    guard_count pairs of int32 x, y
+//    tile_bytes of tile data, one TMAP_TILE_* byte per tile in row order,
+//    or (run length, tile) byte pairs if LEVELFORMAT_FLAG_RLE is set
+//
+// The byte order is not converted. A file written on a machine of the
+// other byte order fails the version check and is turned away.
+//
+// Every position, the start included, has to be on the map. No two gold
+// or two doors may share a tile, and the doors listed have to be exactly
+// the TMAP_TILE_DOOR tiles. Tiles past TMAP_TILE_DOOR are not allowed.
+
+#define LEVELFORMAT_MAGIC       "LCLV"
+#define LEVELFORMAT_MAGIC_SIZE  4
+#define LEVELFORMAT_VERSION     2
+
+// Version 1 headers stop short of guard_count, their levels have no guards
+#define LEVELFORMAT_HEADER_V1_SIZE offsetof(LevelFormatHeader_T, guard_count)
+
+#define LEVELFORMAT_FLAG_RLE    0x0001
+
+// Largest width or height a level may have. Tile indexes are kept in an
+// int, and width * height has to fit in one.
+#define LEVELFORMAT_MAX_SIDE    16384
+
+typedef struct LevelFormatHeader_S LevelFormatHeader_T;
+
+struct LevelFormatHeader_S
+{
+   char     magic[LEVELFORMAT_MAGIC_SIZE];
+   uint16_t version;
+   uint16_t flags;
+   int32_t  width;
+   int32_t  height;
+   int32_t  start_x;
+   int32_t  start_y;
+   uint32_t gold_count;
+   uint32_t door_count;
+   uint32_t tile_bytes;
+   uint32_t guard_count;
+};
+
+#endif // __LEVELFORMAT_H__
+
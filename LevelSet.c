@@ -19,32 +19,54 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "SDLInclude.h"
 
 #include "GlobalData.h"
 #include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
 #include "Pos2D.h"
 #include "Level.h"
 #include "LevelSet.h"
 
-void LevelSet_Init(LevelSet_T * levelset)
-{
-   ArrayList_Init(&levelset->level_list, sizeof(Level_T), 0);
-}
+#define MIN_RESIDENT 2 // The current level and the one being prefetched
 
-void LevelSet_Destroy(LevelSet_T * levelset)
-{
-   size_t i, size;
-   Level_T * level;
+static int       LevelSet_Worker(void * data);
+static void      LevelSet_StopWorker(LevelSet_T * levelset);
+static Level_T * LevelSet_LoadLevel(const char * filename);
+static void      LevelSet_Evict(LevelSet_T * levelset);
+static void      LevelSet_ClearEntries(LevelSet_T * levelset);
 
-   level = ArrayList_Get(&levelset->level_list, &size, NULL);
-   for(i = 0; i < size; i++)
+void LevelSet_Init(LevelSet_T * levelset, size_t max_resident)
+{
+   ArrayList_Init(&levelset->entry_list, sizeof(LevelSetEntry_T), 0);
+   if(max_resident < MIN_RESIDENT)
    {
-      Level_Destroy(&level[i]);
+      max_resident = MIN_RESIDENT;
    }
+   levelset->max_resident   = max_resident;
+   levelset->resident       = 0;
+   levelset->current        = 0;
+   levelset->use_clock      = 0;
+   levelset->prefetch_index = -1;
+   levelset->quit           = 0;
+   levelset->worker         = NULL;
+   levelset->lock           = SDL_CreateMutex();
+   levelset->wake           = SDL_CreateCond();
+   levelset->loaded         = SDL_CreateCond();
+}
 
-   ArrayList_Destroy(&levelset->level_list);
-
+void LevelSet_Destroy(LevelSet_T * levelset)
+{
+   LevelSet_StopWorker(levelset);
+   LevelSet_ClearEntries(levelset);
+   ArrayList_Destroy(&levelset->entry_list);
+   SDL_DestroyCond(levelset->loaded);
+   SDL_DestroyCond(levelset->wake);
+   SDL_DestroyMutex(levelset->lock);
 }
 
 
@@ -54,10 +76,11 @@ void LevelSet_Load(LevelSet_T * levelset, const char * filename)
    FILE * file;
    char buffer [LINE_BUFFER_SIZE];
    char * bp;
-   Level_T * level;
+   LevelSetEntry_T * entry;
    
-
-   ArrayList_Clear(&levelset->level_list);
+   // The worker holds pointers into the entry list
+   LevelSet_StopWorker(levelset);
+   LevelSet_ClearEntries(levelset);
    
    file = fopen(filename, "r");
 
@@ -85,10 +108,14 @@ void LevelSet_Load(LevelSet_T * levelset, const char * filename)
                }
                bp ++;
             }
-            // Load and Add Level to the List
-            level = ArrayList_Add(&levelset->level_list, NULL);
-            Level_Init(level);
-            Level_Load(level, buffer);
+            // Only remember where the level is, it is loaded on first use
+            entry = ArrayList_Add(&levelset->entry_list, NULL);
+            entry->filename = malloc(strlen(buffer) + 1);
+            strcpy(entry->filename, buffer);
+            entry->level     = NULL;
+            entry->loading   = 0;
+            entry->pins      = 0;
+            entry->last_used = 0;
 
             //printf("Found \"%s\"\n", buffer);
          }
@@ -100,21 +127,61 @@ void LevelSet_Load(LevelSet_T * levelset, const char * filename)
 
 }
 
-Level_T * LevelSet_GetAll(LevelSet_T * levelset, size_t * size)
+size_t LevelSet_GetCount(LevelSet_T * levelset)
 {
-   return ArrayList_Get(&levelset->level_list, size, NULL);
+   size_t size;
+   ArrayList_Get(&levelset->entry_list, &size, NULL);
+   return size;
 }
 
 
 
 Level_T * LevelSet_GetLevel(LevelSet_T * levelset, size_t index)
 {
-   Level_T * result, * levels;
+   Level_T * result;
+   LevelSetEntry_T * entries;
    size_t size;
-   levels = ArrayList_Get(&levelset->level_list, &size, NULL);
+   entries = ArrayList_Get(&levelset->entry_list, &size, NULL);
    if(index < size)
    {
-      result = &levels[index];
+      SDL_LockMutex(levelset->lock);
+
+      // Wait out a prefetch of this level rather than loading it twice
+      while(entries[index].loading)
+      {
+         SDL_CondWait(levelset->loaded, levelset->lock);
+      }
+
+      if(entries[index].level == NULL)
+      {
+         entries[index].loading = 1;
+         SDL_UnlockMutex(levelset->lock);
+         result = LevelSet_LoadLevel(entries[index].filename);
+         SDL_LockMutex(levelset->lock);
+         entries[index].loading = 0;
+         entries[index].level   = result;
+         levelset->resident ++;
+         // Wake any other thread that was waiting on this level
+         SDL_CondBroadcast(levelset->loaded);
+      }
+
+      result = entries[index].level;
+      entries[index].last_used = ++ levelset->use_clock;
+      levelset->current = index;
+      LevelSet_Evict(levelset);
+
+      if(index + 1 < size && entries[index + 1].level == NULL)
+      {
+         if(levelset->worker == NULL)
+         {
+            levelset->quit   = 0;
+            levelset->worker = SDL_CreateThread(LevelSet_Worker, "LevelSet", levelset);
+         }
+         levelset->prefetch_index = (int)(index + 1);
+         SDL_CondSignal(levelset->wake);
+      }
+
+      SDL_UnlockMutex(levelset->lock);
    }
    else
    {
@@ -123,3 +190,139 @@ Level_T * LevelSet_GetLevel(LevelSet_T * levelset, size_t index)
    return result;
 }
 
+void LevelSet_Pin(LevelSet_T * levelset, size_t index)
+{
+   LevelSetEntry_T * entry;
+   if(index < LevelSet_GetCount(levelset))
+   {
+      SDL_LockMutex(levelset->lock);
+      entry = ArrayList_GetIndex(&levelset->entry_list, index);
+      entry->pins ++;
+      SDL_UnlockMutex(levelset->lock);
+   }
+}
+
+void LevelSet_Unpin(LevelSet_T * levelset, size_t index)
+{
+   LevelSetEntry_T * entry;
+   if(index < LevelSet_GetCount(levelset))
+   {
+      SDL_LockMutex(levelset->lock);
+      entry = ArrayList_GetIndex(&levelset->entry_list, index);
+      entry->pins --;
+      // It may have been kept over the cap
+      LevelSet_Evict(levelset);
+      SDL_UnlockMutex(levelset->lock);
+   }
+}
+
+static int LevelSet_Worker(void * data)
+{
+   LevelSet_T * levelset;
+   LevelSetEntry_T * entry;
+   Level_T * level;
+
+   levelset = data;
+   SDL_LockMutex(levelset->lock);
+   while(!levelset->quit)
+   {
+      if(levelset->prefetch_index < 0)
+      {
+         SDL_CondWait(levelset->wake, levelset->lock);
+      }
+      else
+      {
+         entry = ArrayList_GetIndex(&levelset->entry_list, levelset->prefetch_index);
+         levelset->prefetch_index = -1;
+         if(entry->level == NULL && !entry->loading)
+         {
+            entry->loading = 1;
+            SDL_UnlockMutex(levelset->lock);
+            level = LevelSet_LoadLevel(entry->filename);
+            SDL_LockMutex(levelset->lock);
+            entry->loading   = 0;
+            entry->level     = level;
+            entry->last_used = ++ levelset->use_clock;
+            levelset->resident ++;
+            LevelSet_Evict(levelset);
+            SDL_CondBroadcast(levelset->loaded);
+         }
+      }
+   }
+   SDL_UnlockMutex(levelset->lock);
+   return 0;
+}
+
+// Must be called without the lock held
+static void LevelSet_StopWorker(LevelSet_T * levelset)
+{
+   if(levelset->worker != NULL)
+   {
+      SDL_LockMutex(levelset->lock);
+      levelset->quit = 1;
+      SDL_CondSignal(levelset->wake);
+      SDL_UnlockMutex(levelset->lock);
+      SDL_WaitThread(levelset->worker, NULL);
+      levelset->worker = NULL;
+   }
+   levelset->prefetch_index = -1;
+}
+
+static Level_T * LevelSet_LoadLevel(const char * filename)
+{
+   Level_T * level;
+   level = malloc(sizeof(Level_T));
+   Level_Init(level);
+   Level_Load(level, filename);
+   return level;
+}
+
+// Drops least recently used levels until under the cap. Lock must be held.
+static void LevelSet_Evict(LevelSet_T * levelset)
+{
+   LevelSetEntry_T * entries, * oldest;
+   size_t i, size;
+
+   entries = ArrayList_Get(&levelset->entry_list, &size, NULL);
+   while(levelset->resident > levelset->max_resident)
+   {
+      oldest = NULL;
+      for(i = 0; i < size; i++)
+      {
+         if(entries[i].level != NULL && i != levelset->current && entries[i].pins == 0 &&
+            (oldest == NULL || entries[i].last_used < oldest->last_used))
+         {
+            oldest = &entries[i];
+         }
+      }
+
+      if(oldest == NULL)
+      {
+         break;
+      }
+      Level_Destroy(oldest->level);
+      free(oldest->level);
+      oldest->level = NULL;
+      levelset->resident --;
+   }
+}
+
+static void LevelSet_ClearEntries(LevelSet_T * levelset)
+{
+   LevelSetEntry_T * entries;
+   size_t i, size;
+
+   entries = ArrayList_Get(&levelset->entry_list, &size, NULL);
+   for(i = 0; i < size; i++)
+   {
+      if(entries[i].level != NULL)
+      {
+         Level_Destroy(entries[i].level);
+         free(entries[i].level);
+      }
+      free(entries[i].filename);
+   }
+   ArrayList_Clear(&levelset->entry_list);
+   levelset->resident = 0;
+}
+
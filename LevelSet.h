@@ -1,25 +1,54 @@
 #ifndef __LEVELSET_H__
 #define __LEVELSET_H__
 
-typedef struct LevelSet_S LevelSet_T;
+typedef struct LevelSet_S      LevelSet_T;
+typedef struct LevelSetEntry_S LevelSetEntry_T;
+
+// Levels are only parsed when first asked for. A worker thread loads the
+// level after the one last asked for, and at most max_resident levels are
+// kept, dropping the least recently used. The last level returned by
+// LevelSet_GetLevel and pinned levels are never dropped.
 
 struct LevelSet_S
 {
-   ArrayList_T level_list;
+   ArrayList_T         entry_list;
+   size_t              max_resident;
+   size_t              resident;
+   size_t              current;
+   unsigned int        use_clock;
+   int                 prefetch_index; // -1 when the worker has nothing to do
+   int                 quit;
+   struct SDL_Thread * worker;
+   struct SDL_mutex  * lock;
+   struct SDL_cond   * wake;    // Signals the worker
+   struct SDL_cond   * loaded;  // Signalled by the worker
+};
+
+struct LevelSetEntry_S
+{
+   char       * filename;
+   Level_T    * level;   // NULL until loaded
+   int          loading;
+   int          pins;    // Held by LevelSet_Pin
+   unsigned int last_used;
 };
 
 
-void LevelSet_Init(LevelSet_T * levelset);
+void LevelSet_Init(LevelSet_T * levelset, size_t max_resident);
 void LevelSet_Destroy(LevelSet_T * levelset);
 
 
 void LevelSet_Load(LevelSet_T * levelset, const char * filename);
 
-Level_T * LevelSet_GetAll(LevelSet_T * levelset, size_t * size);
+size_t LevelSet_GetCount(LevelSet_T * levelset);
 
 Level_T * LevelSet_GetLevel(LevelSet_T * levelset, size_t index);
 
+// Keeps a loaded level resident while another thread may still read it,
+// every LevelSet_Pin needs a matching LevelSet_Unpin
+void LevelSet_Pin(LevelSet_T * levelset, size_t index);
+void LevelSet_Unpin(LevelSet_T * levelset, size_t index);
 
 
-#endif // __LEVELSET_H__
 
+#endif // __LEVELSET_H__
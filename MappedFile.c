@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+int MappedFile_Open(MappedFile_T * mapped, const char * filename)
+{
+   HANDLE file, mapping;
+   LARGE_INTEGER size;
+   const void * data;
+
+   mapped->data    = NULL;
+   mapped->size    = 0;
+   mapped->file    = NULL;
+   mapped->mapping = NULL;
+
+   file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, 
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      return 0;
+   }
+
+   if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+   {
+      CloseHandle(file);
+      return 0;
+   }
+
+   mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   if(mapping == NULL)
+   {
+      CloseHandle(file);
+      return 0;
+   }
+
+   data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if(data == NULL)
+   {
+      CloseHandle(mapping);
+      CloseHandle(file);
+      return 0;
+   }
+
+   mapped->data    = data;
+   mapped->size    = (size_t)size.QuadPart;
+   mapped->file    = file;
+   mapped->mapping = mapping;
+   return 1;
+}
+
+void MappedFile_Close(MappedFile_T * mapped)
+{
+   if(mapped->data != NULL)
+   {
+      UnmapViewOfFile(mapped->data);
+      CloseHandle(mapped->mapping);
+      CloseHandle(mapped->file);
+      mapped->data = NULL;
+      mapped->size = 0;
+   }
+}
+
+#else // _WIN32
+
+int MappedFile_Open(MappedFile_T * mapped, const char * filename)
+{
+   int fd;
+   struct stat info;
+   void * data;
+
+   mapped->data    = NULL;
+   mapped->size    = 0;
+   mapped->file    = NULL;
+   mapped->mapping = NULL;
+
+   fd = open(filename, O_RDONLY);
+   if(fd < 0)
+   {
+      return 0;
+   }
+
+   if(fstat(fd, &info) != 0 || info.st_size == 0)
+   {
+      close(fd);
+      return 0;
+   }
+
+   data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   // The mapping stays valid after the descriptor is closed
+   close(fd);
+   if(data == MAP_FAILED)
+   {
+      return 0;
+   }
+
+   mapped->data = data;
+   mapped->size = (size_t)info.st_size;
+   return 1;
+}
+
+void MappedFile_Close(MappedFile_T * mapped)
+{
+   if(mapped->data != NULL)
+   {
+      munmap((void *)mapped->data, mapped->size);
+      mapped->data = NULL;
+      mapped->size = 0;
+   }
+}
+
+#endif // _WIN32
+
@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+// Read only view of a whole file mapped into memory
+
+typedef struct MappedFile_S MappedFile_T;
+
+struct MappedFile_S
+{
+   const void * data;
+   size_t       size;
+   void       * file;    // Platform handles
+   void       * mapping;
+};
+
+// Returns 0 if the file could not be mapped
+int  MappedFile_Open(MappedFile_T * mapped, const char * filename);
+void MappedFile_Close(MappedFile_T * mapped);
+
+#endif // __MAPPEDFILE_H__
+
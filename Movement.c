@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDLInclude.h"
+
+#include "GlobalData.h"
+
+#include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "Movement.h"
+
+int Movement_IsPassable(const LevelTile_T * from, const LevelTile_T * to)
+{
+   int result;
+   if(to->out_of_range == 0 && 
+     (
+       (to->terrain_type == TMAP_TILE_DIRT && to->has_hole == 1) || 
+       (to->terrain_type != TMAP_TILE_DIRT)
+     ))
+   {
+      result = 1;
+   }
+   else
+   {
+      result = 0;
+   }
+   return result;
+}
+
+int Movement_IsFallable(const LevelTile_T *  from, const LevelTile_T *  to)
+{
+   int result;
+   if(to->out_of_range == 0 && 
+      (to->terrain_type == TMAP_TILE_AIR || to->terrain_type == TMAP_TILE_BAR || to->has_hole == 1 || to->terrain_type == TMAP_TILE_DOOR) && 
+      from->terrain_type != TMAP_TILE_LADDER && from->terrain_type != TMAP_TILE_BAR)
+   {
+      result = 1;      
+   }
+   else
+   {
+      result = 0;
+   }
+   return result;
+}
+
+int Movement_CanDig(const LevelTile_T * dig, const LevelTile_T * above)
+{
+   int result;
+   if(dig->out_of_range == 0 && above->out_of_range == 0 &&
+      dig->terrain_type == TMAP_TILE_DIRT && 
+      (above->terrain_type == TMAP_TILE_AIR || above->has_hole == 1))
+   {
+      result = 1;
+   }
+   else
+   {
+      result = 0;
+   }
+   return result;
+}
+
+void Movement_QueryAround(Level_T * level, int x, int y, 
+                          LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND])
+{
+   int dx, dy;
+   for(dy = -1; dy <= 1; dy++)
+   {
+      for(dx = -1; dx <= 1; dx++)
+      {
+         Level_QueryTile(level, x + dx, y + dy, &around[dy + 1][dx + 1]);
+      }
+   }
+}
+
+void Movement_GetOptions(LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND], 
+                         Movement_Options_T * options)
+{
+   LevelTile_T * current;
+   current = &around[1][1];
+
+   options->fall       = Movement_IsFallable(current, &around[2][1]);
+   options->dig_left   = Movement_CanDig(&around[2][0], &around[1][0]);
+   options->dig_right  = Movement_CanDig(&around[2][2], &around[1][2]);
+   options->move_left  = Movement_IsPassable(current, &around[1][0]);
+   options->move_right = Movement_IsPassable(current, &around[1][2]);
+   options->move_up    = Movement_IsPassable(current, &around[0][1]) &&
+                         current->terrain_type == TMAP_TILE_LADDER;
+   if(Movement_IsPassable(current, &around[2][1]))
+   {
+      options->move_down = current->terrain_type != TMAP_TILE_BAR;
+      options->let_go    = current->terrain_type == TMAP_TILE_BAR;
+   }
+   else
+   {
+      options->move_down = 0;
+      options->let_go    = 0;
+   }
+}
+
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __MOVEMENT_H__
+#define __MOVEMENT_H__
+
+// The rules for where a player can go from the tile it stands on. The game
+// applies them each time the player comes to rest, and level_check walks
+// them to find what a level lets the player reach.
+
+typedef struct Movement_Options_S Movement_Options_T;
+
+// Tiles around the player, indexed [dy + 1][dx + 1]
+#define MOVEMENT_AROUND 3
+
+// What a player at rest can do next. Falling can't be refused, the rest
+// need their key held. Digging opens the dirt below and beside the player.
+struct Movement_Options_S
+{
+   int fall;
+   int dig_left;
+   int dig_right;
+   int move_left;
+   int move_right;
+   int move_up;
+   int move_down;   // Climbing down
+   int let_go;      // Dropping from a bar
+};
+
+int  Movement_IsPassable(const LevelTile_T * from, const LevelTile_T * to);
+int  Movement_IsFallable(const LevelTile_T * from, const LevelTile_T * to);
+int  Movement_CanDig(const LevelTile_T * dig, const LevelTile_T * above);
+
+void Movement_QueryAround(Level_T * level, int x, int y, 
+                          LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND]);
+
+void Movement_GetOptions(LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND], 
+                         Movement_Options_T * options);
+
+#endif // __MOVEMENT_H__
+
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifdef PROFILER_ENABLED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SDLInclude.h"
+
+#include "Profiler.h"
+
+static int Profiler_CompareFloat(const void * a, const void * b);
+
+static const char * Profiler_PhaseNames[e_pp_last] = 
+{
+   "input",
+   "update_actors",
+   "update_level",
+   "update_guards",
+   "update_other",
+   "render_level",
+   "render_text",
+   "present",
+   "frame"
+};
+
+static double      profiler_ms_per_count;
+static Uint64      profiler_start[e_pp_last];
+static float       profiler_current[e_pp_last];  // This frame so far
+static float       profiler_window[e_pp_last][PROFILER_WINDOW];
+static int         profiler_window_count;
+static int         profiler_window_next;
+static FILE      * profiler_csv;                 // NULL when not writing one
+static const char * profiler_csv_filename;
+static unsigned long profiler_frames;            // Written to profiler_csv
+
+// Update phases are timed on the simulation thread and everything else on
+// the render thread, so each start time has one owner but the totals don't
+static SDL_SpinLock profiler_lock;
+
+void Profiler_Init(const char * csv_filename)
+{
+   int phase;
+
+   profiler_ms_per_count = 1000.0 / SDL_GetPerformanceFrequency();
+   memset(profiler_current, 0, sizeof(profiler_current));
+   profiler_window_count = 0;
+   profiler_window_next  = 0;
+   profiler_frames       = 0;
+   profiler_csv          = NULL;
+   profiler_csv_filename = csv_filename;
+   if(csv_filename != NULL)
+   {
+      profiler_csv = fopen(csv_filename, "w");
+      if(profiler_csv == NULL)
+      {
+         printf("Error: Could not write profile \"%s\"\n", csv_filename);
+      }
+      else
+      {
+         fprintf(profiler_csv, "frame");
+         for(phase = 0; phase < e_pp_last; phase++)
+         {
+            fprintf(profiler_csv, ",%s_ms", Profiler_PhaseNames[phase]);
+         }
+         fprintf(profiler_csv, "\n");
+      }
+   }
+}
+
+void Profiler_Destroy(void)
+{
+   if(profiler_csv != NULL)
+   {
+      fclose(profiler_csv);
+      profiler_csv = NULL;
+      printf("Wrote %lu profiled frames to %s\n", profiler_frames, profiler_csv_filename);
+   }
+}
+
+void Profiler_Begin(Profiler_Phase_T phase)
+{
+   profiler_start[phase] = SDL_GetPerformanceCounter();
+}
+
+void Profiler_End(Profiler_Phase_T phase)
+{
+   float elapsed;
+   elapsed = (float)((SDL_GetPerformanceCounter() - profiler_start[phase]) * 
+                     profiler_ms_per_count);
+   SDL_AtomicLock(&profiler_lock);
+   profiler_current[phase] += elapsed;
+   SDL_AtomicUnlock(&profiler_lock);
+}
+
+// Only the frame's row is kept, in the window and in the CSV file
+void Profiler_EndFrame(void)
+{
+   int phase;
+   float frame[e_pp_last];
+
+   SDL_AtomicLock(&profiler_lock);
+   for(phase = 0; phase < e_pp_last; phase++)
+   {
+      frame[phase] = profiler_current[phase];
+      profiler_window[phase][profiler_window_next] = profiler_current[phase];
+      profiler_current[phase] = 0;
+   }
+   SDL_AtomicUnlock(&profiler_lock);
+
+   if(profiler_csv != NULL)
+   {
+      fprintf(profiler_csv, "%lu", profiler_frames);
+      for(phase = 0; phase < e_pp_last; phase++)
+      {
+         fprintf(profiler_csv, ",%.4f", frame[phase]);
+      }
+      fprintf(profiler_csv, "\n");
+      profiler_frames ++;
+   }
+
+   profiler_window_next = (profiler_window_next + 1) % PROFILER_WINDOW;
+   if(profiler_window_count < PROFILER_WINDOW)
+   {
+      profiler_window_count ++;
+   }
+}
+
+void Profiler_GetStats(Profiler_Phase_T phase, Profiler_Stats_T * stats)
+{
+   float sorted[PROFILER_WINDOW];
+   float sum;
+   int i;
+
+   if(profiler_window_count == 0)
+   {
+      memset(stats, 0, sizeof(Profiler_Stats_T));
+   }
+   else
+   {
+      memcpy(sorted, profiler_window[phase], sizeof(float) * profiler_window_count);
+      qsort(sorted, profiler_window_count, sizeof(float), Profiler_CompareFloat);
+      sum = 0;
+      for(i = 0; i < profiler_window_count; i++)
+      {
+         sum += sorted[i];
+      }
+      stats->min = sorted[0];
+      stats->max = sorted[profiler_window_count - 1];
+      stats->avg = sum / profiler_window_count;
+      stats->p99 = sorted[((profiler_window_count - 1) * 99) / 100];
+   }
+}
+
+const char * Profiler_GetPhaseName(Profiler_Phase_T phase)
+{
+   return Profiler_PhaseNames[phase];
+}
+
+static int Profiler_CompareFloat(const void * a, const void * b)
+{
+   float fa, fb;
+   fa = *(const float *)a;
+   fb = *(const float *)b;
+   return (fa > fb) - (fa < fb);
+}
+
+#endif // PROFILER_ENABLED
+
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+// Frame profiler for the main loop phases. It is only built when
+// PROFILER_ENABLED is defined (bam profiler=true), otherwise the PROFILER_*
+// macros expand to nothing.
+// The update phases run on the simulation thread and count towards
+// whichever rendered frame they finish in.
+
+typedef enum Profiler_Phase_E Profiler_Phase_T;
+enum Profiler_Phase_E
+{
+   e_pp_input,
+   e_pp_update_actors,
+   e_pp_update_level,
+   e_pp_update_guards,
+   e_pp_update_other,
+   e_pp_render_level,
+   e_pp_render_text,
+   e_pp_present,
+   e_pp_frame,
+   e_pp_last
+};
+
+// Frames kept for the rolling statistics
+#define PROFILER_WINDOW 256
+
+#ifdef PROFILER_ENABLED
+
+typedef struct Profiler_Stats_S Profiler_Stats_T;
+struct Profiler_Stats_S
+{
+   float min; // All in milliseconds, over the last PROFILER_WINDOW frames
+   float avg;
+   float p99;
+   float max;
+};
+
+// Writes one line per frame to csv_filename as it goes, NULL to skip
+void Profiler_Init(const char * csv_filename);
+void Profiler_Destroy(void);
+
+// Time between Begin and End adds to the phase's total for this frame
+void Profiler_Begin(Profiler_Phase_T phase);
+void Profiler_End(Profiler_Phase_T phase);
+void Profiler_EndFrame(void);
+
+void Profiler_GetStats(Profiler_Phase_T phase, Profiler_Stats_T * stats);
+const char * Profiler_GetPhaseName(Profiler_Phase_T phase);
+
+#define PROFILER_INIT(filename)     Profiler_Init(filename)
+#define PROFILER_DESTROY()          Profiler_Destroy()
+#define PROFILER_BEGIN(phase)       Profiler_Begin(phase)
+#define PROFILER_END(phase)         Profiler_End(phase)
+#define PROFILER_END_FRAME()        Profiler_EndFrame()
+
+#else // PROFILER_ENABLED
+
+#define PROFILER_INIT(filename)
+#define PROFILER_DESTROY()
+#define PROFILER_BEGIN(phase)
+#define PROFILER_END(phase)
+#define PROFILER_END_FRAME()
+
+#endif // PROFILER_ENABLED
+
+#endif // __PROFILER_H__
+
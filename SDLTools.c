@@ -24,8 +24,17 @@
 #include "SDL2/SDL_ttf.h"
 
 #include "GlobalData.h"
+#include "ArrayList.h"
 #include "SDLTools.h"
 
+// Source rectangles for the subimage ids that fit in the table
+#define SUBIMAGE_TABLE_SIZE 16
+static SDL_Rect SDLTools_SubimageTable[SUBIMAGE_TABLE_SIZE * SUBIMAGE_TABLE_SIZE];
+static int SDLTools_SubimageTableReady = 0;
+
+static void SDLTools_GetSubimageRect(int subimage, SDL_Rect * r_src);
+static void SDLTools_Batch_FlushTexture(SDLTools_Batch_T * batch, SDL_Texture * text, 
+                                        SDLTools_Sprite_T * sprite, size_t count);
 
 
 
@@ -47,25 +56,236 @@ SDL_Texture * SDLTools_LoadTexture(SDL_Renderer * rend, const char * filename)
 
 }
 
+static void SDLTools_GetSubimageRect(int subimage, SDL_Rect * r_src)
+{
+   int ix, iy;
+
+   ix = subimage & 0xFF;
+   iy = (subimage >> 8) & 0xFF;
+
+   if(ix < SUBIMAGE_TABLE_SIZE && iy < SUBIMAGE_TABLE_SIZE)
+   {
+      if(SDLTools_SubimageTableReady == 0)
+      {
+         SDLTools_SubimageTableReady = 1;
+         for(iy = 0; iy < SUBIMAGE_TABLE_SIZE; iy++)
+         {
+            for(ix = 0; ix < SUBIMAGE_TABLE_SIZE; ix++)
+            {
+               SDLTools_SubimageTable[ix + (iy * SUBIMAGE_TABLE_SIZE)].x = ix * TILE_WIDTH;
+               SDLTools_SubimageTable[ix + (iy * SUBIMAGE_TABLE_SIZE)].y = iy * TILE_HEIGHT;
+               SDLTools_SubimageTable[ix + (iy * SUBIMAGE_TABLE_SIZE)].w = TILE_WIDTH;
+               SDLTools_SubimageTable[ix + (iy * SUBIMAGE_TABLE_SIZE)].h = TILE_HEIGHT;
+            }
+         }
+         ix = subimage & 0xFF;
+         iy = (subimage >> 8) & 0xFF;
+      }
+      (*r_src) = SDLTools_SubimageTable[ix + (iy * SUBIMAGE_TABLE_SIZE)];
+   }
+   else
+   {
+      r_src->x = ix * TILE_WIDTH;
+      r_src->y = iy * TILE_HEIGHT;
+      r_src->w = TILE_WIDTH;
+      r_src->h = TILE_HEIGHT;
+   }
+}
+
 void SDLTools_DrawSubimage(SDL_Renderer * rend, SDL_Texture * text, int subimage, int x, int y)
 {   
    SDL_Rect r_src;
    SDL_Rect r_dest;
-   int ix, iy;
    
    r_dest.x = x;
    r_dest.y = y;
    r_dest.w = TILE_WIDTH;
    r_dest.h = TILE_HEIGHT;
 
+   SDLTools_GetSubimageRect(subimage, &r_src);
 
-   ix = subimage & 0xFF;
-   iy = (subimage >> 8) & 0xFF;
+   SDL_RenderCopy(rend, text, &r_src, &r_dest);
+}
 
-   r_src.x = ix * TILE_WIDTH;
-   r_src.y = iy * TILE_HEIGHT;
-   r_src.w = TILE_WIDTH;
-   r_src.h = TILE_HEIGHT;
+// S SDLTools_Batch
 
-   SDL_RenderCopy(rend, text, &r_src, &r_dest);
+void SDLTools_Batch_Init(SDLTools_Batch_T * batch, SDL_Renderer * rend)
+{
+   batch->rend = rend;
+   ArrayList_Init(&batch->sprite_list,  sizeof(SDLTools_Sprite_T), 256);
+   ArrayList_Init(&batch->texture_list, sizeof(SDL_Texture *),     0);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+   ArrayList_Init(&batch->vertex_list,  sizeof(SDL_Vertex),        1024);
+   ArrayList_Init(&batch->index_list,   sizeof(int),               1536);
+#endif
+   batch->sprite_count = 0;
+   batch->draw_calls   = 0;
+}
+
+void SDLTools_Batch_Destroy(SDLTools_Batch_T * batch)
+{
+   ArrayList_Destroy(&batch->sprite_list);
+   ArrayList_Destroy(&batch->texture_list);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+   ArrayList_Destroy(&batch->vertex_list);
+   ArrayList_Destroy(&batch->index_list);
+#endif
+}
+
+void SDLTools_Batch_Begin(SDLTools_Batch_T * batch)
+{
+   ArrayList_Clear(&batch->sprite_list);
+   batch->sprite_count = 0;
+   batch->draw_calls   = 0;
+}
+
+void SDLTools_Batch_Add(SDLTools_Batch_T * batch, SDL_Texture * text, int subimage, int x, int y)
+{
+   SDLTools_Sprite_T * sprite;
+   sprite = ArrayList_Add(&batch->sprite_list, NULL);
+   sprite->texture  = text;
+   sprite->subimage = subimage;
+   sprite->x        = x;
+   sprite->y        = y;
 }
+
+void SDLTools_Batch_Flush(SDLTools_Batch_T * batch)
+{
+   size_t i, k, count, texture_count;
+   SDLTools_Sprite_T * sprite;
+   SDL_Texture ** texture;
+   SDL_Texture ** new_texture;
+
+   sprite = ArrayList_Get(&batch->sprite_list, &count, NULL);
+   if(count > 0)
+   {
+      // Textures in order of first use, there are only ever a few
+      ArrayList_Clear(&batch->texture_list);
+      texture = ArrayList_Get(&batch->texture_list, &texture_count, NULL);
+      for(i = 0; i < count; i++)
+      {
+         for(k = 0; k < texture_count; k++)
+         {
+            if(texture[k] == sprite[i].texture)
+            {
+               break;
+            }
+         }
+         if(k == texture_count)
+         {
+            new_texture = ArrayList_Add(&batch->texture_list, NULL);
+            (*new_texture) = sprite[i].texture;
+            texture = ArrayList_Get(&batch->texture_list, &texture_count, NULL);
+         }
+      }
+
+      for(k = 0; k < texture_count; k++)
+      {
+         SDLTools_Batch_FlushTexture(batch, texture[k], sprite, count);
+      }
+
+      batch->sprite_count += (int)count;
+      ArrayList_Clear(&batch->sprite_list);
+   }
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+
+// One SDL_RenderGeometry call draws every sprite of the texture
+static void SDLTools_Batch_FlushTexture(SDLTools_Batch_T * batch, SDL_Texture * text, 
+                                        SDLTools_Sprite_T * sprite, size_t count)
+{
+   size_t i, base;
+   SDL_Rect r_src;
+   SDL_Vertex * vertex;
+   int * index;
+   int text_w, text_h;
+   float u0, v0, u1, v1;
+   float x0, y0, x1, y1;
+
+   SDL_QueryTexture(text, NULL, NULL, &text_w, &text_h);
+   ArrayList_Clear(&batch->vertex_list);
+   ArrayList_Clear(&batch->index_list);
+   for(i = 0; i < count; i++)
+   {
+      if(sprite[i].texture != text)
+      {
+         continue;
+      }
+
+      SDLTools_GetSubimageRect(sprite[i].subimage, &r_src);
+      u0 = (float)r_src.x / text_w;
+      v0 = (float)r_src.y / text_h;
+      u1 = (float)(r_src.x + r_src.w) / text_w;
+      v1 = (float)(r_src.y + r_src.h) / text_h;
+      x0 = (float)sprite[i].x;
+      y0 = (float)sprite[i].y;
+      x1 = x0 + TILE_WIDTH;
+      y1 = y0 + TILE_HEIGHT;
+
+      base = batch->vertex_list.count;
+      vertex = ArrayList_Add(&batch->vertex_list, NULL);
+      vertex->position.x  = x0; vertex->position.y  = y0;
+      vertex->tex_coord.x = u0; vertex->tex_coord.y = v0;
+      vertex = ArrayList_Add(&batch->vertex_list, NULL);
+      vertex->position.x  = x1; vertex->position.y  = y0;
+      vertex->tex_coord.x = u1; vertex->tex_coord.y = v0;
+      vertex = ArrayList_Add(&batch->vertex_list, NULL);
+      vertex->position.x  = x1; vertex->position.y  = y1;
+      vertex->tex_coord.x = u1; vertex->tex_coord.y = v1;
+      vertex = ArrayList_Add(&batch->vertex_list, NULL);
+      vertex->position.x  = x0; vertex->position.y  = y1;
+      vertex->tex_coord.x = u0; vertex->tex_coord.y = v1;
+
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 0;
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 1;
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 2;
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 0;
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 2;
+      index = ArrayList_Add(&batch->index_list, NULL); (*index) = (int)base + 3;
+   }
+
+   vertex = ArrayList_Get(&batch->vertex_list, &count, NULL);
+   for(i = 0; i < count; i++)
+   {
+      vertex[i].color.r = 0xFF;
+      vertex[i].color.g = 0xFF;
+      vertex[i].color.b = 0xFF;
+      vertex[i].color.a = 0xFF;
+   }
+
+   SDL_RenderGeometry(batch->rend, text, 
+                      vertex, (int)count, 
+                      ArrayList_Get(&batch->index_list, NULL, NULL), 
+                      (int)batch->index_list.count);
+   batch->draw_calls ++;
+}
+
+#else
+
+// No geometry API before SDL 2.0.18, so each sprite is one copy
+static void SDLTools_Batch_FlushTexture(SDLTools_Batch_T * batch, SDL_Texture * text, 
+                                        SDLTools_Sprite_T * sprite, size_t count)
+{
+   size_t i;
+   SDL_Rect r_src;
+   SDL_Rect r_dest;
+
+   r_dest.w = TILE_WIDTH;
+   r_dest.h = TILE_HEIGHT;
+   for(i = 0; i < count; i++)
+   {
+      if(sprite[i].texture == text)
+      {
+         SDLTools_GetSubimageRect(sprite[i].subimage, &r_src);
+         r_dest.x = sprite[i].x;
+         r_dest.y = sprite[i].y;
+         SDL_RenderCopy(batch->rend, text, &r_src, &r_dest);
+         batch->draw_calls ++;
+      }
+   }
+}
+
+#endif
+
+// E SDLTools_Batch
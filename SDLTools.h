@@ -23,10 +23,43 @@
 
 
 
+typedef struct SDLTools_Batch_S  SDLTools_Batch_T;
+typedef struct SDLTools_Sprite_S SDLTools_Sprite_T;
+
+// Collects subimage draws between Begin and Flush and submits them
+// grouped by texture, in the order each texture was first queued
+struct SDLTools_Batch_S
+{
+   SDL_Renderer * rend;
+   ArrayList_T    sprite_list;
+   ArrayList_T    texture_list;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+   ArrayList_T    vertex_list;
+   ArrayList_T    index_list;
+#endif
+   int            sprite_count; // Since the last Begin
+   int            draw_calls;   // Since the last Begin
+};
+
+struct SDLTools_Sprite_S
+{
+   SDL_Texture * texture;
+   int           subimage;
+   int           x;
+   int           y;
+};
+
 SDL_Texture * SDLTools_LoadTexture(SDL_Renderer * rend, const char * filename);
 
 void SDLTools_DrawSubimage(SDL_Renderer * rend, SDL_Texture * text, int subimage, int x, int y);
 
+void SDLTools_Batch_Init(SDLTools_Batch_T * batch, SDL_Renderer * rend);
+void SDLTools_Batch_Destroy(SDLTools_Batch_T * batch);
+
+void SDLTools_Batch_Begin(SDLTools_Batch_T * batch);
+void SDLTools_Batch_Add(SDLTools_Batch_T * batch, SDL_Texture * text, int subimage, int x, int y);
+void SDLTools_Batch_Flush(SDLTools_Batch_T * batch);
+
 
 #endif //  __SDLTOOLS_H__
 
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdlib.h>
+
+#include "SDLInclude.h"
+
+#include "TripleBuffer.h"
+
+#define TRIPLEBUFFER_FRESH 4 // Set on middle when it holds an unread slot
+#define TRIPLEBUFFER_INDEX 3
+
+void   TripleBuffer_Init(TripleBuffer_T * buffer, void * slot0, void * slot1, void * slot2)
+{
+   buffer->slots[0] = slot0;
+   buffer->slots[1] = slot1;
+   buffer->slots[2] = slot2;
+   buffer->write = 0;
+   buffer->read  = 2;
+   SDL_AtomicSet(&buffer->middle, 1);
+}
+
+void * TripleBuffer_GetWrite(TripleBuffer_T * buffer)
+{
+   return buffer->slots[buffer->write];
+}
+
+void   TripleBuffer_Publish(TripleBuffer_T * buffer)
+{
+   // The slot contents have to land before the reader can see its index.
+   // Whatever was in the middle is stale or already read, write over it next.
+   SDL_MemoryBarrierRelease();
+   buffer->write = SDL_AtomicSet(&buffer->middle, buffer->write | TRIPLEBUFFER_FRESH) & TRIPLEBUFFER_INDEX;
+}
+
+void * TripleBuffer_GetRead(TripleBuffer_T * buffer)
+{
+   if(SDL_AtomicGet(&buffer->middle) & TRIPLEBUFFER_FRESH)
+   {
+      buffer->read = SDL_AtomicSet(&buffer->middle, buffer->read) & TRIPLEBUFFER_INDEX;
+      SDL_MemoryBarrierAcquire();
+   }
+   return buffer->slots[buffer->read];
+}
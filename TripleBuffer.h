@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __TRIPLEBUFFER_H__
+#define __TRIPLEBUFFER_H__
+
+// Hands the newest of a stream of values from one writer thread to one
+// reader thread without locks. Each side owns one of the three slots, the
+// third is swapped in and out atomically. The writer never waits and the
+// reader always gets the last value published, skipping any in between.
+
+typedef struct TripleBuffer_S TripleBuffer_T;
+
+struct TripleBuffer_S
+{
+   void       * slots[3];
+   int          write;   // Slot index only the writer touches
+   int          read;    // Slot index only the reader touches
+   SDL_atomic_t middle;  // Slot index between them, plus TRIPLEBUFFER_FRESH
+};
+
+// The reader starts on slot2, so it should hold something valid or be
+// published over before the first TripleBuffer_GetRead
+void   TripleBuffer_Init(TripleBuffer_T * buffer, void * slot0, void * slot1, void * slot2);
+
+// Writer side, fill in the slot then publish it
+void * TripleBuffer_GetWrite(TripleBuffer_T * buffer);
+void   TripleBuffer_Publish(TripleBuffer_T * buffer);
+
+// Reader side, returns the same slot again if nothing new was published
+void * TripleBuffer_GetRead(TripleBuffer_T * buffer);
+
+#endif // __TRIPLEBUFFER_H__
@@ -0,0 +1,184 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDLInclude.h"
+
+#include "WorkerPool.h"
+
+// Keeps each worker's queue off the cache lines of its neighbours'
+#define WORKERPOOL_CACHE_LINE 64
+
+typedef struct WorkerPool_Worker_S WorkerPool_Worker_T;
+typedef struct WorkerPool_Shared_S WorkerPool_Shared_T;
+
+struct WorkerPool_Shared_S
+{
+   WorkerPool_TaskFunc_T func;
+   void                * context;
+   WorkerPool_Worker_T * workers;
+   int                   worker_count;
+};
+
+// The queue is a range of task numbers, head to tail
+struct WorkerPool_Worker_S
+{
+   WorkerPool_Shared_T * shared;
+   int                   index;
+   SDL_SpinLock          lock;
+   int                   head;  // Next task a thief takes
+   int                   tail;  // One past the next task the owner takes
+   WorkerPool_Stats_T    stats;
+   char                  pad[WORKERPOOL_CACHE_LINE];
+};
+
+static int WorkerPool_Work(void * data);
+static int WorkerPool_Pop(WorkerPool_Worker_T * worker, int * task);
+static int WorkerPool_Steal(WorkerPool_Worker_T * worker, int * task);
+
+
+void WorkerPool_Run(int worker_count, int task_count, 
+                    WorkerPool_TaskFunc_T func, void * context, 
+                    WorkerPool_Stats_T * stats)
+{
+   WorkerPool_Shared_T shared;
+   SDL_Thread ** threads;
+   int i;
+
+   if(worker_count < 1)
+   {
+      worker_count = 1;
+   }
+
+   shared.func         = func;
+   shared.context      = context;
+   shared.worker_count = worker_count;
+   shared.workers      = malloc(sizeof(WorkerPool_Worker_T) * worker_count);
+   for(i = 0; i < worker_count; i++)
+   {
+      shared.workers[i].shared = &shared;
+      shared.workers[i].index  = i;
+      shared.workers[i].lock   = 0;
+      shared.workers[i].head   = (int)(((long long)task_count *  i)      / worker_count);
+      shared.workers[i].tail   = (int)(((long long)task_count * (i + 1)) / worker_count);
+      shared.workers[i].stats.tasks  = 0;
+      shared.workers[i].stats.steals = 0;
+   }
+
+   threads = malloc(sizeof(SDL_Thread *) * worker_count);
+   for(i = 1; i < worker_count; i++)
+   {
+      threads[i] = SDL_CreateThread(WorkerPool_Work, "Worker", &shared.workers[i]);
+      if(threads[i] == NULL)
+      {
+         // The others steal its share
+         printf("Error: WorkerPool could not start a thread: %s\n", SDL_GetError());
+      }
+   }
+   WorkerPool_Work(&shared.workers[0]);
+   for(i = 1; i < worker_count; i++)
+   {
+      if(threads[i] != NULL)
+      {
+         SDL_WaitThread(threads[i], NULL);
+      }
+   }
+
+   if(stats != NULL)
+   {
+      for(i = 0; i < worker_count; i++)
+      {
+         stats[i] = shared.workers[i].stats;
+      }
+   }
+   free(threads);
+   free(shared.workers);
+}
+
+// No task ever adds more, so once every queue is empty the work is done
+static int WorkerPool_Work(void * data)
+{
+   WorkerPool_Worker_T * worker;
+   int task;
+
+   worker = data;
+   while(WorkerPool_Pop(worker, &task) || WorkerPool_Steal(worker, &task))
+   {
+      worker->shared->func(worker->shared->context, task, worker->index);
+      worker->stats.tasks ++;
+   }
+   return 0;
+}
+
+static int WorkerPool_Pop(WorkerPool_Worker_T * worker, int * task)
+{
+   int result;
+   SDL_AtomicLock(&worker->lock);
+   if(worker->head < worker->tail)
+   {
+      worker->tail --;
+      (*task) = worker->tail;
+      result = 1;
+   }
+   else
+   {
+      result = 0;
+   }
+   SDL_AtomicUnlock(&worker->lock);
+   return result;
+}
+
+// Runs the first stolen task and queues the rest on worker
+static int WorkerPool_Steal(WorkerPool_Worker_T * worker, int * task)
+{
+   WorkerPool_Shared_T * shared;
+   WorkerPool_Worker_T * victim;
+   int i, start, take;
+
+   shared = worker->shared;
+   take = 0;
+   start = 0;
+   for(i = 1; i < shared->worker_count && take == 0; i++)
+   {
+      victim = &shared->workers[(worker->index + i) % shared->worker_count];
+      SDL_AtomicLock(&victim->lock);
+      take = (victim->tail - victim->head + 1) / 2;
+      if(take > 0)
+      {
+         start = victim->head;
+         victim->head += take;
+      }
+      SDL_AtomicUnlock(&victim->lock);
+   }
+
+   if(take > 0)
+   {
+      SDL_AtomicLock(&worker->lock);
+      worker->head = start + 1;
+      worker->tail = start + take;
+      SDL_AtomicUnlock(&worker->lock);
+      worker->stats.steals ++;
+      (*task) = start;
+   }
+   return take > 0;
+}
+
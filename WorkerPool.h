@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2015 Ryan Hanson <hansonry@gmail.com>
+ *
+ *  This software is provided 'as-is', without any express or implied
+ *  warranty.  In no event will the authors be held liable for any damages
+ *  arising from the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software
+ *     in a product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *  3. This notice may not be removed or altered from any source distribution.
+ *
+ */
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+// Runs a fixed set of independent tasks across threads. Each worker starts
+// with an even share of the tasks in its own queue and works through it
+// from the back. A worker that runs dry steals half of what is left at
+// the front of another worker's queue, so uneven tasks still keep every
+// thread busy without a shared queue to fight over.
+
+typedef struct WorkerPool_Stats_S WorkerPool_Stats_T;
+
+typedef void (*WorkerPool_TaskFunc_T)(void * context, int task, int worker);
+
+struct WorkerPool_Stats_S
+{
+   int tasks;   // Tasks the worker ran
+   int steals;  // Times it took tasks from another worker
+};
+
+// Calls func once for every task from 0 to task_count - 1 and returns once
+// all have finished. The calling thread works as worker 0. stats is NULL
+// or has worker_count entries.
+void WorkerPool_Run(int worker_count, int task_count, 
+                    WorkerPool_TaskFunc_T func, void * context, 
+                    WorkerPool_Stats_T * stats);
+
+#endif // __WORKERPOOL_H__
+
@@ -1,5 +1,6 @@
 
 config_tool_settings = NewSettings()
+level_tool_settings = NewSettings()
 settings = NewSettings()
 
 
@@ -15,6 +16,7 @@ else
    sep = "/"
    settings.cc.flags:Add("-Wall");
    config_tool_settings.cc.flags:Add("-Wall");
+   level_tool_settings.cc.flags:Add("-Wall");
 end
 
 -- Build the config tool
@@ -31,6 +33,26 @@ AddDependency("GameConfigData.h",    "config_source.txt", config_tool_exe);
 AddDependency("GameConfigData.inl",  "config_source.txt", config_tool_exe);
 AddDependency("config_template.txt", "config_source.txt", config_tool_exe);
 
+-- The same run compiles the event schema, and prints each payload size
+AddJob("GameEvents.h",        "Generating Event Types",              config_tool_exe)
+AddJob("GameEvents.inl",      "Generating Event Registry",           config_tool_exe)
+AddDependency("GameEvents.h",        "event_source.txt", config_tool_exe);
+AddDependency("GameEvents.inl",      "event_source.txt", config_tool_exe);
+
+-- Build the level tool, it shares the level headers with the game
+level_tool_path      = "level_tool" .. sep
+level_tool_settings.cc.includes:Add(".")
+level_tool_source    = Collect(level_tool_path .. "*.c")
+level_tool_objects   = Compile(level_tool_settings, level_tool_source)
+level_tool_exe       = Link(level_tool_settings, level_tool_path .. "level_tool", level_tool_objects)
+
+-- Compile the bundled text maps
+for _, map in pairs({"test_map", "des_map"}) do
+   AddJob(map .. ".lvl", "Compiling Level " .. map, 
+          level_tool_exe .. " " .. map .. ".txt " .. map .. ".lvl")
+   AddDependency(map .. ".lvl", map .. ".txt", level_tool_exe)
+end
+
 
 
 -- Build the game
@@ -39,8 +61,37 @@ settings.link.libs:Add("SDL2_image")
 settings.link.libs:Add("SDL2_ttf")
 settings.link.libs:Add("SDL2_mixer")
 
-source = Collect("*.c")
+-- bam profiler=true builds in the frame profiler
+if ScriptArgs["profiler"] == "true" then
+   settings.cc.defines:Add("PROFILER_ENABLED")
+end
+
+-- bam eventstats=true builds in the event system counters
+if ScriptArgs["eventstats"] == "true" then
+   settings.cc.defines:Add("EVENTSYS_STATS")
+end
+
+-- Everything but main.c is shared with the batch simulator
+shared_source = {}
+for _, file in pairs(Collect("*.c")) do
+   if PathFilename(file) ~= "main.c" then
+      table.insert(shared_source, file)
+   end
+end
+shared_objects = Compile(settings, shared_source)
+
+objects = Compile(settings, "main.c")
+exe = Link(settings, "loadclone", objects, shared_objects)
 
-objects = Compile(settings, source)
-exe = Link(settings, "loadclone", objects)
+-- Build the batch simulator, it runs game sessions without the game
+settings.cc.includes:Add(".")
+batch_sim_path       = "batch_sim" .. sep
+batch_sim_source     = Collect(batch_sim_path .. "*.c")
+batch_sim_objects    = Compile(settings, batch_sim_source)
+batch_sim_exe        = Link(settings, batch_sim_path .. "batch_sim", batch_sim_objects, shared_objects)
 
+-- Build the level checker, it shares the movement rules with the game
+level_check_path     = "level_check" .. sep
+level_check_source   = Collect(level_check_path .. "*.c")
+level_check_objects  = Compile(settings, level_check_source)
+level_check_exe      = Link(settings, level_check_path .. "level_check", level_check_objects, shared_objects)
@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDLInclude.h"
+
+#include "GlobalData.h"
+
+#include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "LevelSet.h"
+#include "EventSys.h"
+#include "GameInput.h"
+#include "GameConfigData.h"
+#include "GameSettings.h"
+#include "InputLog.h"
+#include "FlowField.h"
+#include "ActorStore.h"
+#include "GameSession.h"
+#include "WorkerPool.h"
+
+// Plays many independent game sessions at once, spread over a worker pool,
+// and reports how many ticks per second they reached together.
+//
+// Usage: batch_sim [--sessions n] [--ticks n] [--threads n] [--seed n]
+//                  [--levelset file] [--replay file] [--guards n]
+//                  [--harmless] [--render-holes]
+//
+// Each session plays its own copy of the levels from the start of the
+// levelset for the given number of ticks, or until it completes the set.
+// Input comes from a bot that mashes keys at random, seeded per session,
+// or from a recording made with loadclone --record.
+//
+// --guards adds that many guards to every level a session starts, at
+// random open tiles, and reports what the guards cost per tick. The flow
+// field they share should cost the same whatever their number.
+//
+// --harmless lets the guards walk through the player. Otherwise they soon
+// catch it, and with no player to chase the flow field does no work. Try
+// it on a level made with level_tool --grid, which has room for them all.
+//
+// --render-holes plays no sessions. It renders the first level of the
+// levelset in software instead, with more and more of its dirt dug out,
+// and reports the time per frame. Holes are looked up per tile, so that
+// time should not grow with their number.
+
+#define BATCH_DEFAULT_TICKS       3600
+#define BATCH_SESSIONS_PER_THREAD 4
+
+// Tries at finding an open tile for each added guard
+#define BATCH_GUARD_TRIES 64
+
+// Frames timed for each hole count, and the largest frame rendered
+#define RENDER_BENCH_FRAMES 100
+#define RENDER_BENCH_MAX_W  2048
+#define RENDER_BENCH_MAX_H  2048
+
+// Shortest and longest time the bot holds a key, in ticks
+#define BOT_HOLD_MIN 4
+#define BOT_HOLD_MAX 40
+
+typedef struct BatchBot_S    BatchBot_T;
+typedef struct BatchResult_S BatchResult_T;
+typedef struct BatchSim_S    BatchSim_T;
+
+struct BatchBot_S
+{
+   Uint32 state;  // xorshift32, never 0
+   int    key;    // Player key held, e_gipk_last for none
+   int    hold;   // Ticks left before the next key
+};
+
+struct BatchResult_S
+{
+   long   ticks;
+   int    level_index;
+   int    complete;
+   Uint64 field_counts;
+   Uint64 steer_counts;
+   Uint64 actor_counts;
+   long   field_settled;
+};
+
+struct BatchSim_S
+{
+   LevelSet_T    * levelset;
+   long            ticks;
+   float           tick_seconds;
+   Uint32          seed;
+   const char    * replay_filename;
+   int             guards;   // Added to each level a session starts
+   int             harmless; // Guards can't catch the player
+   BatchResult_T * results;  // One per session
+};
+
+static Uint32 BatchBot_Next(BatchBot_T * bot);
+static void   BatchBot_Init(BatchBot_T * bot, Uint32 seed);
+static void   BatchBot_Update(BatchBot_T * bot, GameSession_T * session);
+static void   AddGuards(GameSession_T * session, BatchBot_T * bot, int count);
+static void   RunSession(void * context, int task, int worker);
+static void   RenderHoles(LevelSet_T * levelset, Uint32 seed);
+
+
+int main(int args, char * argc[])
+{
+   BatchSim_T batch;
+   LevelSet_T levelset;
+   GameSettings_T * game_settings;
+   WorkerPool_Stats_T * stats;
+   InputLog_T log;
+   const char * levelset_filename;
+   int sessions, threads, render_holes, i;
+   int tick_rate, completed, furthest;
+   long total_ticks, field_settled;
+   Uint64 field_counts, steer_counts, actor_counts;
+   double counts_per_us, field_us, steer_us, actor_us;
+   size_t level_count;
+   Uint64 counter_start;
+   double elapsed;
+
+   SDL_Init(SDL_INIT_TIMER);
+   GameSettings_Load("config.txt");
+   game_settings = GameSettings_Get();
+
+   threads           = SDL_GetCPUCount();
+   sessions          = 0;
+   levelset_filename = game_settings->config.game_levelset;
+   tick_rate         = game_settings->config.game_tick_rate;
+   batch.ticks           = BATCH_DEFAULT_TICKS;
+   batch.seed            = 1;
+   batch.replay_filename = NULL;
+   batch.guards          = 0;
+   batch.harmless        = 0;
+   render_holes          = 0;
+   for(i = 1; i < args; i++)
+   {
+      if(strcmp(argc[i], "--sessions") == 0 && i + 1 < args)
+      {
+         i ++;
+         sessions = atoi(argc[i]);
+      }
+      else if(strcmp(argc[i], "--ticks") == 0 && i + 1 < args)
+      {
+         i ++;
+         batch.ticks = atol(argc[i]);
+      }
+      else if(strcmp(argc[i], "--threads") == 0 && i + 1 < args)
+      {
+         i ++;
+         threads = atoi(argc[i]);
+      }
+      else if(strcmp(argc[i], "--seed") == 0 && i + 1 < args)
+      {
+         i ++;
+         batch.seed = (Uint32)strtoul(argc[i], NULL, 10);
+      }
+      else if(strcmp(argc[i], "--levelset") == 0 && i + 1 < args)
+      {
+         i ++;
+         levelset_filename = argc[i];
+      }
+      else if(strcmp(argc[i], "--replay") == 0 && i + 1 < args)
+      {
+         i ++;
+         batch.replay_filename = argc[i];
+      }
+      else if(strcmp(argc[i], "--guards") == 0 && i + 1 < args)
+      {
+         i ++;
+         batch.guards = atoi(argc[i]);
+      }
+      else if(strcmp(argc[i], "--harmless") == 0)
+      {
+         batch.harmless = 1;
+      }
+      else if(strcmp(argc[i], "--render-holes") == 0)
+      {
+         render_holes = 1;
+      }
+      else
+      {
+         printf("Error: Unknown option \"%s\"\n", argc[i]);
+         printf("Usage: %s [--sessions n] [--ticks n] [--threads n] [--seed n]\n"
+                "          [--levelset file] [--replay file] [--guards n]\n"
+                "          [--harmless] [--render-holes]\n", argc[0]);
+         GameSettings_Cleanup();
+         SDL_Quit();
+         return 1;
+      }
+   }
+   if(threads < 1)
+   {
+      threads = 1;
+   }
+   if(sessions < 1)
+   {
+      // Enough that stealing can even out sessions that end early
+      sessions = threads * BATCH_SESSIONS_PER_THREAD;
+   }
+
+   if(batch.replay_filename != NULL)
+   {
+      // Every session reads the file itself, check it once up front
+      if(InputLog_OpenReplay(&log, batch.replay_filename) == 0)
+      {
+         printf("Error: Could not open replay \"%s\"\n", batch.replay_filename);
+         GameSettings_Cleanup();
+         SDL_Quit();
+         return 1;
+      }
+      if(log.tick_rate > 0)
+      {
+         tick_rate = log.tick_rate;
+      }
+      InputLog_Close(&log, 0);
+   }
+   if(tick_rate <= 0)
+   {
+      tick_rate = 60;
+   }
+   batch.tick_seconds = 1.0f / tick_rate;
+
+   // Sessions play copies, so the whole set stays loaded and is only
+   // read from once the run starts
+   LevelSet_Init(&levelset, ~(size_t)0);
+   LevelSet_Load(&levelset, levelset_filename);
+   level_count = LevelSet_GetCount(&levelset);
+   if(level_count == 0)
+   {
+      printf("Error: No levels in \"%s\"\n", levelset_filename);
+      LevelSet_Destroy(&levelset);
+      GameSettings_Cleanup();
+      SDL_Quit();
+      return 1;
+   }
+   for(i = 0; i < (int)level_count; i++)
+   {
+      LevelSet_GetLevel(&levelset, i);
+   }
+   batch.levelset = &levelset;
+
+   if(render_holes == 1)
+   {
+      RenderHoles(&levelset, batch.seed);
+      LevelSet_Destroy(&levelset);
+      GameSettings_Cleanup();
+      SDL_Quit();
+      return 0;
+   }
+
+   batch.results = malloc(sizeof(BatchResult_T) * sessions);
+   stats = malloc(sizeof(WorkerPool_Stats_T) * threads);
+
+   printf("Batch: %d sessions of up to %ld ticks at %d ticks per second on %d threads\n", 
+          sessions, batch.ticks, tick_rate, threads);
+   counter_start = SDL_GetPerformanceCounter();
+   WorkerPool_Run(threads, sessions, RunSession, &batch, stats);
+   elapsed = (double)(SDL_GetPerformanceCounter() - counter_start) / 
+             SDL_GetPerformanceFrequency();
+
+   total_ticks   = 0;
+   completed     = 0;
+   furthest      = 0;
+   field_counts  = 0;
+   steer_counts  = 0;
+   actor_counts  = 0;
+   field_settled = 0;
+   for(i = 0; i < sessions; i++)
+   {
+      total_ticks   += batch.results[i].ticks;
+      completed     += batch.results[i].complete;
+      field_counts  += batch.results[i].field_counts;
+      steer_counts  += batch.results[i].steer_counts;
+      actor_counts  += batch.results[i].actor_counts;
+      field_settled += batch.results[i].field_settled;
+      if(batch.results[i].level_index > furthest)
+      {
+         furthest = batch.results[i].level_index;
+      }
+   }
+
+   printf("Batch: %ld ticks (%.1f game seconds) in %.3f seconds\n", 
+          total_ticks, total_ticks * batch.tick_seconds, elapsed);
+   printf("Batch: %.0f ticks per second, %.0f per thread\n", 
+          (elapsed > 0) ? total_ticks / elapsed : 0.0,
+          (elapsed > 0) ? total_ticks / elapsed / threads : 0.0);
+   printf("Batch: %d of %d sessions completed the levelset, furthest level %d of %d\n",
+          completed, sessions, furthest + 1, (int)level_count);
+   if(batch.guards > 0 && total_ticks > 0)
+   {
+      counts_per_us = SDL_GetPerformanceFrequency() / 1000000.0;
+      field_us = field_counts / counts_per_us / total_ticks;
+      steer_us = steer_counts / counts_per_us / total_ticks;
+      actor_us = actor_counts / counts_per_us / total_ticks;
+      printf("Guards: %d per level%s, flow field %.2f us and %.1f tiles settled per tick, "
+             "steering %.2f us and moving actors %.2f us per tick\n",
+             batch.guards, (batch.harmless == 1) ? " (harmless)" : "", 
+             field_us, (double)field_settled / total_ticks, steer_us, actor_us);
+      // Moving actors includes the player, which is next to nothing
+      printf("Guards: %.2f us per tick in all, %.3f us per guard\n",
+             field_us + steer_us + actor_us, 
+             (field_us + steer_us + actor_us) / batch.guards);
+   }
+   for(i = 0; i < threads; i++)
+   {
+      printf("Worker %2d: %d sessions, %d steals\n", i, stats[i].tasks, stats[i].steals);
+   }
+
+   free(stats);
+   free(batch.results);
+   LevelSet_Destroy(&levelset);
+   GameSettings_Cleanup();
+   SDL_Quit();
+   return 0;
+}
+
+// One session from start to finish, on whichever worker picked it up
+static void RunSession(void * context, int task, int worker)
+{
+   BatchSim_T * batch;
+   BatchResult_T * result;
+   GameSession_T session;
+   BatchBot_T bot;
+   InputLog_T log;
+   int replay, player, key, state, generation;
+   long tick;
+
+   batch  = context;
+   result = &batch->results[task];
+
+   GameSession_Init(&session, batch->levelset, 0, 1);
+   session.guard_data.harmless = batch->harmless;
+   BatchBot_Init(&bot, batch->seed + (Uint32)task);
+   replay = 0;
+   if(batch->replay_filename != NULL)
+   {
+      replay = InputLog_OpenReplay(&log, batch->replay_filename);
+   }
+
+   generation = 0;
+   tick = 0;
+   while(tick < batch->ticks && GameSession_IsLevelSetComplete(&session) == 0)
+   {
+      if(replay == 1)
+      {
+         while(InputLog_Read(&log, (unsigned long)tick, &player, &key, &state))
+         {
+            if(player < 0)
+            {
+               if(key < e_gigk_last)
+               {
+                  GameSession_SetGameKey(&session, key, state);
+               }
+            }
+            else if(key < e_gipk_last)
+            {
+               GameSession_SetPlayerKey(&session, player, key, state);
+            }
+         }
+      }
+      else
+      {
+         BatchBot_Update(&bot, &session);
+      }
+      GameSession_Update(&session, batch->tick_seconds);
+      if(batch->guards > 0 && session.level_data.level->generation != generation)
+      {
+         // A level started and brought only its own guards
+         generation = session.level_data.level->generation;
+         AddGuards(&session, &bot, batch->guards);
+      }
+      tick ++;
+   }
+
+   result->ticks       = tick;
+   result->level_index = session.level_data.level_index;
+   result->complete    = GameSession_IsLevelSetComplete(&session);
+   result->field_counts  = session.guard_data.field_counts;
+   result->steer_counts  = session.guard_data.steer_counts;
+   result->actor_counts  = session.actor_counts;
+   result->field_settled = session.guard_data.field_settled;
+
+   if(replay == 1)
+   {
+      InputLog_Close(&log, (unsigned long)tick);
+   }
+   GameSession_Destroy(&session);
+}
+
+static Uint32 BatchBot_Next(BatchBot_T * bot)
+{
+   bot->state ^= bot->state << 13;
+   bot->state ^= bot->state >> 17;
+   bot->state ^= bot->state << 5;
+   return bot->state;
+}
+
+static void BatchBot_Init(BatchBot_T * bot, Uint32 seed)
+{
+   bot->state = (seed * 2654435761u) | 1;
+   bot->key   = e_gipk_last;
+   bot->hold  = 0;
+}
+
+// Holds a random player key, or none, for a random number of ticks
+static void BatchBot_Update(BatchBot_T * bot, GameSession_T * session)
+{
+   if(bot->hold <= 0)
+   {
+      if(bot->key != e_gipk_last)
+      {
+         GameSession_SetPlayerKey(session, 0, bot->key, 0);
+      }
+      bot->key  = BatchBot_Next(bot) % (e_gipk_last + 1);
+      bot->hold = BOT_HOLD_MIN + BatchBot_Next(bot) % (BOT_HOLD_MAX - BOT_HOLD_MIN + 1);
+      if(bot->key != e_gipk_last)
+      {
+         GameSession_SetPlayerKey(session, 0, bot->key, 1);
+      }
+   }
+   bot->hold --;
+}
+
+// Guards go on tiles that aren't solid, they fall from there if they have to
+static void AddGuards(GameSession_T * session, BatchBot_T * bot, int count)
+{
+   Level_T * level;
+   LevelTile_T tile;
+   int i, try, x, y;
+
+   level = session->level_data.level;
+   for(i = 0; i < count; i++)
+   {
+      for(try = 0; try < BATCH_GUARD_TRIES; try++)
+      {
+         x = (int)(BatchBot_Next(bot) % (Uint32)level->tmap.width);
+         y = (int)(BatchBot_Next(bot) % (Uint32)level->tmap.height);
+         Level_QueryTile(level, x, y, &tile);
+         if(tile.terrain_type != TMAP_TILE_DIRT && tile.terrain_type != TMAP_TILE_DOOR)
+         {
+            GameSession_AddGuard(session, x, y);
+            break;
+         }
+      }
+   }
+}
+
+// Digs holes in random dirt tiles of the first level, a few at first then
+// four times as many each round, and times rendering every tile of it
+static void RenderHoles(LevelSet_T * levelset, Uint32 seed)
+{
+   SDL_Surface * surface;
+   SDL_Renderer * rend;
+   SDL_Texture * t_terrain;
+   SDLTools_Batch_T batch;
+   LevelSnapshot_T snapshot;
+   LevelRenderStats_T render_stats;
+   Level_T level;
+   LevelTile_T tile;
+   BatchBot_T bot;
+   ArrayList_T dirt_list;
+   Pos2D_T * dirt, * pos, swap;
+   SDL_Rect view;
+   size_t dirt_count, holes, target, i, pick;
+   int frame, x, y;
+   Uint64 counter_start;
+   double elapsed;
+
+   Level_Init(&level);
+   Level_Copy(&level, LevelSet_GetLevel(levelset, 0));
+   view.x = 0;
+   view.y = 0;
+   view.w = level.tmap.width  * TILE_WIDTH;
+   view.h = level.tmap.height * TILE_HEIGHT;
+   if(view.w > RENDER_BENCH_MAX_W) view.w = RENDER_BENCH_MAX_W;
+   if(view.h > RENDER_BENCH_MAX_H) view.h = RENDER_BENCH_MAX_H;
+
+   surface   = SDL_CreateRGBSurface(0, view.w, view.h, 32, 0, 0, 0, 0);
+   rend      = NULL;
+   t_terrain = NULL;
+   if(surface != NULL)
+   {
+      rend = SDL_CreateSoftwareRenderer(surface);
+   }
+   if(rend != NULL)
+   {
+      t_terrain = SDLTools_LoadTexture(rend, "terrain.png");
+   }
+
+   if(t_terrain == NULL)
+   {
+      printf("Error: Could not set up a software renderer: %s\n", SDL_GetError());
+   }
+   else
+   {
+      // Only the dirt that is drawn, in a random order
+      ArrayList_Init(&dirt_list, sizeof(Pos2D_T), 0);
+      for(y = 0; y < view.h / TILE_HEIGHT; y++)
+      {
+         for(x = 0; x < view.w / TILE_WIDTH; x++)
+         {
+            Level_QueryTile(&level, x, y, &tile);
+            if(tile.terrain_type == TMAP_TILE_DIRT)
+            {
+               pos = ArrayList_Add(&dirt_list, NULL);
+               pos->x = x;
+               pos->y = y;
+            }
+         }
+      }
+      dirt = ArrayList_Get(&dirt_list, &dirt_count, NULL);
+      BatchBot_Init(&bot, seed);
+      for(i = dirt_count; i > 1; i--)
+      {
+         pick = BatchBot_Next(&bot) % i;
+         swap          = dirt[i - 1];
+         dirt[i - 1]   = dirt[pick];
+         dirt[pick]    = swap;
+      }
+
+      printf("Render: %dx%d level, %lu dirt tiles in a %dx%d view\n", 
+             level.tmap.width, level.tmap.height, (unsigned long)dirt_count, view.w, view.h);
+      SDLTools_Batch_Init(&batch, rend);
+      LevelSnapshot_Init(&snapshot);
+      holes  = 0;
+      target = 0;
+      while(1)
+      {
+         while(holes < target)
+         {
+            Level_AddDigSpot(&level, dirt[holes].x, dirt[holes].y);
+            holes ++;
+         }
+         Level_TakeSnapshot(&level, &snapshot);
+
+         counter_start = SDL_GetPerformanceCounter();
+         for(frame = 0; frame < RENDER_BENCH_FRAMES; frame++)
+         {
+            SDL_RenderClear(rend);
+            SDLTools_Batch_Begin(&batch);
+            Level_Render(&snapshot, &batch, NULL, &view, 0, 0, t_terrain, &render_stats);
+            SDLTools_Batch_Flush(&batch);
+         }
+         elapsed = (double)(SDL_GetPerformanceCounter() - counter_start) / 
+                   SDL_GetPerformanceFrequency();
+         printf("Render: %6lu holes, %9.1f us per frame, %d sprites in %d draw calls\n",
+                (unsigned long)holes, elapsed * 1000000.0 / RENDER_BENCH_FRAMES,
+                batch.sprite_count, batch.draw_calls);
+
+         if(target >= dirt_count)
+         {
+            break;
+         }
+         target = (target == 0) ? 1 : target * 4;
+         if(target > dirt_count)
+         {
+            target = dirt_count;
+         }
+      }
+      LevelSnapshot_Destroy(&snapshot);
+      SDLTools_Batch_Destroy(&batch);
+      ArrayList_Destroy(&dirt_list);
+   }
+
+   if(t_terrain != NULL)
+   {
+      SDL_DestroyTexture(t_terrain);
+   }
+   if(rend != NULL)
+   {
+      SDL_DestroyRenderer(rend);
+   }
+   if(surface != NULL)
+   {
+      SDL_FreeSurface(surface);
+   }
+   Level_Destroy(&level);
+}
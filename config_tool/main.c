@@ -6,6 +6,7 @@
 // Structure Headder File
 // Example Config File
 // Include file that populates a structure
+// Event ids, payloads and senders, and the registry EventSys dispatches on
 
 #define CMD_NONE    0
 #define CMD_INT     1
@@ -14,6 +15,9 @@
 #define CMD_BOOLEAN 4
 #define CMD_COMMENT 5
 #define CMD_EMPTY   6
+#define CMD_EVENT   7
+
+#define EVENT_NAME_SIZE 64
 
 static char * GetVariableString(const char * str)
 {
@@ -366,6 +370,370 @@ static void CreateConfigTemplate(GridReader_T * reader,
    fprintf(file, "\n");
    fclose(file);
 }
+static int GetEventCmd(const char * cmd)
+{
+   int cmd_type;
+   if(cmd == NULL)
+   {
+      cmd_type = CMD_NONE;
+   }
+   else
+   {
+      switch(cmd[0])
+      {
+         case 't': cmd_type = CMD_EVENT; break;
+         case 'q': cmd_type = CMD_EVENT; break;
+         case 'i': cmd_type = CMD_INT;   break;
+         case 'f': cmd_type = CMD_FLOAT; break;
+         case 'e': cmd_type = CMD_EMPTY; break;
+         default:  cmd_type = CMD_NONE;  break;
+      }
+   }
+   return cmd_type;
+}
+
+// Events any thread may send are q rows, with a capacity before the
+// description. Others get 0.
+static int GetEventCapacity(GridReader_T * reader, int event_row)
+{
+   const char * cmd, * capacity;
+   int result;
+
+   result   = 0;
+   cmd      = GridReader_GetCell(reader, 0, event_row);
+   capacity = GridReader_GetCell(reader, 2, event_row);
+   if(cmd != NULL && cmd[0] == 'q' && capacity != NULL)
+   {
+      result = atoi(capacity);
+   }
+   return result;
+}
+
+static const char * GetEventDescription(GridReader_T * reader, int event_row)
+{
+   const char * cmd;
+   int x;
+
+   cmd = GridReader_GetCell(reader, 0, event_row);
+   if(cmd != NULL && cmd[0] == 'q')
+   {
+      x = 3;
+   }
+   else
+   {
+      x = 2;
+   }
+   return GridReader_GetCell(reader, x, event_row);
+}
+
+// EVENT_ followed by the event name in capitals
+static void GetEventId(const char * name, char * id)
+{
+   size_t i;
+   strcpy(id, "EVENT_");
+   for(i = 0; name[i] != '\0' && i + 7 < EVENT_NAME_SIZE; i++)
+   {
+      if(name[i] >= 'a' && name[i] <= 'z')
+      {
+         id[i + 6] = (char)(name[i] - 'a' + 'A');
+      }
+      else
+      {
+         id[i + 6] = name[i];
+      }
+   }
+   id[i + 6] = '\0';
+}
+
+// Payload size on the machine running the tool. Members are all int or
+// float, so there is never any padding between them.
+static size_t GetEventSize(GridReader_T * reader, int event_row)
+{
+   int height, y, cmd_type;
+   size_t size;
+
+   size = 0;
+   GridReader_GetSize(reader, NULL, &height);
+   for(y = event_row + 1; y < height; y++)
+   {
+      cmd_type = GetEventCmd(GridReader_GetCell(reader, 0, y));
+      if(cmd_type == CMD_EVENT)
+      {
+         break;
+      }
+      else if(cmd_type == CMD_INT)
+      {
+         size += sizeof(int);
+      }
+      else if(cmd_type == CMD_FLOAT)
+      {
+         size += sizeof(float);
+      }
+   }
+   return size;
+}
+
+// Every member needs an event above it and every event needs a member,
+// as C has no empty structs
+static int CheckEvents(GridReader_T * reader, const char * filename)
+{
+   int height, y, cmd_type, event_row, valid;
+   const char * name;
+
+   valid     = 1;
+   event_row = -1;
+   GridReader_GetSize(reader, NULL, &height);
+   for(y = 0; y < height; y++)
+   {
+      cmd_type = GetEventCmd(GridReader_GetCell(reader, 0, y));
+      name     = GridReader_GetCell(reader, 1, y);
+      if((cmd_type == CMD_EVENT || cmd_type == CMD_INT || cmd_type == CMD_FLOAT) && 
+         name == NULL)
+      {
+         printf("%s: line %d has no name\n", filename, y + 1);
+         valid = 0;
+      }
+      else if(cmd_type == CMD_EVENT)
+      {
+         if(GetEventSize(reader, y) == 0)
+         {
+            printf("%s: event %s has no members\n", filename, name);
+            valid = 0;
+         }
+         if(GridReader_GetCell(reader, 0, y)[0] == 'q' && GetEventCapacity(reader, y) <= 0)
+         {
+            printf("%s: event %s needs a capacity\n", filename, name);
+            valid = 0;
+         }
+         event_row = y;
+      }
+      else if((cmd_type == CMD_INT || cmd_type == CMD_FLOAT) && event_row < 0)
+      {
+         printf("%s: member %s comes before any event\n", filename, name);
+         valid = 0;
+      }
+   }
+   return valid;
+}
+
+static void CreateEventHeader(GridReader_T * reader,
+                              const char * filename, 
+                              const char * prefix,
+                              const char * ifdef_block_name)
+{
+   FILE * file;
+
+   int height;
+   int y;
+   const char * name, * description;
+   char id[EVENT_NAME_SIZE];
+   int cmd_type;
+   int in_event;
+
+   file = fopen(filename, "w");
+   fprintf(file, "// This code is AUTO-GENERATED!!!\n");
+   fprintf(file, "// Do not manualy edit!\n");
+   fprintf(file, "#ifndef %s\n", ifdef_block_name);
+   fprintf(file, "#define %s\n", ifdef_block_name);
+   fprintf(file, "\n");
+   fprintf(file, "typedef enum %s_Type_E %s_Type_T;\n", prefix, prefix);
+   fprintf(file, "enum %s_Type_E\n", prefix);
+   fprintf(file, "{\n");
+
+   GridReader_GetSize(reader, NULL, &height);
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         GetEventId(name, id);
+         fprintf(file, "   %s,\n", id);
+      }
+   }
+   fprintf(file, "   EVENT_LAST\n");
+   fprintf(file, "};\n");
+   fprintf(file, "\n");
+
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         fprintf(file, "typedef struct Event_%s_S Event_%s_T;\n", name, name);
+      }
+   }
+   fprintf(file, "\n");
+
+   in_event = 0;
+   for(y = 0; y < height; y++)
+   {
+      cmd_type    = GetEventCmd(GridReader_GetCell(reader, 0, y));
+      name        = GridReader_GetCell(reader, 1, y);
+      description = GridReader_GetCell(reader, 2, y);
+      if(cmd_type == CMD_EVENT)
+      {
+         if(in_event == 1)
+         {
+            fprintf(file, "};\n\n");
+         }
+         description = GetEventDescription(reader, y);
+         if(description != NULL)
+         {
+            fprintf(file, "/* %s */\n", description);
+         }
+         if(GetEventCapacity(reader, y) > 0)
+         {
+            fprintf(file, "/* Any thread may send, %d at most wait unread */\n", 
+                    GetEventCapacity(reader, y));
+         }
+         fprintf(file, "struct Event_%s_S /* %d bytes */\n", 
+                 name, (int)GetEventSize(reader, y));
+         fprintf(file, "{\n");
+         in_event = 1;
+      }
+      else if(cmd_type == CMD_INT || cmd_type == CMD_FLOAT)
+      {
+         fprintf(file, "   %s %s;", (cmd_type == CMD_INT) ? "int  " : "float", name);
+         if(description != NULL)
+         {
+            fprintf(file, " /* %s */", description);
+         }
+         fprintf(file, "\n");
+      }
+   }
+   if(in_event == 1)
+   {
+      fprintf(file, "};\n\n");
+   }
+
+   fprintf(file, "// Indexed by event id, for EventSys_Init\n");
+   fprintf(file, "extern const ESTypeInfo_T %s_Registry[EVENT_LAST];\n", prefix);
+   fprintf(file, "\n");
+   fprintf(file, "// Writes the event once, for every inbox of its type to read. Senders\n");
+   fprintf(file, "// of types any thread may send return 0 when the event was dropped.\n");
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         fprintf(file, "%s %s_Send%s(EventSys_T * event_sys, const Event_%s_T * event);\n", 
+                 (GetEventCapacity(reader, y) > 0) ? "int " : "void", prefix, name, name);
+      }
+   }
+   fprintf(file, "\n");
+   fprintf(file, "#endif // %s\n", ifdef_block_name);
+   fprintf(file, "\n");
+   fclose(file);
+}
+
+static void CreateEventRegistry(GridReader_T * reader,
+                                const char * filename, 
+                                const char * prefix)
+{
+   FILE * file;
+
+   int height;
+   int y;
+   const char * name;
+   char id[EVENT_NAME_SIZE];
+
+   file = fopen(filename, "w");
+   fprintf(file, "// This code is AUTO-GENERATED!!!\n");
+   fprintf(file, "// Do not manualy edit!\n");
+   fprintf(file, "\n");
+
+   // The sizes in the header were worked out here, check the compiler
+   // building the game agrees with them
+   GridReader_GetSize(reader, NULL, &height);
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         fprintf(file, "typedef char %s_SizeCheck_%s[(sizeof(Event_%s_T) == %d) ? 1 : -1];\n", 
+                 prefix, name, name, (int)GetEventSize(reader, y));
+      }
+   }
+   fprintf(file, "\n");
+
+   fprintf(file, "const ESTypeInfo_T %s_Registry[EVENT_LAST] = \n", prefix);
+   fprintf(file, "{\n");
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         fprintf(file, "   { \"%s\", sizeof(Event_%s_T), %d },\n", 
+                 name, name, GetEventCapacity(reader, y));
+      }
+   }
+   fprintf(file, "};\n");
+   fprintf(file, "\n");
+
+   for(y = 0; y < height; y++)
+   {
+      name = GridReader_GetCell(reader, 1, y);
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT && 
+         GetEventCapacity(reader, y) > 0)
+      {
+         GetEventId(name, id);
+         fprintf(file, "int %s_Send%s(EventSys_T * event_sys, const Event_%s_T * event)\n", 
+                 prefix, name, name);
+         fprintf(file, "{\n");
+         fprintf(file, "   Event_%s_T * slot;\n", name);
+         fprintf(file, "   int ticket;\n");
+         fprintf(file, "\n");
+         fprintf(file, "   slot = EventSys_Reserve(event_sys, %s, &ticket);\n", id);
+         fprintf(file, "   if(slot != NULL)\n");
+         fprintf(file, "   {\n");
+         fprintf(file, "      *slot = *event;\n");
+         fprintf(file, "      EventSys_Commit(event_sys, %s, ticket);\n", id);
+         fprintf(file, "   }\n");
+         fprintf(file, "   return slot != NULL;\n");
+         fprintf(file, "}\n");
+         fprintf(file, "\n");
+      }
+      else if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         GetEventId(name, id);
+         fprintf(file, "void %s_Send%s(EventSys_T * event_sys, const Event_%s_T * event)\n", 
+                 prefix, name, name);
+         fprintf(file, "{\n");
+         fprintf(file, "   Event_%s_T * slot;\n", name);
+         fprintf(file, "\n");
+         fprintf(file, "   slot = EventSys_Push(event_sys, %s);\n", id);
+         fprintf(file, "   if(slot != NULL)\n");
+         fprintf(file, "   {\n");
+         fprintf(file, "      *slot = *event;\n");
+         fprintf(file, "   }\n");
+         fprintf(file, "}\n");
+         fprintf(file, "\n");
+      }
+   }
+   fclose(file);
+}
+
+// The payload sizes, so they show up in the build output
+static void PrintEventSizes(GridReader_T * reader)
+{
+   int height, y;
+
+   GridReader_GetSize(reader, NULL, &height);
+   for(y = 0; y < height; y++)
+   {
+      if(GetEventCmd(GridReader_GetCell(reader, 0, y)) == CMD_EVENT)
+      {
+         printf("Event %-20s %3d bytes", 
+                GridReader_GetCell(reader, 1, y), (int)GetEventSize(reader, y));
+         if(GetEventCapacity(reader, y) > 0)
+         {
+            printf(", any thread, %d at most", GetEventCapacity(reader, y));
+         }
+         printf("\n");
+      }
+   }
+}
+
 int main(int argc, char * args[])
 {
    const char * source_filename;
@@ -376,6 +744,12 @@ int main(int argc, char * args[])
    const char * struct_name;
    const char * struct_variable;
    const char * ifdef_block_name;
+   const char * event_source_filename;
+   const char * event_header_filename;
+   const char * event_registry_filename;
+   const char * event_prefix;
+   const char * event_ifdef_block_name;
+   int result;
 
    GridReader_T reader;
 
@@ -388,6 +762,12 @@ int main(int argc, char * args[])
    struct_name                = "GameConfigData";
    ifdef_block_name           = "__GAMECONFIGDATA_H__";
    struct_variable            = "config";
+   event_source_filename      = "event_source.txt";
+   event_header_filename      = "GameEvents.h";
+   event_registry_filename    = "GameEvents.inl";
+   event_prefix               = "GameEvents";
+   event_ifdef_block_name     = "__GAMEEVENTS_H__";
+   result                     = 0;
 
    GridReader_Init(&reader, source_filename);
 
@@ -407,8 +787,28 @@ int main(int argc, char * args[])
 
 
 
+   GridReader_Destroy(&reader);
+
+   GridReader_Init(&reader, event_source_filename);
+   if(CheckEvents(&reader, event_source_filename) == 1)
+   {
+      CreateEventHeader(&reader,
+                        event_header_filename,
+                        event_prefix,
+                        event_ifdef_block_name);
+
+      CreateEventRegistry(&reader,
+                          event_registry_filename,
+                          event_prefix);
+
+      PrintEventSizes(&reader);
+   }
+   else
+   {
+      result = 1;
+   }
    GridReader_Destroy(&reader);
    // printf("End\n"); // For testing only
-   return 0;
+   return result;
 }
 
@@ -0,0 +1,415 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDLInclude.h"
+
+#include "GlobalData.h"
+
+#include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "LevelSet.h"
+#include "Movement.h"
+#include "WorkerPool.h"
+
+// Proves every level in a levelset can be won: that the player can get
+// from the start to every piece of gold and to a door, going by the same
+// movement rules the game uses.
+//
+// Usage: level_check [--threads n] [--no-dig] [--memory] [levelset ...]
+//
+// Digging is allowed where a level needs it unless --no-dig is given. A
+// dug hole is taken to stay open for as long as the player needs it. Gold
+// that no door can be reached from afterwards is only warned about, since
+// it may still be picked up last on the way to a door below it.
+// Exits with 1 if any level fails, so it can run on every level commit.
+//
+// --memory also prints how much each level's terrain takes, against the
+// one int per tile it used to take. For a big sparse level to try it on:
+//
+//    level_tool --sparse sparse.lvl
+//    echo sparse.lvl > sparse_levelset.txt
+//    level_check --memory sparse_levelset.txt
+
+#define LEVELSET_DEFAULT "main_levelset.txt"
+
+// Nodes are tiles, twice over: standing there, or in a hole dug there
+#define NODE_HOLE 1
+#define NODE(check, x, y, hole) ((((x) + ((y) * (check)->width)) << 1) | (hole))
+
+typedef struct LevelCheck_S       LevelCheck_T;
+typedef struct LevelCheckTask_S   LevelCheckTask_T;
+typedef struct LevelCheckResult_S LevelCheckResult_T;
+typedef struct LevelCheckBatch_S  LevelCheckBatch_T;
+
+// One breadth first search over a level
+struct LevelCheck_S
+{
+   Level_T       * level;
+   int             width;
+   int             height;
+   int             dig;
+   unsigned char * seen;   // Per node
+   int           * queue;
+};
+
+struct LevelCheckTask_S
+{
+   LevelSet_T * levelset;
+   size_t       index;
+};
+
+struct LevelCheckResult_S
+{
+   int         gold_total;
+   int         needs_dig;     // Only winnable by digging
+   int         door_count;
+   int         door_reached;
+   ArrayList_T unreached;     // Pos2D_T of gold that can't be reached
+   ArrayList_T dead_ends;     // Pos2D_T of gold no door can be reached from
+};
+
+struct LevelCheckBatch_S
+{
+   LevelCheckTask_T   * tasks;
+   LevelCheckResult_T * results;
+   int                  allow_dig;
+};
+
+static void LevelCheck_Init(LevelCheck_T * check, Level_T * level, int dig);
+static void LevelCheck_Destroy(LevelCheck_T * check);
+static void LevelCheck_Search(LevelCheck_T * check, int x, int y);
+static void LevelCheck_Visit(LevelCheck_T * check, int * tail, int x, int y, int hole);
+static int  LevelCheck_Reached(LevelCheck_T * check, int x, int y);
+static int  LevelCheck_DoorReached(LevelCheck_T * check);
+static int  LevelCheck_Run(LevelCheckResult_T * result, Level_T * level, int dig);
+static void CheckLevel(void * context, int task, int worker);
+static void PrintPositions(const char * label, ArrayList_T * list);
+
+
+int main(int args, char * argc[])
+{
+   LevelCheckBatch_T batch;
+   LevelSet_T * levelsets;
+   LevelSetEntry_T * entry;
+   LevelCheckResult_T * result;
+   const char ** levelset_filenames;
+   int levelset_count, threads, task_count, failed, memory, i;
+   size_t j, count;
+   Uint64 counter_start;
+   double elapsed;
+
+   SDL_Init(SDL_INIT_TIMER);
+
+   threads            = SDL_GetCPUCount();
+   batch.allow_dig    = 1;
+   memory             = 0;
+   levelset_filenames = malloc(sizeof(const char *) * args);
+   levelset_count     = 0;
+   for(i = 1; i < args; i++)
+   {
+      if(strcmp(argc[i], "--threads") == 0 && i + 1 < args)
+      {
+         i ++;
+         threads = atoi(argc[i]);
+      }
+      else if(strcmp(argc[i], "--no-dig") == 0)
+      {
+         batch.allow_dig = 0;
+      }
+      else if(strcmp(argc[i], "--memory") == 0)
+      {
+         memory = 1;
+      }
+      else if(strncmp(argc[i], "--", 2) == 0)
+      {
+         printf("Error: Unknown option \"%s\"\n", argc[i]);
+         printf("Usage: %s [--threads n] [--no-dig] [--memory] [levelset ...]\n", argc[0]);
+         free(levelset_filenames);
+         SDL_Quit();
+         return 1;
+      }
+      else
+      {
+         levelset_filenames[levelset_count] = argc[i];
+         levelset_count ++;
+      }
+   }
+   if(levelset_count == 0)
+   {
+      levelset_filenames[0] = LEVELSET_DEFAULT;
+      levelset_count = 1;
+   }
+
+   // Every level is loaded by the task that checks it
+   levelsets  = malloc(sizeof(LevelSet_T) * levelset_count);
+   task_count = 0;
+   for(i = 0; i < levelset_count; i++)
+   {
+      LevelSet_Init(&levelsets[i], ~(size_t)0);
+      LevelSet_Load(&levelsets[i], levelset_filenames[i]);
+      task_count += (int)LevelSet_GetCount(&levelsets[i]);
+   }
+
+   batch.tasks   = malloc(sizeof(LevelCheckTask_T)   * task_count);
+   batch.results = malloc(sizeof(LevelCheckResult_T) * task_count);
+   task_count = 0;
+   for(i = 0; i < levelset_count; i++)
+   {
+      count = LevelSet_GetCount(&levelsets[i]);
+      for(j = 0; j < count; j++)
+      {
+         batch.tasks[task_count].levelset = &levelsets[i];
+         batch.tasks[task_count].index    = j;
+         task_count ++;
+      }
+   }
+
+   counter_start = SDL_GetPerformanceCounter();
+   WorkerPool_Run(threads, task_count, CheckLevel, &batch, NULL);
+   elapsed = (double)(SDL_GetPerformanceCounter() - counter_start) / 
+             SDL_GetPerformanceFrequency();
+
+   failed = 0;
+   for(i = 0; i < task_count; i++)
+   {
+      entry  = ArrayList_GetIndex(&batch.tasks[i].levelset->entry_list, batch.tasks[i].index);
+      result = &batch.results[i];
+      ArrayList_Get(&result->unreached, &count, NULL);
+      if(count > 0 || result->door_reached == 0)
+      {
+         failed ++;
+         printf("FAIL %s\n", entry->filename);
+         if(result->door_count == 0)
+         {
+            printf("     has no door\n");
+         }
+         else if(result->door_reached == 0)
+         {
+            printf("     no door can be reached\n");
+         }
+         PrintPositions("gold can't be reached at", &result->unreached);
+      }
+      else
+      {
+         printf("ok   %s%s\n", entry->filename, 
+                (result->needs_dig == 1) ? " (needs digging)" : "");
+      }
+      PrintPositions("warning, no door can be reached after gold at", &result->dead_ends);
+      if(memory == 1)
+      {
+         Level_PrintMemoryReport(entry->level);
+      }
+      ArrayList_Destroy(&result->unreached);
+      ArrayList_Destroy(&result->dead_ends);
+   }
+   printf("%d of %d levels failed, checked in %.3f seconds on %d threads\n", 
+          failed, task_count, elapsed, (threads < 1) ? 1 : threads);
+
+   for(i = 0; i < levelset_count; i++)
+   {
+      LevelSet_Destroy(&levelsets[i]);
+   }
+   free(levelsets);
+   free(levelset_filenames);
+   free(batch.tasks);
+   free(batch.results);
+   SDL_Quit();
+   return (failed > 0) ? 1 : 0;
+}
+
+static void CheckLevel(void * context, int task, int worker)
+{
+   LevelCheckBatch_T * batch;
+   LevelCheckResult_T * result;
+   Level_T * level;
+
+   batch  = context;
+   result = &batch->results[task];
+   level  = LevelSet_GetLevel(batch->tasks[task].levelset, batch->tasks[task].index);
+
+   ArrayList_Init(&result->unreached, sizeof(Pos2D_T), 0);
+   ArrayList_Init(&result->dead_ends, sizeof(Pos2D_T), 0);
+   result->needs_dig = 0;
+   if(LevelCheck_Run(result, level, 0) == 0 && batch->allow_dig == 1)
+   {
+      result->needs_dig = LevelCheck_Run(result, level, 1);
+   }
+}
+
+// Returns 1 if every gold and a door can be reached
+static int LevelCheck_Run(LevelCheckResult_T * result, Level_T * level, int dig)
+{
+   LevelCheck_T check, from_gold;
+   Gold_T * gold_list;
+   Pos2D_T * pos;
+   size_t gold_count, i;
+
+   ArrayList_Clear(&result->unreached);
+   ArrayList_Clear(&result->dead_ends);
+   gold_list = ArrayList_Get(&level->gold_list_init, &gold_count, NULL);
+   ArrayList_Get(&level->door_list, &i, NULL);
+   result->door_count = (int)i;
+   result->gold_total = (int)gold_count;
+
+   LevelCheck_Init(&check, level, dig);
+   LevelCheck_Search(&check, level->start_spot.x, level->start_spot.y);
+   result->door_reached = LevelCheck_DoorReached(&check);
+
+   LevelCheck_Init(&from_gold, level, dig);
+   for(i = 0; i < gold_count; i++)
+   {
+      if(LevelCheck_Reached(&check, gold_list[i].pos.x, gold_list[i].pos.y) == 0)
+      {
+         pos = ArrayList_Add(&result->unreached, NULL);
+         (*pos) = gold_list[i].pos;
+      }
+      else if(result->door_count > 0)
+      {
+         memset(from_gold.seen, 0, from_gold.width * from_gold.height * 2);
+         LevelCheck_Search(&from_gold, gold_list[i].pos.x, gold_list[i].pos.y);
+         if(LevelCheck_DoorReached(&from_gold) == 0)
+         {
+            pos = ArrayList_Add(&result->dead_ends, NULL);
+            (*pos) = gold_list[i].pos;
+         }
+      }
+   }
+   LevelCheck_Destroy(&from_gold);
+   LevelCheck_Destroy(&check);
+
+   ArrayList_Get(&result->unreached, &i, NULL);
+   return i == 0 && result->door_reached == 1;
+}
+
+static void LevelCheck_Init(LevelCheck_T * check, Level_T * level, int dig)
+{
+   check->level  = level;
+   check->width  = level->tmap.width;
+   check->height = level->tmap.height;
+   check->dig    = dig;
+   check->seen   = calloc(check->width * check->height * 2, 1);
+   check->queue  = malloc(sizeof(int) * check->width * check->height * 2);
+}
+
+static void LevelCheck_Destroy(LevelCheck_T * check)
+{
+   free(check->seen);
+   free(check->queue);
+}
+
+static void LevelCheck_Visit(LevelCheck_T * check, int * tail, int x, int y, int hole)
+{
+   int node;
+   if(x >= 0 && x < check->width && y >= 0 && y < check->height)
+   {
+      node = NODE(check, x, y, hole);
+      if(check->seen[node] == 0)
+      {
+         check->seen[node] = 1;
+         check->queue[*tail] = node;
+         (*tail) ++;
+      }
+   }
+}
+
+// Marks every node the player can get to from x, y while at rest there
+static void LevelCheck_Search(LevelCheck_T * check, int x, int y)
+{
+   LevelTile_T around[MOVEMENT_AROUND][MOVEMENT_AROUND];
+   Movement_Options_T options;
+   int head, tail, node, hole;
+
+   head = 0;
+   tail = 0;
+   LevelCheck_Visit(check, &tail, x, y, 0);
+   while(head < tail)
+   {
+      node = check->queue[head];
+      head ++;
+      hole = node & NODE_HOLE;
+      x = (node >> 1) % check->width;
+      y = (node >> 1) / check->width;
+
+      Movement_QueryAround(check->level, x, y, around);
+      if(hole == NODE_HOLE)
+      {
+         around[1][1].has_hole = 1;
+      }
+      else if(around[1][1].terrain_type == TMAP_TILE_DIRT)
+      {
+         // Stuck in dirt, the player dies here
+         continue;
+      }
+
+      Movement_GetOptions(around, &options);
+      if(options.fall == 1)
+      {
+         // Falling can't be stopped, so nothing else is possible
+         LevelCheck_Visit(check, &tail, x, y + 1, 0);
+         continue;
+      }
+
+      if(options.move_left  == 1) LevelCheck_Visit(check, &tail, x - 1, y, 0);
+      if(options.move_right == 1) LevelCheck_Visit(check, &tail, x + 1, y, 0);
+      if(options.move_up    == 1) LevelCheck_Visit(check, &tail, x, y - 1, 0);
+      if(options.move_down  == 1 || options.let_go == 1)
+      {
+         LevelCheck_Visit(check, &tail, x, y + 1, 0);
+      }
+
+      // Dig, step over and drop into the hole
+      if(check->dig == 1)
+      {
+         if(options.dig_left  == 1) LevelCheck_Visit(check, &tail, x - 1, y + 1, NODE_HOLE);
+         if(options.dig_right == 1) LevelCheck_Visit(check, &tail, x + 1, y + 1, NODE_HOLE);
+      }
+   }
+}
+
+static int LevelCheck_Reached(LevelCheck_T * check, int x, int y)
+{
+   int result;
+   if(x >= 0 && x < check->width && y >= 0 && y < check->height)
+   {
+      result = check->seen[NODE(check, x, y, 0)] || check->seen[NODE(check, x, y, NODE_HOLE)];
+   }
+   else
+   {
+      result = 0;
+   }
+   return result;
+}
+
+static int LevelCheck_DoorReached(LevelCheck_T * check)
+{
+   Pos2D_T * door_list;
+   size_t door_count, i;
+   int result;
+
+   result = 0;
+   door_list = ArrayList_Get(&check->level->door_list, &door_count, NULL);
+   for(i = 0; i < door_count && result == 0; i++)
+   {
+      result = LevelCheck_Reached(check, door_list[i].x, door_list[i].y);
+   }
+   return result;
+}
+
+static void PrintPositions(const char * label, ArrayList_T * list)
+{
+   Pos2D_T * pos;
+   size_t count, i;
+   pos = ArrayList_Get(list, &count, NULL);
+   if(count > 0)
+   {
+      printf("     %s", label);
+      for(i = 0; i < count; i++)
+      {
+         printf(" %d,%d", pos[i].x, pos[i].y);
+      }
+      printf("\n");
+   }
+}
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ArrayList.h"
+#include "IntMap.h"
+#include "Pos2D.h"
+#include "Level.h"
+#include "LevelFormat.h"
+
+// Compiles a text map into the binary level format
+//
+// Usage: level_tool <input.txt> <output.lvl>
+//        level_tool --sparse <output.lvl>
+//        level_tool --grid <side> <output.lvl>
+//
+// The tile data is stored run length encoded when that comes out smaller.
+//
+// --sparse writes a generated SPARSE_SIDE square level instead, with all
+// of its terrain in the top left SPARSE_FILL_W by SPARSE_FILL_H tiles and
+// air everywhere else. It is there to measure what a big, mostly empty
+// map costs, with level_check --memory.
+//
+// --grid writes a generated square level of the given side with the same
+// floors and ladders all over it, roomy enough for batch_sim --guards to
+// put a thousand guards on.
+
+#define SPARSE_SIDE    4096
+#define SPARSE_FILL_W  512
+#define SPARSE_FILL_H  256
+
+// Floors are this many tiles apart, with ladders and gold spaced along them
+#define SPARSE_FLOOR_STEP  8
+#define SPARSE_LADDER_STEP 64
+#define SPARSE_GOLD_OFFSET 16
+
+// Smallest --grid side with a full floor, ladder and gold spacing in it
+#define GRID_MIN_SIDE SPARSE_LADDER_STEP
+
+typedef struct TextLevel_S TextLevel_T;
+struct TextLevel_S
+{
+   int       width;
+   int       height;
+   Pos2D_T   start;
+   uint8_t * tiles;
+   Pos2D_T * gold;
+   size_t    gold_count;
+   Pos2D_T * doors;
+   size_t    door_count;
+   Pos2D_T * guards;
+   size_t    guard_count;
+};
+
+static void AddPos(Pos2D_T ** list, size_t * count, int x, int y)
+{
+   (*list) = realloc(*list, sizeof(Pos2D_T) * ((*count) + 1));
+   (*list)[*count].x = x;
+   (*list)[*count].y = y;
+   (*count) ++;
+}
+
+// Reads the same text format as Level_Load
+static int ReadTextLevel(TextLevel_T * level, const char * filename)
+{
+   FILE * fp;
+   int input, x, y;
+   size_t index, size;
+   uint8_t tile;
+
+   fp = fopen(filename, "r");
+   if(fp == NULL)
+   {
+      printf("Error: Could not open \"%s\"\n", filename);
+      return 0;
+   }
+
+   if(fscanf(fp, "%i", &level->width) != 1 || fscanf(fp, "%i", &level->height) != 1 ||
+      level->width  <= 0 || level->width  > LEVELFORMAT_MAX_SIDE ||
+      level->height <= 0 || level->height > LEVELFORMAT_MAX_SIDE)
+   {
+      printf("Error: \"%s\" has no map size, or one over %d\n", filename, LEVELFORMAT_MAX_SIDE);
+      fclose(fp);
+      return 0;
+   }
+
+   size = (size_t)level->width * level->height;
+   level->tiles      = calloc(size, 1);
+   level->start.x    = 0;
+   level->start.y    = 0;
+   level->gold       = NULL;
+   level->gold_count = 0;
+   level->doors      = NULL;
+   level->door_count = 0;
+   level->guards      = NULL;
+   level->guard_count = 0;
+
+   for(index = 0; index < size && fscanf(fp, "%i", &input) == 1; index++)
+   {
+      x = (int)(index % level->width);
+      y = (int)(index / level->width);
+      switch(input)
+      {
+         case 1:  tile = TMAP_TILE_DIRT;   break;
+         case 2:
+            tile = TMAP_TILE_AIR;
+            level->start.x = x;
+            level->start.y = y;
+            break;
+         case 3:  tile = TMAP_TILE_LADDER; break;
+         case 4:  tile = TMAP_TILE_BAR;    break;
+         case 5:
+            tile = TMAP_TILE_AIR;
+            AddPos(&level->gold, &level->gold_count, x, y);
+            break;
+         case 6:
+            tile = TMAP_TILE_DOOR;
+            AddPos(&level->doors, &level->door_count, x, y);
+            break;
+         case 7:
+            tile = TMAP_TILE_AIR;
+            AddPos(&level->guards, &level->guard_count, x, y);
+            break;
+         default: tile = TMAP_TILE_AIR;    break;
+      }
+      level->tiles[index] = tile;
+   }
+
+   fclose(fp);
+   return 1;
+}
+
+// Rows of dirt floor SPARSE_FLOOR_STEP apart, joined by ladders, with gold
+// on every floor and walls keeping the player inside the filled corner
+static void BuildGridLevel(TextLevel_T * level, int side, int fill_w, int fill_h)
+{
+   int x, y;
+   uint8_t tile;
+
+   level->width       = side;
+   level->height      = side;
+   level->tiles       = calloc((size_t)level->width * level->height, 1);
+   level->gold        = NULL;
+   level->gold_count  = 0;
+   level->doors       = NULL;
+   level->door_count  = 0;
+   level->guards      = NULL;
+   level->guard_count = 0;
+
+   for(y = 0; y < fill_h; y++)
+   {
+      for(x = 0; x < fill_w; x++)
+      {
+         tile = TMAP_TILE_AIR;
+         if(x == fill_w - 1 || y == fill_h - 1)
+         {
+            tile = TMAP_TILE_DIRT;
+         }
+         else if(x % SPARSE_LADDER_STEP == SPARSE_LADDER_STEP / 2)
+         {
+            tile = TMAP_TILE_LADDER;
+         }
+         else if(y % SPARSE_FLOOR_STEP == SPARSE_FLOOR_STEP - 1)
+         {
+            tile = TMAP_TILE_DIRT;
+         }
+         else if(y % SPARSE_FLOOR_STEP == SPARSE_FLOOR_STEP - 2 &&
+                 x % SPARSE_LADDER_STEP == SPARSE_GOLD_OFFSET)
+         {
+            AddPos(&level->gold, &level->gold_count, x, y);
+         }
+         level->tiles[x + (size_t)y * level->width] = tile;
+      }
+   }
+
+   // Start and door at either end of the bottom floor
+   level->start.x = 1;
+   level->start.y = fill_h - 2;
+   x = fill_w - 3;
+   y = fill_h - 2;
+   level->tiles[x + (size_t)y * level->width] = TMAP_TILE_DOOR;
+   AddPos(&level->doors, &level->door_count, x, y);
+}
+
+// Returns the encoded size. Output must hold 2 bytes per tile.
+static size_t EncodeRLE(const uint8_t * tiles, size_t size, uint8_t * output)
+{
+   size_t i, out;
+   int run;
+   out = 0;
+   i = 0;
+   while(i < size)
+   {
+      run = 1;
+      while(i + run < size && run < 255 && tiles[i + run] == tiles[i])
+      {
+         run ++;
+      }
+      output[out]     = (uint8_t)run;
+      output[out + 1] = tiles[i];
+      out += 2;
+      i += run;
+   }
+   return out;
+}
+
+static void WritePositions(FILE * fp, const Pos2D_T * list, size_t count)
+{
+   size_t i;
+   int32_t pair[2];
+   for(i = 0; i < count; i++)
+   {
+      pair[0] = list[i].x;
+      pair[1] = list[i].y;
+      fwrite(pair, sizeof(int32_t), 2, fp);
+   }
+}
+
+static int WriteBinaryLevel(const TextLevel_T * level, const char * filename)
+{
+   FILE * fp;
+   LevelFormatHeader_T header;
+   size_t size, rle_size;
+   uint8_t * rle;
+
+   fp = fopen(filename, "wb");
+   if(fp == NULL)
+   {
+      printf("Error: Could not create \"%s\"\n", filename);
+      return 0;
+   }
+
+   size = (size_t)level->width * level->height;
+   rle = malloc(size * 2);
+   rle_size = EncodeRLE(level->tiles, size, rle);
+
+   memset(&header, 0, sizeof(LevelFormatHeader_T));
+   memcpy(header.magic, LEVELFORMAT_MAGIC, LEVELFORMAT_MAGIC_SIZE);
+   header.version    = LEVELFORMAT_VERSION;
+   header.width      = level->width;
+   header.height     = level->height;
+   header.start_x    = level->start.x;
+   header.start_y    = level->start.y;
+   header.gold_count = (uint32_t)level->gold_count;
+   header.door_count = (uint32_t)level->door_count;
+   header.guard_count = (uint32_t)level->guard_count;
+   if(rle_size < size)
+   {
+      header.flags      = LEVELFORMAT_FLAG_RLE;
+      header.tile_bytes = (uint32_t)rle_size;
+   }
+   else
+   {
+      header.tile_bytes = (uint32_t)size;
+   }
+
+   fwrite(&header, sizeof(LevelFormatHeader_T), 1, fp);
+   WritePositions(fp, level->gold,  level->gold_count);
+   WritePositions(fp, level->doors, level->door_count);
+   WritePositions(fp, level->guards, level->guard_count);
+   if(header.flags & LEVELFORMAT_FLAG_RLE)
+   {
+      fwrite(rle, 1, rle_size, fp);
+   }
+   else
+   {
+      fwrite(level->tiles, 1, size, fp);
+   }
+
+   free(rle);
+   fclose(fp);
+   printf("%s: %dx%d, %u gold, %u doors, %u guards, %u tile bytes%s\n", filename, 
+          level->width, level->height, header.gold_count, header.door_count, header.guard_count,
+          header.tile_bytes, (header.flags & LEVELFORMAT_FLAG_RLE) ? " (RLE)" : "");
+   return 1;
+}
+
+int main(int argc, char * args[])
+{
+   TextLevel_T level;
+   int result, side;
+
+   side = (argc == 4 && strcmp(args[1], "--grid") == 0) ? atoi(args[2]) : 0;
+   if((argc != 3 || strcmp(args[1], "--grid") == 0) && 
+      (side < GRID_MIN_SIDE || side > LEVELFORMAT_MAX_SIDE))
+   {
+      printf("Usage: %s <input.txt> <output.lvl>\n", args[0]);
+      printf("       %s --sparse <output.lvl>\n", args[0]);
+      printf("       %s --grid <side> <output.lvl>\n", args[0]);
+      printf("A grid side goes from %d to %d\n", GRID_MIN_SIDE, LEVELFORMAT_MAX_SIDE);
+      return 1;
+   }
+
+   if(side > 0)
+   {
+      BuildGridLevel(&level, side, side, side);
+   }
+   else if(strcmp(args[1], "--sparse") == 0)
+   {
+      BuildGridLevel(&level, SPARSE_SIDE, SPARSE_FILL_W, SPARSE_FILL_H);
+   }
+   else if(!ReadTextLevel(&level, args[1]))
+   {
+      return 1;
+   }
+
+   result = WriteBinaryLevel(&level, args[argc - 1]);
+
+   free(level.tiles);
+   free(level.gold);
+   free(level.doors);
+   free(level.guards);
+   return result ? 0 : 1;
+}
+
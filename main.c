@@ -19,60 +19,57 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "SDLInclude.h"
 
 #include "GlobalData.h"
-#include "SDLTools.h"
 
 #include "ArrayList.h"
+#include "SDLTools.h"
+#include "IntMap.h"
 #include "Pos2D.h"
 #include "Level.h"
 #include "LevelSet.h"
 #include "FontText.h"
 
 #include "EventSys.h"
+#include "GameEvents.h"
 #include "GameInput.h"
+#include "FlowField.h"
+#include "ActorStore.h"
+#include "GameSession.h"
 #include "GameConfigData.h"
 #include "GameSettings.h"
 #include "GameInput.h"
+#include "InputLog.h"
+#include "Profiler.h"
+#include "TripleBuffer.h"
+#include "FramePacer.h"
+
+// Frames between refreshes of the profiler overlay text
+#define PROFILER_OVERLAY_REFRESH 30
+// A line per phase, then the level and sprite batch counters
+#define PROFILER_OVERLAY_LINES   (e_pp_last + 2)
+#define PROFILER_CSV_FILENAME    "profile.csv"
 
-#define PLAYER_STATE_NOT_MOVING  0
-#define PLAYER_STATE_MOVING      1
-#define PLAYER_STATE_FALLING     2
-#define PLAYER_STATE_DIGGING     3
-#define PLAYER_STATE_DEATH       4
-#define PLAYER_STATE_WIN         5
+// Event counters written at exit, and whenever the dump key is let go
+#define EVENTSTATS_CSV_FILENAME  "event_stats.csv"
+#define EVENTSTATS_JSON_FILENAME "event_stats.json"
 
+// Ticks --headless runs for when given no count and no replay, since
+// nothing else would ever finish the levelset
+#define HEADLESS_DEFAULT_TICKS   3600
+
+// Longest stretch of time the simulation catches up on after a stall,
+// beyond that the game slows
+#define MAX_FRAME_SECONDS 0.25
 
 #define MARGIN_TOP     48
 #define MARGIN_BOTTOM  20
 #define MARGIN_LEFT    20
 #define MARGIN_RIGHT   20
 
-typedef struct PlayerData_S PlayerData_T;
-struct PlayerData_S
-{
-   int input_flags[e_gipk_last];
-   Pos2D_T grid_p;
-   Pos2D_T next_grid_p;
-   int player_state;
-   float move_timer;
-   float move_timeout;
-   ESInbox_T * inbox_levelstartpos;
-   ESInbox_T * inbox_inputstate;
-};
-
-typedef struct GameLevelData_S GameLevelData_T;
-struct GameLevelData_S
-{
-   int level_index;
-   LevelSet_T * levelset;
-   Level_T * level;
-   ESInbox_T * inbox_playerongold;
-   ESInbox_T * inbox_initlevel;
-};
-
-
 typedef struct GameRenderData_S GameRenderData_T;
 struct GameRenderData_S
 {
@@ -80,6 +77,10 @@ struct GameRenderData_S
    SDL_Rect level_viewport;
    SDL_Texture * text_terrain;
    SDL_Texture * text_character;
+   SDL_Texture * text_guard;       // The character, tinted
+   LevelRenderCache_T level_cache;
+   LevelRenderStats_T level_stats; // From the last Level_Render
+   SDLTools_Batch_T batch;
 };
 
 typedef struct GameTextData_S GameTextData_T;
@@ -87,100 +88,148 @@ struct GameTextData_S
 {
    TTF_Font * font;
    FontText_T gold_count_text;
-   ESInbox_T * inbox_goldamountchanged;
-};
-
-typedef struct GameAudioData_S GameAudioData_T;
-struct GameAudioData_S
-{
-   Mix_Music * music;
-   Mix_Chunk * pickup;
-   ESInbox_T * inbox_goldamountchanged;
+   int gold_left;  // As shown by gold_count_text
+   int gold_total;
+#ifdef PROFILER_ENABLED
+   TTF_Font * profiler_font;
+   FontText_T profiler_text[PROFILER_OVERLAY_LINES];
+   int profiler_show;
+   int profiler_key_prev;
+   int profiler_frames;    // Since the overlay text was refreshed
+#endif // PROFILER_ENABLED
 };
 
-#define EVENT_INITLEVEL          1
-#define EVENT_LEVELSTARTPOS      2
-#define EVENT_PLAYERONGOLD       3
-#define EVENT_GOLDAMOUNTCHANGED  4
-#define EVENT_INPUTSTATE         5
+#define REPLAY_MODE_NONE   0
+#define REPLAY_MODE_RECORD 1
+#define REPLAY_MODE_PLAY   2
 
-typedef struct Event_InitLevel_S         Event_InitLevel_T;
-typedef struct Event_LevelStartPos_S     Event_LevelStartPos_T;
-typedef struct Event_PlayerOnGold_S      Event_PlayerOnGold_T;
-typedef struct Event_GoldAmountChanged_S Event_GoldAmountChanged_T;
-typedef struct Event_InputState_S        Event_InputState_T;
-
-struct Event_InitLevel_S
+typedef struct GameReplayData_S GameReplayData_T;
+struct GameReplayData_S
 {
-   int level_number;
+   int mode;
+   InputLog_T log;
+   unsigned long tick;                // Updates run so far
+   int game_input_flags[e_gigk_last]; // As last recorded or played back
+   ESInbox_T * inbox_inputstate;      // Recording only
 };
 
-struct Event_LevelStartPos_S
+// Input the render thread polled on its way to the simulation. Events the
+// full queue turned away wait here in order, along with everything polled
+// after them, and are sent again before the next frame's input.
+typedef struct GameInputQueue_S GameInputQueue_T;
+struct GameInputQueue_S
 {
-   int player;
-   int x;
-   int y;
+   EventSys_T * event_sys;
+   ArrayList_T overflow_list; // Event_InputPolled_T
+   size_t overflow_head;      // First one not sent yet
 };
 
-struct Event_PlayerOnGold_S
+typedef struct GameAudioData_S GameAudioData_T;
+struct GameAudioData_S
 {
-   int player;
-   int gold_index;
+   Mix_Music * music;
+   Mix_Chunk * pickup;
+   ESInbox_T * inbox_goldamountchanged;
 };
 
-struct Event_GoldAmountChanged_S
+// Everything handle_render needs from one tick. The simulation thread
+// publishes one per tick and never touches it again while it is read.
+typedef struct GameSnapshot_S GameSnapshot_T;
+struct GameSnapshot_S
 {
-   int new_amount;
-   int new_max;
-   int delta;
+   Actor_T player;
+   Actor_T prev_player;       // As of the tick before, for interpolation
+   LevelSnapshot_T level;
+   ArrayList_T guard_list;    // Actor_T
+   int level_index;           // Pinned in the LevelSet, -1 when unused
+   int gold_left;
+   int gold_total;
+   Uint64 counter;            // Performance counter the tick was due at
 };
 
-struct Event_InputState_S
+typedef struct GameSimData_S GameSimData_T;
+struct GameSimData_S
 {
-   int player;
-   GameInput_PlayerKeys_T key;
-   int state;
+   GameSession_T    * session;
+   GameReplayData_T * game_replay_data;
+   GameAudioData_T  * game_audio_data;
+   ESInbox_T        * inbox_inputpolled; // Sent by the render thread
+   double tick_seconds;
+   TripleBuffer_T snapshots;
+   GameSnapshot_T snapshot_slots[3];
+   SDL_atomic_t quit;
+#ifdef EVENTSYS_STATS
+   int dump_key_prev;
+#endif // EVENTSYS_STATS
 };
 
-static void Level_SetPlayerAtStart(Level_T * level, PlayerData_T * player);
-
-static int IsTerrainPassable(LevelTile_T * from, LevelTile_T * to);
-static int IsTerrainFallable(LevelTile_T * from, LevelTile_T * to);
-static int IsAllGoldColected(Level_T * level);
 static void FontText_UpdateGoldCount(FontText_T * gold_count_text, int gold_left, int gold_total);
+static int  GetActorDrawLoc(Actor_T * actor, Pos2D_T * draw_loc);
 
 static void CheckForExit(const SDL_Event *event, int * done);
 
+static void GameSnapshot_Take(GameSnapshot_T * snapshot, GameSimData_T * sim, Actor_T * prev_player, Uint64 counter);
+
+
+static void GameInputQueue_Init(GameInputQueue_T * input_queue, EventSys_T * event_sys);
+static void GameInputQueue_Send(GameInputQueue_T * input_queue, int player, int key, int state);
+static void GameInputQueue_Flush(GameInputQueue_T * input_queue);
+static void GameInputQueue_Destroy(GameInputQueue_T * input_queue);
 
 static void handle_input(const SDL_Event * event, 
-                         EventSys_T * event_sys, 
+                         GameInputQueue_T * input_queue, 
                          int * done, 
                          int * game_input_flags, 
-                         int * player_input_flags, 
                          SDL_Scancode * game_controls, 
                          SDL_Scancode * player1_controls);
 
-static void handle_update(float seconds,
-                          EventSys_T * event_sys, 
-                          GameLevelData_T * game_level_data, 
-                          GameAudioData_T * game_audio_data,
-                          int * game_input_flags,  
-                          PlayerData_T * player1_data, 
-                          GameTextData_T * game_text_data);
+static void handle_update_audio(float seconds,
+                                EventSys_T * event_sys,
+                                GameAudioData_T * game_audio_data);
+
+static void handle_replay(GameSession_T * session,
+                          GameReplayData_T * game_replay_data);
+
+static void run_headless(long max_ticks,
+                         double tick_seconds,
+                         GameSession_T * session, 
+                         GameReplayData_T * game_replay_data,
+                         GameAudioData_T * game_audio_data);
+
+static int  simulation_thread(void * data);
+static void simulation_tick(GameSimData_T * sim, Uint64 counter);
+
+#ifdef PROFILER_ENABLED
+static void handle_profiler_overlay(GameTextData_T * game_text_data,
+                                    GameRenderData_T * game_render_data,
+                                    int * game_input_flags);
+#endif // PROFILER_ENABLED
 
 static void handle_render(GameRenderData_T * game_render_data, 
-                          Level_T * level, 
-                          PlayerData_T * player1_data);
+                          GameSnapshot_T * snapshot,
+                          float alpha);
 
 int main(int args, char * argc[])
 {
    SDL_Window  * window;
+   Uint32 renderer_flags;
+   SDL_RendererInfo renderer_info;
+   SDL_DisplayMode display_mode;
+   FramePacer_T frame_pacer;
+   double frame_seconds;
+   const char * pacing_name;   // The pacing in use, after any fall back
    GameRenderData_T game_render_data;
    GameAudioData_T game_audio_data;
    SDL_Event event;
    int done;
-   int prevTicks, diffTicks, nowTicks;
-   float seconds;
+   Uint64 counter_now;
+   double tick_seconds, tick_counts;
+   float alpha;
+   int headless;
+   long headless_ticks;
+   const char * record_filename;
+   const char * replay_filename;
+   GameReplayData_T game_replay_data;
 
    int i;
    int game_input_flags[e_gigk_last];
@@ -190,29 +239,66 @@ int main(int args, char * argc[])
 
    // Music
 
-   PlayerData_T player1_data;
    LevelSet_T levelset;
-   GameLevelData_T game_level_data;
+   GameSession_T session;
+   Actor_T player1;
 
    // Settings
    GameSettings_T * game_settings;
    SDL_Scancode player1_controls[e_gipk_last];
    SDL_Scancode game_controls[e_gigk_last];
 
-   // Event
-   EventSys_T event_sys;
-   Event_InitLevel_T event_initlevel;
+   // Simulation thread
+   GameSimData_T game_sim_data;
+   GameSnapshot_T * snapshot;
+   SDL_Thread * sim_thread;
+   ESQueueStats_T input_stats;
+   GameInputQueue_T input_queue;
    
    // Controller 
    SDL_GameController * game_ctrl;
 
 
-   EventSys_Init(&event_sys);
-   EventSys_RegisterEventType(&event_sys, EVENT_PLAYERONGOLD,      sizeof(Event_PlayerOnGold_T));
-   EventSys_RegisterEventType(&event_sys, EVENT_GOLDAMOUNTCHANGED, sizeof(Event_GoldAmountChanged_T));
-   EventSys_RegisterEventType(&event_sys, EVENT_INITLEVEL,         sizeof(Event_InitLevel_T));
-   EventSys_RegisterEventType(&event_sys, EVENT_LEVELSTARTPOS,     sizeof(Event_LevelStartPos_T));
-   EventSys_RegisterEventType(&event_sys, EVENT_INPUTSTATE,        sizeof(Event_InputState_T));
+   // --headless [ticks] runs only the game logic, as fast as it can go,
+   // for HEADLESS_DEFAULT_TICKS if there is no count and no replay
+   // --record file and --replay file save or play back all input
+   headless = 0;
+   headless_ticks = 0;
+   record_filename = NULL;
+   replay_filename = NULL;
+   for(i = 1; i < args; i++)
+   {
+      if(strcmp(argc[i], "--headless") == 0)
+      {
+         headless = 1;
+         if(i + 1 < args && argc[i + 1][0] >= '0' && argc[i + 1][0] <= '9')
+         {
+            i ++;
+            headless_ticks = atol(argc[i]);
+         }
+      }
+      else if(strcmp(argc[i], "--record") == 0 && i + 1 < args)
+      {
+         i ++;
+         record_filename = argc[i];
+      }
+      else if(strcmp(argc[i], "--replay") == 0 && i + 1 < args)
+      {
+         i ++;
+         replay_filename = argc[i];
+      }
+   }
+
+   // Before the session is set up, which starts the LevelSet's thread
+   if(headless == 1)
+   {
+      // No video, audio or fonts, so nothing listens for their events
+      SDL_Init(SDL_INIT_TIMER);
+   }
+   else
+   {
+      SDL_Init(SDL_INIT_EVERYTHING);
+   }
 
    GameSettings_Load("config.txt");
    game_settings = GameSettings_Get();
@@ -223,35 +309,84 @@ int main(int args, char * argc[])
    GameInput_PopulateSDLScancodes(game_controls, 
                                   game_settings->game_keys, 
                                   e_gigk_last);
-   
-   for(i = 0; i < e_gipk_last; i++)
-   {
-      player1_data.input_flags[i] = 0;
-   }
-   player1_data.inbox_levelstartpos = EventSys_CreateInbox(&event_sys, EVENT_LEVELSTARTPOS);
-   player1_data.inbox_inputstate = EventSys_CreateInbox(&event_sys, EVENT_INPUTSTATE);
 
 
+   // Render side copy of the game keys, the session keeps its own
    for(i = 0; i < e_gigk_last; i++)
    {
       game_input_flags[i] = 0;
    }
 
-   LevelSet_Init(&levelset);
+   LevelSet_Init(&levelset, game_settings->config.game_levelset_resident);
    LevelSet_Load(&levelset, game_settings->config.game_levelset);
    
-   game_level_data.level = NULL;
-   game_level_data.levelset = &levelset;
-   game_level_data.level_index = 0;
-   game_level_data.level = LevelSet_GetLevel(game_level_data.levelset, game_level_data.level_index);
-   Level_SetPlayerAtStart(game_level_data.level, &player1_data);   
-   game_level_data.inbox_playerongold = EventSys_CreateInbox(&event_sys, EVENT_PLAYERONGOLD);
-   game_level_data.inbox_initlevel = EventSys_CreateInbox(&event_sys, EVENT_INITLEVEL);
-
-   player1_data.player_state = PLAYER_STATE_NOT_MOVING;
+   // The only session, so it plays the LevelSet's levels in place
+   GameSession_Init(&session, &levelset, 0, 0);
+
+   if(game_settings->config.game_tick_rate > 0)
+   {
+      tick_seconds = 1.0 / game_settings->config.game_tick_rate;
+   }
+   else
+   {
+      tick_seconds = 1.0 / 60.0;
+   }
+
+   game_replay_data.mode = REPLAY_MODE_NONE;
+   game_replay_data.log.file = NULL;
+   game_replay_data.tick = 0;
+   game_replay_data.inbox_inputstate = NULL;
+   for(i = 0; i < e_gigk_last; i++)
+   {
+      game_replay_data.game_input_flags[i] = 0;
+   }
+   if(replay_filename != NULL)
+   {
+      if(InputLog_OpenReplay(&game_replay_data.log, replay_filename))
+      {
+         game_replay_data.mode = REPLAY_MODE_PLAY;
+         // Playback is only exact at the tick rate it was recorded at
+         if(game_replay_data.log.tick_rate > 0)
+         {
+            tick_seconds = 1.0 / game_replay_data.log.tick_rate;
+         }
+      }
+   }
+   else if(record_filename != NULL)
+   {
+      if(InputLog_OpenRecord(&game_replay_data.log, record_filename, (int)(1.0 / tick_seconds + 0.5)))
+      {
+         game_replay_data.mode = REPLAY_MODE_RECORD;
+         game_replay_data.inbox_inputstate = EventSys_CreateInbox(&session.event_sys, EVENT_INPUTSTATE);
+      }
+   }
+
+   if(headless == 1)
+   {
+      game_audio_data.inbox_goldamountchanged = NULL;
+      if(headless_ticks <= 0 && game_replay_data.mode != REPLAY_MODE_PLAY)
+      {
+         headless_ticks = HEADLESS_DEFAULT_TICKS;
+      }
+      PROFILER_INIT(PROFILER_CSV_FILENAME);
+
+      run_headless(headless_ticks,
+                   tick_seconds,
+                   &session,
+                   &game_replay_data,
+                   &game_audio_data);
+
+      InputLog_Close(&game_replay_data.log, game_replay_data.tick);
+      PROFILER_DESTROY();
+      EVENTSYS_DUMP_STATS(&session.event_sys, EVENTSTATS_CSV_FILENAME);
+      GameSettings_Cleanup();
+      GameSession_Destroy(&session);
+      LevelSet_Destroy(&levelset);
+      SDL_Quit();
+      return 0;
+   }
    
 
-   SDL_Init(SDL_INIT_EVERYTHING);   
    TTF_Init();
    Mix_Init(MIX_INIT_MP3 | MIX_INIT_OGG | MIX_INIT_MOD);
    Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, 4096);
@@ -259,7 +394,7 @@ int main(int args, char * argc[])
    game_audio_data.music = Mix_LoadMUS(game_settings->config.music_background);
    printf("Loading Background Music: %s\n", game_settings->config.music_background);
    game_audio_data.pickup = Mix_LoadWAV("pickup.wav");
-   game_audio_data.inbox_goldamountchanged = EventSys_CreateInbox(&event_sys, EVENT_GOLDAMOUNTCHANGED);
+   game_audio_data.inbox_goldamountchanged = EventSys_CreateInbox(&session.event_sys, EVENT_GOLDAMOUNTCHANGED);
    //printf("pickup %p %s\n", pickup, Mix_GetError());
    Mix_VolumeChunk(game_audio_data.pickup, game_settings->raw_volume_effects);
     
@@ -270,7 +405,41 @@ int main(int args, char * argc[])
                              game_settings->config.window_height,
                              SDL_WINDOW_SHOWN | ((game_settings->config.window_fullscreen == 1) ? SDL_WINDOW_FULLSCREEN : 0) );
    
-   game_render_data.rend  = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+   renderer_flags = SDL_RENDERER_ACCELERATED;
+   if(game_settings->pacing == e_gsp_vsync)
+   {
+      renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+   }
+   game_render_data.rend  = SDL_CreateRenderer(window, -1, renderer_flags);
+
+   frame_seconds = 0;
+   pacing_name   = "uncapped";
+   if(game_settings->pacing == e_gsp_capped)
+   {
+      frame_seconds = 1.0 / game_settings->config.window_fps_cap;
+      pacing_name   = "capped";
+   }
+   else if(game_settings->pacing == e_gsp_vsync)
+   {
+      pacing_name = "vsync";
+      // Vsync is only a request, hold frames to the display rate ourselves
+      // if the driver didn't take it
+      SDL_GetRendererInfo(game_render_data.rend, &renderer_info);
+      if((renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) == 0)
+      {
+         if(SDL_GetWindowDisplayMode(window, &display_mode) == 0 && display_mode.refresh_rate > 0)
+         {
+            frame_seconds = 1.0 / display_mode.refresh_rate;
+         }
+         else
+         {
+            frame_seconds = 1.0 / 60.0;
+         }
+         printf("Vsync is not available, capping frames at %.0f fps\n", 1.0 / frame_seconds);
+         pacing_name = "capped to the display rate";
+      }
+   }
+   FramePacer_Init(&frame_pacer, frame_seconds);
    
 
    game_render_data.level_viewport.x = MARGIN_LEFT;
@@ -280,6 +449,10 @@ int main(int args, char * argc[])
 
    game_render_data.text_terrain   = SDLTools_LoadTexture(game_render_data.rend, "terrain.png");
    game_render_data.text_character = SDLTools_LoadTexture(game_render_data.rend, "character.png");
+   game_render_data.text_guard     = SDLTools_LoadTexture(game_render_data.rend, "character.png");
+   SDL_SetTextureColorMod(game_render_data.text_guard, 255, 96, 96);
+   LevelRenderCache_Init(&game_render_data.level_cache, game_render_data.rend);
+   SDLTools_Batch_Init(&game_render_data.batch, game_render_data.rend);
    
    game_text_data.font = TTF_OpenFont("cnr.otf", 28);
    if(game_text_data.font == NULL)
@@ -291,12 +464,24 @@ int main(int args, char * argc[])
                      game_settings->config.foreground_color_red,
                      game_settings->config.foreground_color_green,
                      game_settings->config.foreground_color_blue, 0xFF);
+   game_text_data.gold_left  = -1;
+   game_text_data.gold_total = -1;
 
-   game_text_data.inbox_goldamountchanged = EventSys_CreateInbox(&event_sys, EVENT_GOLDAMOUNTCHANGED);
-
-   event_initlevel.level_number = 0;
-   EventSys_Send(&event_sys, EVENT_INITLEVEL, &event_initlevel);
-
+#ifdef PROFILER_ENABLED
+   game_text_data.profiler_font = TTF_OpenFont("cnr.otf", 14);
+   for(i = 0; i < PROFILER_OVERLAY_LINES; i++)
+   {
+      FontText_Init(&game_text_data.profiler_text[i], game_text_data.profiler_font, game_render_data.rend);
+      FontText_SetColor(&game_text_data.profiler_text[i],
+                        game_settings->config.foreground_color_red,
+                        game_settings->config.foreground_color_green,
+                        game_settings->config.foreground_color_blue, 0xFF);
+   }
+   game_text_data.profiler_show     = 0;
+   game_text_data.profiler_key_prev = 0;
+   game_text_data.profiler_frames   = 0;
+#endif // PROFILER_ENABLED
+   PROFILER_INIT(PROFILER_CSV_FILENAME);
 
 
    if(SDL_NumJoysticks() >= 1 && SDL_IsGameController(0))
@@ -314,33 +499,74 @@ int main(int args, char * argc[])
    Mix_VolumeMusic(game_settings->raw_volume_music);
    
 
+   // The simulation updates the session on its own thread so presenting a
+   // frame never holds up a tick. It owns the session and audio until it is
+   // stopped and hands the renderer a snapshot after each tick.
+   // Input crosses over as events any thread may send, so the inbox has
+   // to be there before the render thread sends any.
+   game_sim_data.session          = &session;
+   game_sim_data.game_replay_data = &game_replay_data;
+   game_sim_data.game_audio_data  = &game_audio_data;
+   game_sim_data.inbox_inputpolled = EventSys_CreateInbox(&session.event_sys, EVENT_INPUTPOLLED);
+   game_sim_data.tick_seconds     = tick_seconds;
+   for(i = 0; i < 3; i++)
+   {
+      LevelSnapshot_Init(&game_sim_data.snapshot_slots[i].level);
+      ArrayList_Init(&game_sim_data.snapshot_slots[i].guard_list, sizeof(Actor_T), 0);
+      game_sim_data.snapshot_slots[i].level_index = -1;
+   }
+   TripleBuffer_Init(&game_sim_data.snapshots, 
+                     &game_sim_data.snapshot_slots[0],
+                     &game_sim_data.snapshot_slots[1],
+                     &game_sim_data.snapshot_slots[2]);
+   SDL_AtomicSet(&game_sim_data.quit, 0);
+#ifdef EVENTSYS_STATS
+   game_sim_data.dump_key_prev = 0;
+#endif // EVENTSYS_STATS
+
+   // Something to draw before the first tick
+   ActorStore_Get(&session.actors, 0, &player1);
+   GameSnapshot_Take(TripleBuffer_GetWrite(&game_sim_data.snapshots), 
+                     &game_sim_data, &player1, SDL_GetPerformanceCounter());
+   TripleBuffer_Publish(&game_sim_data.snapshots);
+
+   GameInputQueue_Init(&input_queue, &session.event_sys);
+   sim_thread = SDL_CreateThread(simulation_thread, "Simulation", &game_sim_data);
+
    done = 0;
-   prevTicks = SDL_GetTicks();
+   tick_counts = tick_seconds * SDL_GetPerformanceFrequency();
    while(done == 0)
    {
+      PROFILER_BEGIN(e_pp_frame);
+      PROFILER_BEGIN(e_pp_input);
+      GameInputQueue_Flush(&input_queue);
       while(SDL_PollEvent(&event))
       {
          handle_input(&event, 
-                      &event_sys,
+                      &input_queue,
                       &done, 
                       game_input_flags, 
-                      player1_data.input_flags, 
                       game_controls, 
                       player1_controls);
       }
+      PROFILER_END(e_pp_input);
       
-      nowTicks = SDL_GetTicks();
-      diffTicks = nowTicks - prevTicks;
-      seconds = (float)diffTicks / 1000.0f;
-      prevTicks = nowTicks;
-      
-      handle_update(seconds, 
-                    &event_sys,
-                    &game_level_data, 
-                    &game_audio_data, 
-                    game_input_flags, 
-                    &player1_data, 
-                    &game_text_data);
+      // Draw how far we are between the newest tick and the one after it
+      snapshot = TripleBuffer_GetRead(&game_sim_data.snapshots);
+      counter_now = SDL_GetPerformanceCounter();
+      alpha = (float)((double)(Sint64)(counter_now - snapshot->counter) / tick_counts);
+      if(alpha < 0) alpha = 0;
+      if(alpha > 1) alpha = 1;
+
+      if(snapshot->gold_left  != game_text_data.gold_left || 
+         snapshot->gold_total != game_text_data.gold_total)
+      {
+         game_text_data.gold_left  = snapshot->gold_left;
+         game_text_data.gold_total = snapshot->gold_total;
+         FontText_UpdateGoldCount(&game_text_data.gold_count_text, 
+                                  game_text_data.gold_left, 
+                                  game_text_data.gold_total);
+      }
       
       SDL_SetRenderDrawColor(game_render_data.rend, 
                              game_settings->config.background_color_red, 
@@ -349,18 +575,50 @@ int main(int args, char * argc[])
       SDL_RenderClear( game_render_data.rend );
       SDL_RenderSetViewport(game_render_data.rend, NULL);
       
+      PROFILER_BEGIN(e_pp_render_text);
       FontText_Render(&game_text_data.gold_count_text, 10, 10);
+      PROFILER_END(e_pp_render_text);
       SDL_RenderSetViewport(game_render_data.rend, &game_render_data.level_viewport);
-      handle_render(&game_render_data, game_level_data.level, &player1_data);
+      handle_render(&game_render_data, snapshot, alpha);
+#ifdef PROFILER_ENABLED
+      SDL_RenderSetViewport(game_render_data.rend, NULL);
+      handle_profiler_overlay(&game_text_data, &game_render_data, game_input_flags);
+#endif // PROFILER_ENABLED
+      PROFILER_BEGIN(e_pp_present);
       SDL_RenderPresent(game_render_data.rend);
+      PROFILER_END(e_pp_present);
+      PROFILER_END(e_pp_frame);
+      PROFILER_END_FRAME();
+      FramePacer_Wait(&frame_pacer);
+   }
+   FramePacer_PrintReport(&frame_pacer, pacing_name);
+
+   SDL_AtomicSet(&game_sim_data.quit, 1);
+   SDL_WaitThread(sim_thread, NULL);
+   for(i = 0; i < 3; i++)
+   {
+      LevelSnapshot_Destroy(&game_sim_data.snapshot_slots[i].level);
+      ArrayList_Destroy(&game_sim_data.snapshot_slots[i].guard_list);
    }
+   EventSys_GetQueueStats(&session.event_sys, EVENT_INPUTPOLLED, &input_stats);
+   printf("Input: %u events, %u refused (retried), at most %d of %d waiting for a tick\n",
+          input_stats.sent, input_stats.refused, 
+          (int)input_stats.high_water, input_stats.capacity);
+   GameInputQueue_Destroy(&input_queue);
    
+   InputLog_Close(&game_replay_data.log, game_replay_data.tick);
+   PROFILER_DESTROY();
+   EVENTSYS_DUMP_STATS(&session.event_sys, EVENTSTATS_CSV_FILENAME);
    GameSettings_Cleanup();
 
+   GameSession_Destroy(&session);
    LevelSet_Destroy(&levelset);
    
+   LevelRenderCache_Destroy(&game_render_data.level_cache);
+   SDLTools_Batch_Destroy(&game_render_data.batch);
    SDL_DestroyTexture(game_render_data.text_terrain);
    SDL_DestroyTexture(game_render_data.text_character);
+   SDL_DestroyTexture(game_render_data.text_guard);
 
 
    Mix_FreeMusic(game_audio_data.music);
@@ -369,6 +627,13 @@ int main(int args, char * argc[])
    Mix_Quit();
    FontText_Destroy(&game_text_data.gold_count_text);
    TTF_CloseFont(game_text_data.font);
+#ifdef PROFILER_ENABLED
+   for(i = 0; i < PROFILER_OVERLAY_LINES; i++)
+   {
+      FontText_Destroy(&game_text_data.profiler_text[i]);
+   }
+   TTF_CloseFont(game_text_data.profiler_font);
+#endif // PROFILER_ENABLED
    
    if(game_ctrl != NULL)
    {
@@ -378,7 +643,6 @@ int main(int args, char * argc[])
    SDL_DestroyWindow(window);
    SDL_Quit();
    
-   EventSys_Destroy(&event_sys);
    printf("End\n");
    return 0;
 }
@@ -399,12 +663,61 @@ static void CheckForExit(const SDL_Event *event, int * done)
 
 }
 
+static void GameInputQueue_Init(GameInputQueue_T * input_queue, EventSys_T * event_sys)
+{
+   input_queue->event_sys     = event_sys;
+   input_queue->overflow_head = 0;
+   ArrayList_Init(&input_queue->overflow_list, sizeof(Event_InputPolled_T), 0);
+}
+
+static void GameInputQueue_Destroy(GameInputQueue_T * input_queue)
+{
+   ArrayList_Destroy(&input_queue->overflow_list);
+}
+
+static void GameInputQueue_Send(GameInputQueue_T * input_queue, int player, int key, int state)
+{
+   Event_InputPolled_T event_inputpolled;
+   Event_InputPolled_T * waiting;
+
+   event_inputpolled.key    = key;
+   event_inputpolled.state  = state;
+   event_inputpolled.player = player;
+
+   // Nothing may pass the events already waiting
+   if(input_queue->overflow_head < input_queue->overflow_list.count ||
+      GameEvents_SendInputPolled(input_queue->event_sys, &event_inputpolled) == 0)
+   {
+      waiting = ArrayList_Add(&input_queue->overflow_list, NULL);
+      (*waiting) = event_inputpolled;
+   }
+}
+
+static void GameInputQueue_Flush(GameInputQueue_T * input_queue)
+{
+   size_t count;
+   Event_InputPolled_T * list;
+
+   list = ArrayList_Get(&input_queue->overflow_list, &count, NULL);
+   while(input_queue->overflow_head < count &&
+         GameEvents_SendInputPolled(input_queue->event_sys, 
+                                    &list[input_queue->overflow_head]) != 0)
+   {
+      input_queue->overflow_head ++;
+   }
+
+   if(input_queue->overflow_head >= count)
+   {
+      ArrayList_Clear(&input_queue->overflow_list);
+      input_queue->overflow_head = 0;
+   }
+}
+
 #define CTRL_DEADZONE 8000
 static void handle_input(const SDL_Event * event, 
-                         EventSys_T * event_sys,
+                         GameInputQueue_T * input_queue,
                          int * done, 
                          int * game_input_flags, 
-                         int * player_input_flags, 
                          SDL_Scancode * game_controls, 
                          SDL_Scancode * player1_controls)
 {
@@ -413,7 +726,6 @@ static void handle_input(const SDL_Event * event,
    int joy_state;
    GameInput_PlayerKeys_T pkey;
    GameInput_GameKeys_T gkey;
-   Event_InputState_T event_inputstate;
 
    static int prev_ctrl_up    = 0;
    static int prev_ctrl_down  = 0;
@@ -463,10 +775,7 @@ static void handle_input(const SDL_Event * event,
 
       if(pkey != e_gipk_last)
       {
-         event_inputstate.key    = pkey;
-         event_inputstate.state  = key_state;
-         event_inputstate.player = 0;
-         EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+         GameInputQueue_Send(input_queue, 0, pkey, key_state);
       }
 
       // Check Game Keys
@@ -484,6 +793,7 @@ static void handle_input(const SDL_Event * event,
       {
          game_input_flags[gkey] = key_state;
 
+         GameInputQueue_Send(input_queue, -1, gkey, key_state);
       }
    }
    else if(event->type == SDL_CONTROLLERAXISMOTION && event->caxis.which == 0)
@@ -495,39 +805,27 @@ static void handle_input(const SDL_Event * event,
          {
             prev_ctrl_right = 1;
             
-            event_inputstate.key    = e_gipk_move_right;
-            event_inputstate.state  = 1;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_right, 1);
             //printf("Right\n");
          }
          else if(prev_ctrl_right == 1 && event->caxis.value < CTRL_DEADZONE)
          {
             prev_ctrl_right = 0;
             
-            event_inputstate.key    = e_gipk_move_right;
-            event_inputstate.state  = 0;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_right, 0);
          }
          else if(prev_ctrl_left == 0 && event->caxis.value < -CTRL_DEADZONE)
          {
             prev_ctrl_left = 1;
             
-            event_inputstate.key    = e_gipk_move_left;
-            event_inputstate.state  = 1;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_left, 1);
             //printf("Left\n");
          }
          else if(prev_ctrl_left == 1 && event->caxis.value > -CTRL_DEADZONE)
          {
             prev_ctrl_left = 0;
             
-            event_inputstate.key    = e_gipk_move_left;
-            event_inputstate.state  = 0;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_left, 0);
          }
       }
       else if(event->caxis.axis == SDL_CONTROLLER_AXIS_LEFTY)
@@ -537,39 +835,27 @@ static void handle_input(const SDL_Event * event,
          {
             prev_ctrl_down = 1;
             
-            event_inputstate.key    = e_gipk_move_down;
-            event_inputstate.state  = 1;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_down, 1);
             //printf("Down\n");
          }
          else if(prev_ctrl_down == 1 && event->caxis.value < CTRL_DEADZONE)
          {
             prev_ctrl_down = 0;
             
-            event_inputstate.key    = e_gipk_move_down;
-            event_inputstate.state  = 0;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_down, 0);
          }
          else if(prev_ctrl_up == 0 && event->caxis.value < -CTRL_DEADZONE)
          {
             prev_ctrl_up = 1;
             
-            event_inputstate.key    = e_gipk_move_up;
-            event_inputstate.state  = 1;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_up, 1);
             //printf("Up\n");
          }
          else if(prev_ctrl_up == 1 && event->caxis.value > -CTRL_DEADZONE)
          {
             prev_ctrl_up = 0;
             
-            event_inputstate.key    = e_gipk_move_up;
-            event_inputstate.state  = 0;
-            event_inputstate.player = 0;
-            EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+            GameInputQueue_Send(input_queue, 0, e_gipk_move_up, 0);
          }
       }
 
@@ -578,523 +864,401 @@ static void handle_input(const SDL_Event * event,
    {
       if(event->cbutton.button == SDL_CONTROLLER_BUTTON_LEFTSHOULDER)
       {
-         event_inputstate.key    = e_gipk_dig_left;
-         event_inputstate.state  = joy_state;
-         event_inputstate.player = 0;
-         EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+         GameInputQueue_Send(input_queue, 0, e_gipk_dig_left, joy_state);
       }
       else if(event->cbutton.button == SDL_CONTROLLER_BUTTON_RIGHTSHOULDER)
       {
-         event_inputstate.key    = e_gipk_dig_right;
-         event_inputstate.state  = joy_state;
-         event_inputstate.player = 0;
-         EventSys_Send(event_sys, EVENT_INPUTSTATE, &event_inputstate);
+         GameInputQueue_Send(input_queue, 0, e_gipk_dig_right, joy_state);
       }
    }
 }
 
-static void handle_update_level(float seconds,
+static void handle_update_audio(float seconds,
                                 EventSys_T * event_sys,
-                                GameLevelData_T * game_level_data)
+                                GameAudioData_T * game_audio_data)
 {
+   size_t count;
+   int first;
+   Event_GoldAmountChanged_T * list_goldamountchanged;
 
-   Level_T * next_level;
-   Event_LevelStartPos_T     event_levelstartpos;   
-   Event_GoldAmountChanged_T event_goldamountchanged;
-   Event_InitLevel_T         * list_initlevel;
-   Event_PlayerOnGold_T      * list_playerongold;
-   size_t count, i;
-   
-   
-   list_initlevel = ESInbox_Get(game_level_data->inbox_initlevel, &count, NULL);
-   for(i = 0; i < count; i ++)
+   if(game_audio_data->inbox_goldamountchanged == NULL) // Headless
    {
-
-      next_level = LevelSet_GetLevel(game_level_data->levelset, list_initlevel[i].level_number);
-      if(next_level != NULL)
-      {
-         game_level_data->level_index = list_initlevel[i].level_number;
-         game_level_data->level = next_level;
-         Level_Restart(game_level_data->level);
-
-         event_levelstartpos.player = 0;
-         Level_GetStartSpot(game_level_data->level,
-                            &event_levelstartpos.x,
-                            &event_levelstartpos.y);
-         EventSys_Send(event_sys, EVENT_LEVELSTARTPOS, &event_levelstartpos);
-
-         event_goldamountchanged.delta = 0;         
-         event_goldamountchanged.new_amount = Level_GetGoldCount(game_level_data->level, &event_goldamountchanged.new_max);
-         EventSys_Send(event_sys, EVENT_GOLDAMOUNTCHANGED, &event_goldamountchanged);
-      
-
-      }
+      return;
    }
 
-   list_playerongold = ESInbox_Get(game_level_data->inbox_playerongold, &count, NULL);
-   event_goldamountchanged.delta = 0;
-   for(i = 0; i < count; i++)
-   {
-      Level_RemoveGold(game_level_data->level, list_playerongold[i].gold_index);
-      event_goldamountchanged.delta --;
-   }
-   event_goldamountchanged.new_amount = Level_GetGoldCount(game_level_data->level, &event_goldamountchanged.new_max);
-   if(event_goldamountchanged.delta != 0)
+   // One pickup sound a tick is plenty, but the inbox still gets emptied
+   first = 1;
+   while((list_goldamountchanged = ESInbox_Get(game_audio_data->inbox_goldamountchanged, &count, NULL)) != NULL)
    {
-      EventSys_Send(event_sys, EVENT_GOLDAMOUNTCHANGED, &event_goldamountchanged);
+      if(first == 1 && list_goldamountchanged[0].delta < 0)
+      {
+         Mix_PlayChannel(-1, game_audio_data->pickup, 0);
+      }
+      first = 0;
    }
-   Level_Update(game_level_data->level, seconds);
-
 }
 
-static void handle_update_player(float seconds,
-                                 EventSys_T * event_sys,
-                                 PlayerData_T * player1_data)
+// Runs max_ticks updates, or until the last level is won if max_ticks is 0.
+// A replay also stops at the tick its recording stopped on.
+static void run_headless(long max_ticks,
+                         double tick_seconds,
+                         GameSession_T * session, 
+                         GameReplayData_T * game_replay_data,
+                         GameAudioData_T * game_audio_data)
 {
-   Event_LevelStartPos_T * list_levelstartpos;
-   size_t count, i;
-
-   list_levelstartpos = ESInbox_Get(player1_data->inbox_levelstartpos, &count, NULL);
-   for(i = 0; i < count; i++)
+   long ticks;
+   int complete;
+   size_t level_count;
+   Uint64 counter_start;
+   double elapsed;
+
+   level_count = LevelSet_GetCount(session->level_data.levelset);
+   ticks = 0;
+   complete = 0;
+   counter_start = SDL_GetPerformanceCounter();
+   while(complete == 0 && (max_ticks <= 0 || ticks < max_ticks))
    {
-      if(list_levelstartpos[i].player == 0)
+      if(game_replay_data->mode == REPLAY_MODE_PLAY && 
+         InputLog_IsFinished(&game_replay_data->log, game_replay_data->tick))
       {
-
-         player1_data->grid_p.x = list_levelstartpos[i].x;
-         player1_data->grid_p.y = list_levelstartpos[i].y;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y;
-         player1_data->player_state = PLAYER_STATE_DEATH;
+         break;
       }
+      PROFILER_BEGIN(e_pp_frame);
+      handle_replay(session, game_replay_data);
+      GameSession_Update(session, (float)tick_seconds);
+      handle_update_audio((float)tick_seconds, &session->event_sys, game_audio_data);
+      PROFILER_END(e_pp_frame);
+      PROFILER_END_FRAME();
+      game_replay_data->tick ++;
+      ticks ++;
+
+      complete = GameSession_IsLevelSetComplete(session);
    }
+   elapsed = (double)(SDL_GetPerformanceCounter() - counter_start) / 
+             SDL_GetPerformanceFrequency();
+
+   printf("Headless: %ld ticks (%.1f game seconds) in %.3f seconds, %.0f ticks per second\n",
+          ticks, ticks * tick_seconds, elapsed, 
+          (elapsed > 0) ? ticks / elapsed : 0.0);
+   printf("Headless: on level %d of %d, %s\n", 
+          session->level_data.level_index + 1, (int)level_count, 
+          (complete == 1) ? "levelset complete" : "levelset not complete");
 }
 
-static void handle_update_text(float seconds,
-                               EventSys_T * event_sys,
-                               GameTextData_T * game_text_data)
+// Ticks every tick_seconds until told to quit. Ticks are stamped with the
+// time they were due rather than when they ran, so a late wake up doesn't
+// show as a stutter.
+static int simulation_thread(void * data)
 {
-
-   size_t count;
-   Event_GoldAmountChanged_T * list_goldamountchanged;
-
-   list_goldamountchanged = ESInbox_Get(game_text_data->inbox_goldamountchanged, &count, NULL);
-   if(count > 0)
+   GameSimData_T * sim;
+   Uint64 counter_freq, counter_now, next_tick, tick_counts, max_behind;
+
+   sim = data;
+   counter_freq = SDL_GetPerformanceFrequency();
+   tick_counts  = (Uint64)(sim->tick_seconds * counter_freq);
+   max_behind   = (Uint64)(MAX_FRAME_SECONDS  * counter_freq);
+   next_tick    = SDL_GetPerformanceCounter() + tick_counts;
+   while(SDL_AtomicGet(&sim->quit) == 0)
    {
-      FontText_UpdateGoldCount(&game_text_data->gold_count_text,
-                               list_goldamountchanged[0].new_amount,
-                               list_goldamountchanged[0].new_max);
-   }
-
-}
-
-static void handle_update_audio(float seconds,
-                                EventSys_T * event_sys,
-                                GameAudioData_T * game_audio_data)
-{
-   size_t count;
-   Event_GoldAmountChanged_T * list_goldamountchanged;
+      counter_now = SDL_GetPerformanceCounter();
+      if(counter_now < next_tick)
+      {
+         SDL_Delay((Uint32)(((next_tick - counter_now) * 1000) / counter_freq));
+         continue;
+      }
 
-   list_goldamountchanged = ESInbox_Get(game_audio_data->inbox_goldamountchanged, &count, NULL);
-   if(count > 0)
-   {
-      if(list_goldamountchanged[0].delta < 0)
+      if(counter_now - next_tick > max_behind)
       {
-         Mix_PlayChannel(-1, game_audio_data->pickup, 0);
+         next_tick = counter_now;
       }
+      simulation_tick(sim, next_tick);
+      next_tick += tick_counts;
    }
+   return 0;
 }
 
-
-static void handle_update(float seconds,
-                          EventSys_T * event_sys, 
-                          GameLevelData_T * game_level_data, 
-                          GameAudioData_T * game_audio_data,
-                          int * game_input_flags, 
-                          PlayerData_T * player1_data, 
-                          GameTextData_T * game_text_data)
+static void simulation_tick(GameSimData_T * sim, Uint64 counter)
 {
-   int cmd_dig_left_valid, cmd_dig_right_valid;
-   int cmd_move_left_valid, cmd_move_right_valid;
-   int cmd_move_up_valid, cmd_move_down_valid, cmd_let_go_valid, cmd_fall_valid;
-   LevelTile_T player_current_tile, player_desired_tile, dig_desired_tile;
-   LevelTile_T dig_above_tile, player_below_tile;
-   int all_gold_colected;
-   static int restart_key_prev = 0;
-   Event_PlayerOnGold_T event_playerongold;
-   Event_InputState_T * list_inputstate;
+   Actor_T prev_player;
+   Event_InputPolled_T * list_inputpolled;
    size_t count, i;
-   Event_InitLevel_T event_initlevel;
-
 
-   list_inputstate = ESInbox_Get(player1_data->inbox_inputstate, &count, NULL);
-   for(i = 0; i < count; i++)
-   {
-      if(list_inputstate[i].player == 0)
-      {
-         player1_data->input_flags[list_inputstate[i].key] = list_inputstate[i].state;
-      }
-   }
-    
-   Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 0, 0), &player_current_tile);
-   all_gold_colected = IsAllGoldColected(game_level_data->level);
-   if(all_gold_colected == 1 && player_current_tile.terrain_type == TMAP_TILE_DOOR)
-   {
-      // TODO: WIN!!
-      player1_data->player_state = PLAYER_STATE_WIN;
+   ActorStore_Get(&sim->session->actors, 0, &prev_player);
 
-   }
-   else if(player1_data->player_state != PLAYER_STATE_DEATH)
+   // Take everything the render thread has sent so far. A replay brings its
+   // own input, but the inbox still gets emptied.
+   while((list_inputpolled = ESInbox_Get(sim->inbox_inputpolled, &count, NULL)) != NULL)
    {
-      if(player_current_tile.out_of_range == 1 || 
-         (player_current_tile.terrain_type == TMAP_TILE_DIRT && player_current_tile.has_hole == 0))
+      for(i = 0; i < count && sim->game_replay_data->mode != REPLAY_MODE_PLAY; i++)
       {
-         player1_data->player_state = PLAYER_STATE_DEATH;
-         // Dec Lifes Here?
+         if(list_inputpolled[i].player < 0)
+         {
+            GameSession_SetGameKey(sim->session, 
+                                   (GameInput_GameKeys_T)list_inputpolled[i].key, 
+                                   list_inputpolled[i].state);
+         }
+         else
+         {
+            GameSession_SetPlayerKey(sim->session, 
+                                     list_inputpolled[i].player, 
+                                     list_inputpolled[i].key, 
+                                     list_inputpolled[i].state);
+         }
       }
    }
 
+   handle_replay(sim->session, sim->game_replay_data);
+   GameSession_Update(sim->session, (float)sim->tick_seconds);
 
-   
-   if(player1_data->player_state == PLAYER_STATE_NOT_MOVING)
+   PROFILER_BEGIN(e_pp_update_other);
+   handle_update_audio((float)sim->tick_seconds, &sim->session->event_sys, sim->game_audio_data);
+#ifdef EVENTSYS_STATS
+   // The session's events belong to this thread, so dump them from here
+   if(sim->session->game_input_flags[e_gigk_dump_event_stats] == 0 && sim->dump_key_prev == 1)
    {
-      // Check for valid commands/behavoirs
-      
-      cmd_dig_left_valid   = 0;
-      cmd_dig_right_valid  = 0;
-      cmd_move_left_valid  = 0;
-      cmd_move_right_valid = 0;
-      cmd_move_up_valid    = 0;
-      cmd_move_down_valid  = 0;
-      cmd_let_go_valid     = 0;
-      cmd_fall_valid       = 0;
-      
+      EventSys_DumpStats(&sim->session->event_sys, EVENTSTATS_JSON_FILENAME);
+   }
+   sim->dump_key_prev = sim->session->game_input_flags[e_gigk_dump_event_stats];
+#endif // EVENTSYS_STATS
+   PROFILER_END(e_pp_update_other);
+   sim->game_replay_data->tick ++;
 
-      Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 0,  1), &player_below_tile);
+   GameSnapshot_Take(TripleBuffer_GetWrite(&sim->snapshots), sim, &prev_player, counter);
+   TripleBuffer_Publish(&sim->snapshots);
+}
 
+// Runs right before each GameSession_Update. Records the input that update
+// is about to see, or sends the recorded input in its place.
+static void handle_replay(GameSession_T * session,
+                          GameReplayData_T * game_replay_data)
+{
+   Event_InputState_T * list_inputstate;
+   int * game_input_flags;
+   int player, key, state;
+   size_t count, i;
 
-      if(player_current_tile.gold_index >= 0) // Remove Gold if on Gold
-      {
-         event_playerongold.player = 0;
-         event_playerongold.gold_index = player_current_tile.gold_index;
-         EventSys_Send(event_sys, EVENT_PLAYERONGOLD, &event_playerongold); 
-      }
+   game_input_flags = session->game_input_flags;
 
-      if(IsTerrainFallable(&player_current_tile, &player_below_tile) == 1) // Falling
-      {
-         cmd_fall_valid = 1;
-      }
-      if(player1_data->input_flags[e_gipk_dig_left] == 1) // Dig Left
+   if(game_replay_data->mode == REPLAY_MODE_RECORD)
+   {
+      while((list_inputstate = ESInbox_Get(game_replay_data->inbox_inputstate, &count, NULL)) != NULL)
       {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, -1, 1), &dig_desired_tile);
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, -1, 0), &dig_above_tile);
-         if(dig_desired_tile.terrain_type == TMAP_TILE_DIRT && 
-            (dig_above_tile.terrain_type == TMAP_TILE_AIR || dig_above_tile.has_hole == 1))
+         for(i = 0; i < count; i++)
          {
-            cmd_dig_left_valid = 1;
+            InputLog_Write(&game_replay_data->log, game_replay_data->tick, 
+                           list_inputstate[i].player, 
+                           list_inputstate[i].key, 
+                           list_inputstate[i].state);
          }
       }
-      if(player1_data->input_flags[e_gipk_dig_right] == 1) // Dig Right
+
+      // Game keys are plain flags, so record what changed
+      for(i = 0; i < e_gigk_last; i++)
       {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 1, 1), &dig_desired_tile);
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 1, 0), &dig_above_tile);
-         if(dig_desired_tile.terrain_type == TMAP_TILE_DIRT && 
-            (dig_above_tile.terrain_type == TMAP_TILE_AIR || dig_above_tile.has_hole == 1))
+         if(game_input_flags[i] != game_replay_data->game_input_flags[i])
          {
-            cmd_dig_right_valid = 1;
+            game_replay_data->game_input_flags[i] = game_input_flags[i];
+            InputLog_Write(&game_replay_data->log, game_replay_data->tick, 
+                           -1, (int)i, game_input_flags[i]);
          }
       }
-      if(player1_data->input_flags[e_gipk_move_left] == 1) // Move Left
+   }
+   else if(game_replay_data->mode == REPLAY_MODE_PLAY)
+   {
+      while(InputLog_Read(&game_replay_data->log, game_replay_data->tick, &player, &key, &state))
       {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, -1, 0), &player_desired_tile);
-         if(IsTerrainPassable(&player_current_tile, &player_desired_tile) == 1)
+         if(player < 0)
          {
-            cmd_move_left_valid = 1;
+            if(key < e_gigk_last)
+            {
+               GameSession_SetGameKey(session, key, state);
+            }
          }
-      }
-      if(player1_data->input_flags[e_gipk_move_right] == 1) // Move Right
-      {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 1, 0), &player_desired_tile);
-         if(IsTerrainPassable(&player_current_tile, &player_desired_tile) == 1)
+         else if(key < e_gipk_last)
          {
-            cmd_move_right_valid = 1;
+            GameSession_SetPlayerKey(session, player, key, state);
          }
       }
-      if(player1_data->input_flags[e_gipk_move_up] == 1) // Climb Up
+
+      if(InputLog_IsFinished(&game_replay_data->log, game_replay_data->tick))
       {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 0, -1), &player_desired_tile);
-         if(IsTerrainPassable(&player_current_tile, &player_desired_tile) == 1 &&
-            player_current_tile.terrain_type == TMAP_TILE_LADDER)
-         {
-            cmd_move_up_valid = 1;
-         }
+         // Hand control back to the keyboard
+         printf("Replay finished at tick %lu\n", game_replay_data->tick);
+         InputLog_Close(&game_replay_data->log, game_replay_data->tick);
+         game_replay_data->mode = REPLAY_MODE_NONE;
       }
-      if(player1_data->input_flags[e_gipk_move_down] == 1) // Climb Down or Fall
+   }
+}
+
+#ifdef PROFILER_ENABLED
+// Toggles and draws the per phase timings and what the last frame drew,
+// the text is only rebuilt every PROFILER_OVERLAY_REFRESH frames
+static void handle_profiler_overlay(GameTextData_T * game_text_data,
+                                    GameRenderData_T * game_render_data,
+                                    int * game_input_flags)
+{
+   char buffer[128];
+   Profiler_Stats_T stats;
+   LevelRenderStats_T * render_stats;
+   int i;
+
+   if(game_input_flags[e_gigk_toggle_profiler] == 1 && game_text_data->profiler_key_prev == 0)
+   {
+      game_text_data->profiler_show = !game_text_data->profiler_show;
+      game_text_data->profiler_frames = PROFILER_OVERLAY_REFRESH;
+   }
+   game_text_data->profiler_key_prev = game_input_flags[e_gigk_toggle_profiler];
+
+   if(game_text_data->profiler_show == 1)
+   {
+      game_text_data->profiler_frames ++;
+      if(game_text_data->profiler_frames >= PROFILER_OVERLAY_REFRESH)
       {
-         Level_QueryTile(game_level_data->level, POS_SPLIT(player1_data->grid_p, 0, 1), &player_desired_tile);
-         if(IsTerrainPassable(&player_current_tile, &player_desired_tile) == 1)
+         game_text_data->profiler_frames = 0;
+         for(i = 0; i < e_pp_last; i++)
          {
-            if(player_current_tile.terrain_type == TMAP_TILE_BAR)
-            {
-               cmd_let_go_valid = 1;
-            }
-            else
-            {
-               cmd_move_down_valid = 1;
-            }
+            Profiler_GetStats(i, &stats);
+            sprintf(buffer, "%-13s min %6.2f avg %6.2f p99 %6.2f max %6.2f ms",
+                    Profiler_GetPhaseName(i), stats.min, stats.avg, stats.p99, stats.max);
+            FontText_SetString(&game_text_data->profiler_text[i], buffer);
          }
-      }
 
-      // Compute Next Position and state based on commands
-      // Order
-      // 1. Falling
-      // 2. Digging
-      // 3. Climbing
-      // 4. Letting Go
-      // 5. Horisontal Movement
+         render_stats = &game_render_data->level_stats;
+         sprintf(buffer, "tiles %d drawn %d culled, blocks %d drawn %d refreshed, gold %d drawn %d culled",
+                 render_stats->tiles_drawn, render_stats->tiles_culled, 
+                 render_stats->blocks_drawn, render_stats->blocks_refreshed,
+                 render_stats->gold_drawn, render_stats->gold_culled);
+         FontText_SetString(&game_text_data->profiler_text[e_pp_last], buffer);
+         sprintf(buffer, "%d sprites in %d draw calls", 
+                 game_render_data->batch.sprite_count, game_render_data->batch.draw_calls);
+         FontText_SetString(&game_text_data->profiler_text[e_pp_last + 1], buffer);
+      }
 
-      if(cmd_fall_valid == 1)
+      for(i = 0; i < PROFILER_OVERLAY_LINES; i++)
       {
-         player1_data->player_state = PLAYER_STATE_FALLING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y + 1;
+         FontText_Render(&game_text_data->profiler_text[i], 10, 48 + (i * 16));
       }
-      else if(cmd_dig_left_valid == 1 && cmd_dig_right_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_DIGGING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y;
+   }
+}
+#endif // PROFILER_ENABLED
 
-         Level_AddDigSpot(game_level_data->level, 
-                          player1_data->grid_p.x - 1, 
-                          player1_data->grid_p.y + 1);
-      }
-      else if(cmd_dig_right_valid == 1 && cmd_dig_left_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_DIGGING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y;
+// Draws the player alpha of the way from the previous tick to the current one
+static void handle_render(GameRenderData_T * game_render_data,
+                          GameSnapshot_T * snapshot,
+                          float alpha)
+{
+   Pos2D_T draw_loc, prev_draw_loc, guard_loc;
+   int show, prev_show, guard_show;
+   int center_x, center_y;
+   SDL_Rect view;
+   Actor_T * guard;
+   size_t guard_count, i;
 
-         Level_AddDigSpot(game_level_data->level, 
-                          player1_data->grid_p.x + 1, 
-                          player1_data->grid_p.y + 1);
-      }
-      else if(cmd_move_up_valid == 1 && cmd_move_down_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_MOVING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y - 1;
-      }
-      else if(cmd_move_down_valid == 1 && cmd_move_up_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_MOVING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y + 1;
-      }
-      else if(cmd_let_go_valid == 1)
-      {
-         player1_data->player_state = PLAYER_STATE_FALLING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x;
-         player1_data->next_grid_p.y = player1_data->grid_p.y + 1;
-      }
-      else if(cmd_move_left_valid == 1 && cmd_move_right_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_MOVING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x - 1;
-         player1_data->next_grid_p.y = player1_data->grid_p.y;
-      }
-      else if(cmd_move_right_valid == 1 && cmd_move_left_valid == 0)
-      {
-         player1_data->player_state = PLAYER_STATE_MOVING;
-         player1_data->next_grid_p.x = player1_data->grid_p.x + 1;
-         player1_data->next_grid_p.y = player1_data->grid_p.y;
-      }
 
-      if(player1_data->player_state != PLAYER_STATE_NOT_MOVING)
-      {
-         player1_data->move_timer = 0;
+   center_x = (game_render_data->level_viewport.w / 2.0f) - (TILE_WIDTH  / 2.0f);
+   center_y = (game_render_data->level_viewport.h / 2.0f) - (TILE_HEIGHT / 2.0f);
 
+   show      = GetActorDrawLoc(&snapshot->player,      &draw_loc);
+   prev_show = GetActorDrawLoc(&snapshot->prev_player, &prev_draw_loc);
 
-         switch(player1_data->player_state)
-         {
-            case PLAYER_STATE_DIGGING: player1_data->move_timeout = DIG_TIMEOUT;  break;
-            case PLAYER_STATE_MOVING:  player1_data->move_timeout = MOVE_TIMEOUT; break;
-            case PLAYER_STATE_FALLING: player1_data->move_timeout = FALL_TIMEOUT; break;
-            default:                   player1_data->move_timeout = 0;            break;
-         }
-      }
-   }
-   else if(player1_data->player_state == PLAYER_STATE_MOVING ||
-           player1_data->player_state == PLAYER_STATE_FALLING ||
-           player1_data->player_state == PLAYER_STATE_DIGGING)
+   // Don't slide across the map after a respawn or level change
+   if(show == 1 && prev_show == 1 &&
+      abs(draw_loc.x - prev_draw_loc.x) <= TILE_WIDTH &&
+      abs(draw_loc.y - prev_draw_loc.y) <= TILE_HEIGHT)
    {
-      player1_data->move_timer += seconds;
-      if(player1_data->move_timer >= player1_data->move_timeout)
-      {
-         player1_data->player_state = PLAYER_STATE_NOT_MOVING;
-         player1_data->grid_p.x = player1_data->next_grid_p.x;
-         player1_data->grid_p.y = player1_data->next_grid_p.y;
-      }
+      draw_loc.x = prev_draw_loc.x + (int)((draw_loc.x - prev_draw_loc.x) * alpha);
+      draw_loc.y = prev_draw_loc.y + (int)((draw_loc.y - prev_draw_loc.y) * alpha);
    }
-   else if(player1_data->player_state == PLAYER_STATE_DEATH)
+
+   
+   // Level_Render draws inside level_viewport, so the view starts at 0, 0
+   view.x = 0;
+   view.y = 0;
+   view.w = game_render_data->level_viewport.w;
+   view.h = game_render_data->level_viewport.h;
+   PROFILER_BEGIN(e_pp_render_level);
+   SDLTools_Batch_Begin(&game_render_data->batch);
+   Level_Render(&snapshot->level, 
+                &game_render_data->batch, 
+                &game_render_data->level_cache,
+                &view,
+                center_x - draw_loc.x, 
+                center_y - draw_loc.y,  
+                game_render_data->text_terrain,
+                &game_render_data->level_stats);
+
+   guard = ArrayList_Get(&snapshot->guard_list, &guard_count, NULL);
+   for(i = 0; i < guard_count; i++)
    {
-      if(player1_data->input_flags[e_gipk_dig_left]   == 1 ||
-         player1_data->input_flags[e_gipk_dig_right]  == 1 ||
-         player1_data->input_flags[e_gipk_move_left]  == 1 ||
-         player1_data->input_flags[e_gipk_move_right] == 1 ||
-         player1_data->input_flags[e_gipk_move_up]    == 1 ||
-         player1_data->input_flags[e_gipk_move_down]  == 1)
+      guard_show = GetActorDrawLoc(&guard[i], &guard_loc);
+      guard_loc.x += center_x - draw_loc.x;
+      guard_loc.y += center_y - draw_loc.y;
+      if(guard_show == 1 &&
+         guard_loc.x > -TILE_WIDTH  && guard_loc.x < view.w &&
+         guard_loc.y > -TILE_HEIGHT && guard_loc.y < view.h)
       {
-         player1_data->player_state = PLAYER_STATE_NOT_MOVING;
-         Level_SetPlayerAtStart(game_level_data->level, player1_data);
-         //printf("ComeAlive!\n");
+         SDLTools_Batch_Add(&game_render_data->batch, 
+                            game_render_data->text_guard, IMGID_GUY, 
+                            guard_loc.x, guard_loc.y); 
       }
    }
 
-   if(game_input_flags[e_gigk_restart_level] == 0 && restart_key_prev == 1)
-   {
-      event_initlevel.level_number = game_level_data->level_index;
-      EventSys_Send(event_sys, EVENT_INITLEVEL, &event_initlevel);
-   }
-   restart_key_prev = game_input_flags[e_gigk_restart_level];
-
-   if(player1_data->player_state == PLAYER_STATE_WIN)
+   if(show == 1)
    {
-      // We won, so move the next level
-      event_initlevel.level_number = game_level_data->level_index + 1;
-      EventSys_Send(event_sys, EVENT_INITLEVEL, &event_initlevel);
+      SDLTools_Batch_Add(&game_render_data->batch, 
+                         game_render_data->text_character, IMGID_GUY, 
+                         center_x, center_y); 
    }
-   // Level update
-   handle_update_level(seconds, event_sys, game_level_data);
-  
-   // Player Update
-   handle_update_player(seconds, event_sys, player1_data);
-
-   // Text Update
-   handle_update_text(seconds, event_sys, game_text_data);
-
-   // Audio Update
-   handle_update_audio(seconds, event_sys, game_audio_data);
+   SDLTools_Batch_Flush(&game_render_data->batch);
+   PROFILER_END(e_pp_render_level);
+ 
 }
 
-static void handle_render(GameRenderData_T * game_render_data,
-                          Level_T * level, 
-                          PlayerData_T * player1_data)
+// Returns 0 if the actor should not be drawn
+static int GetActorDrawLoc(Actor_T * actor, Pos2D_T * draw_loc)
 {
-   Pos2D_T draw_loc;
    Pos2D_T diff;
    float move_percent;
    int show;
-   int center_x, center_y;
-
-
-   center_x = (game_render_data->level_viewport.w / 2.0f) - (TILE_WIDTH  / 2.0f);
-   center_y = (game_render_data->level_viewport.h / 2.0f) - (TILE_HEIGHT / 2.0f);
-
-   
 
    show = 1;
-   switch(player1_data->player_state)
+   switch(actor->state)
    {
-   case PLAYER_STATE_NOT_MOVING:
+   case ACTOR_STATE_NOT_MOVING:
   
-      draw_loc.x = player1_data->grid_p.x * TILE_WIDTH;
-      draw_loc.y = player1_data->grid_p.y * TILE_HEIGHT;
+      draw_loc->x = actor->grid_p.x * TILE_WIDTH;
+      draw_loc->y = actor->grid_p.y * TILE_HEIGHT;
       break;
-   case PLAYER_STATE_FALLING:
-   case PLAYER_STATE_DIGGING:
-   case PLAYER_STATE_MOVING:
+   case ACTOR_STATE_FALLING:
+   case ACTOR_STATE_DIGGING:
+   case ACTOR_STATE_MOVING:
    
-      diff.x = (player1_data->next_grid_p.x - player1_data->grid_p.x) * TILE_WIDTH;
-      diff.y = (player1_data->next_grid_p.y - player1_data->grid_p.y) * TILE_HEIGHT;
-      move_percent = player1_data->move_timer / player1_data->move_timeout;
-      draw_loc.x = (player1_data->grid_p.x * TILE_WIDTH) + 
-                   (int)(diff.x * move_percent);
-      draw_loc.y = (player1_data->grid_p.y * TILE_HEIGHT) + 
-                   (int)(diff.y * move_percent);
+      diff.x = (actor->next_grid_p.x - actor->grid_p.x) * TILE_WIDTH;
+      diff.y = (actor->next_grid_p.y - actor->grid_p.y) * TILE_HEIGHT;
+      move_percent = actor->move_timer / actor->move_timeout;
+      draw_loc->x = (actor->grid_p.x * TILE_WIDTH) + 
+                    (int)(diff.x * move_percent);
+      draw_loc->y = (actor->grid_p.y * TILE_HEIGHT) + 
+                    (int)(diff.y * move_percent);
       break;
 
-   case PLAYER_STATE_DEATH:
+   case ACTOR_STATE_DEATH:
       show = 0;
-      draw_loc.x = player1_data->grid_p.x * TILE_WIDTH;
-      draw_loc.y = player1_data->grid_p.y * TILE_HEIGHT;
+      draw_loc->x = actor->grid_p.x * TILE_WIDTH;
+      draw_loc->y = actor->grid_p.y * TILE_HEIGHT;
       break;
-   case PLAYER_STATE_WIN:
+   case ACTOR_STATE_WIN:
       show = 0; // Sure why not?
-      draw_loc.x = player1_data->grid_p.x * TILE_WIDTH;
-      draw_loc.y = player1_data->grid_p.y * TILE_HEIGHT;
+      draw_loc->x = actor->grid_p.x * TILE_WIDTH;
+      draw_loc->y = actor->grid_p.y * TILE_HEIGHT;
       break;
    default:
       show = 0;
-      draw_loc.x = 0;
-      draw_loc.y = 0;
+      draw_loc->x = 0;
+      draw_loc->y = 0;
       break;
    }
-
-   
-   Level_Render(level, 
-                game_render_data->rend, 
-                center_x - draw_loc.x, 
-                center_y - draw_loc.y,  
-                game_render_data->text_terrain);
-
-   if(show == 1)
-   {
-      SDLTools_DrawSubimage(game_render_data->rend, 
-                            game_render_data->text_character, IMGID_GUY, 
-                            center_x, center_y); 
-   }
- 
-}
-
-static int IsTerrainPassable(LevelTile_T * from, LevelTile_T * to)
-{
-   int result;
-   if(to->out_of_range == 0 && 
-     (
-       (to->terrain_type == TMAP_TILE_DIRT && to->has_hole == 1) || 
-       (to->terrain_type != TMAP_TILE_DIRT)
-     ))
-   {
-      result = 1;
-   }
-   else
-   {
-      result = 0;
-   }
-   return result;
-}
-
-static int IsTerrainFallable(LevelTile_T *  from, LevelTile_T *  to)
-{
-   int result;
-   if((to->terrain_type == TMAP_TILE_AIR || to->terrain_type == TMAP_TILE_BAR || to->has_hole == 1 || to->terrain_type == TMAP_TILE_DOOR) && 
-      from->terrain_type != TMAP_TILE_LADDER && from->terrain_type != TMAP_TILE_BAR && to->out_of_range == 0)
-   {
-      result = 1;      
-   }
-   else
-   {
-      result = 0;
-   }
-   return result;
-}
-
-
-static int IsAllGoldColected(Level_T * level)
-{
-   int all_gold_colected;
-   int gold_count;
- 
-   gold_count = Level_GetGoldCount(level, NULL);
-   if(gold_count > 0)
-   {
-      all_gold_colected = 0;
-   }
-   else
-   {
-      all_gold_colected = 1;
-   }
-   return all_gold_colected;
+   return show;
 }
 
 static void FontText_UpdateGoldCount(FontText_T * gold_count_text, int gold_left, int gold_total)
@@ -1106,10 +1270,38 @@ static void FontText_UpdateGoldCount(FontText_T * gold_count_text, int gold_left
 }
 
 
-static void Level_SetPlayerAtStart(Level_T * level, PlayerData_T * player)
+
+// Only the simulation thread takes snapshots once it is running
+static void GameSnapshot_Take(GameSnapshot_T * snapshot, GameSimData_T * sim, Actor_T * prev_player, Uint64 counter)
 {
-   Level_GetStartSpot(level, &player->grid_p.x, &player->grid_p.y);
-   player->next_grid_p.x = player->grid_p.x;
-   player->next_grid_p.y = player->grid_p.y;
-}
+   GameLevelData_T * game_level_data;
+   ActorStore_T * actors;
+   Actor_T * guard;
+   int index;
+
+   // The render thread may still be drawing the level an older snapshot
+   // points to, so keep it loaded until no snapshot does
+   game_level_data = &sim->session->level_data;
+   if(snapshot->level_index != game_level_data->level_index)
+   {
+      LevelSet_Pin(game_level_data->levelset, game_level_data->level_index);
+      if(snapshot->level_index >= 0)
+      {
+         LevelSet_Unpin(game_level_data->levelset, snapshot->level_index);
+      }
+      snapshot->level_index = game_level_data->level_index;
+   }
 
+   Level_TakeSnapshot(game_level_data->level, &snapshot->level);
+   actors = &sim->session->actors;
+   ArrayList_Clear(&snapshot->guard_list);
+   for(index = sim->session->player_count; index < actors->count; index++)
+   {
+      guard = ArrayList_Add(&snapshot->guard_list, NULL);
+      ActorStore_Get(actors, index, guard);
+   }
+   ActorStore_Get(actors, 0, &snapshot->player);
+   snapshot->prev_player = (*prev_player);
+   snapshot->gold_left   = Level_GetGoldCount(game_level_data->level, &snapshot->gold_total);
+   snapshot->counter     = counter;
+}